@@ -0,0 +1,63 @@
+#pragma once
+
+/*///=====================================================================
+
+	alloc_count.h
+
+	Counts heap allocations for the benches that report them, by replacing
+	the global operator new and delete with malloc/free wrappers and by
+	hooking AlignedAllocator (simd.h), which allocates around them.
+	Include it from exactly one translation unit (each bench is one) and
+	read allocations before and after the measured code.
+
+*///======================================================================
+
+#include <new>
+#include <stdlib.h>
+
+#include "../src/simd.h"
+
+static unsigned long long allocations = 0;
+
+namespace
+{
+	void countAligned(size_t)
+	{
+		++allocations;
+	}
+
+	struct AlignedCounting
+	{
+		AlignedCounting() { simd::allocationHook() = countAligned; }
+	} alignedCounting;
+}
+
+void * operator new(size_t n)
+{
+	++allocations;
+	void * p = malloc(n ? n : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+void * operator new[](size_t n)
+{
+	++allocations;
+	void * p = malloc(n ? n : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+// GCC 11+ sees free() on memory from operator new once the two are
+// inlined together and warns, but here both sides are this malloc/free
+// pair
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void * p) noexcept { free(p); }
+void operator delete[](void * p) noexcept { free(p); }
+void operator delete(void * p, size_t) noexcept { free(p); }
+void operator delete[](void * p, size_t) noexcept { free(p); }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
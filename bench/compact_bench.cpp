@@ -0,0 +1,231 @@
+/*///=====================================================================
+
+	compact_bench.cpp
+
+	Traversal and query cost before and after Graph::compact. Builds a
+	generated planar mesh whose nodes and edges are created in shuffled
+	order (as an import in file order, or a graph edited for a while,
+	leaves them), then times, before and after compaction:
+
+		bfs		breadth-first walks over Node::edges from random nodes,
+				reading each neighbor's position
+		query	100 x 100 node region queries, reading each result's
+				position and edges (as a click or box select does)
+		drag	a 200 x 200 selection moved 1 unit per frame for 60 frames
+				(Selection::moveSelection: nodes, edges and both quadtrees)
+
+	and checks both passes see the same graph. Run under "perf stat -e
+	cache-misses" with --before or --after to count misses for one side.
+
+		compact_bench [n] [seed] [--before|--after]
+
+	Links the editor sources and SFML's graphics module (for the shapes).
+
+*///======================================================================
+
+#include "edge.h"
+#include "generators.h"
+#include "graph.h"
+#include "node.h"
+#include "quadtree.h"
+#include "selection.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	const float WORLD = 4000;
+	const int WALKS = 20;
+	const int QUERIES = 5000;
+	const int FRAMES = 60;
+
+	typedef std::chrono::steady_clock Clock;
+
+	double msSince(Clock::time_point t0)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+	}
+
+	//
+	// Order-independent checksum term: results come back in a different
+	// order after compaction
+	//
+	uint64_t bits(float f)
+	{
+		uint32_t u;
+		memcpy(&u, &f, sizeof(u));
+		return u;
+	}
+
+	//
+	// Shuffles the generated points (and renumbers the edges to match)
+	//
+	void shuffle(GeneratedGraph & g, uint32_t seed)
+	{
+		std::vector<uint32_t> perm(g.x.size());
+		for (uint32_t i = 0; i < perm.size(); ++i) perm[i] = i;
+		std::mt19937 rng(seed);
+		std::shuffle(perm.begin(), perm.end(), rng);
+
+		GeneratedGraph s;
+		s.x.resize(g.x.size());
+		s.y.resize(g.y.size());
+		for (size_t i = 0; i < perm.size(); ++i)
+		{
+			s.x[perm[i]] = g.x[i];
+			s.y[perm[i]] = g.y[i];
+		}
+		for (size_t i = 0; i < g.edges.size(); ++i)
+			s.edges.push_back(std::make_pair(perm[g.edges[i].first], perm[g.edges[i].second]));
+		std::shuffle(s.edges.begin(), s.edges.end(), rng);
+		g.x.swap(s.x);
+		g.y.swap(s.y);
+		g.edges.swap(s.edges);
+	}
+
+	struct Result
+	{
+		double bfs, query, drag;
+		uint64_t check;
+	};
+
+	Result run(Graph & graph, const std::vector<std::pair<float, float> > & starts)
+	{
+		Result r;
+		r.check = 0;
+
+		// Breadth-first walks, identified by position so both passes agree
+		std::vector<unsigned char> seen;
+		std::deque<Node*> frontier;
+		std::vector<Node*> v;
+		Clock::time_point t0 = Clock::now();
+		for (int w = 0; w < WALKS; ++w)
+		{
+			v.clear();
+			graph.getNodeIndex()->queryRegion(starts[w].first - 0.5f, starts[w].second - 0.5f, starts[w].first + 0.5f, starts[w].second + 0.5f, v);
+			if (v.empty()) continue;
+			seen.assign(graph.nodes.capacity(), 0);
+			frontier.push_back(v[0]);
+			seen[v[0]->id] = 1;
+			while (!frontier.empty())
+			{
+				Node * n = frontier.front();
+				frontier.pop_front();
+				r.check += bits(n->x) + bits(n->y);
+				for (unsigned int i = 0; i < n->degree(); ++i)
+				{
+					Node * o = n->neighbor(i);
+					if (seen[o->id]) continue;
+					seen[o->id] = 1;
+					frontier.push_back(o);
+				}
+			}
+		}
+		r.bfs = msSince(t0);
+
+		// Region queries, touching the results and their edges
+		t0 = Clock::now();
+		for (int q = 0; q < QUERIES; ++q)
+		{
+			const std::pair<float, float> & c = starts[q % starts.size()];
+			v.clear();
+			graph.getNodeIndex()->queryRegion(c.first - 50, c.second - 50, c.first + 50, c.second + 50, v);
+			for (size_t i = 0; i < v.size(); ++i)
+			{
+				r.check += bits(v[i]->x);
+				for (unsigned int j = 0; j < v[i]->degree(); ++j)
+					r.check += bits(v[i]->edges[j]->srect.getPosition().y);
+			}
+		}
+		r.query = msSince(t0);
+
+		// Drag a selection back and forth
+		Selection selection(6);
+		v.clear();
+		graph.getNodeIndex()->queryRegion(WORLD / 2 - 100, WORLD / 2 - 100, WORLD / 2 + 100, WORLD / 2 + 100, v);
+		selection.insertSelection(v);
+		std::vector<std::pair<float, float> > at;
+		for (size_t i = 0; i < v.size(); ++i)
+			at.push_back(std::make_pair(v[i]->x, v[i]->y));
+		t0 = Clock::now();
+		for (int f = 0; f < FRAMES; ++f)
+			selection.moveSelection(f < FRAMES / 2 ? 1.f : -1.f, f < FRAMES / 2 ? 1.f : -1.f);
+		r.drag = msSince(t0);
+		selection.clearSelection();
+
+		// Moving back and forth need not round trip exactly in float
+		for (size_t i = 0; i < v.size(); ++i)
+			v[i]->setPosition(at[i].first, at[i].second);
+		return r;
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	uint32_t n = argc > 1 ? (uint32_t)atoi(argv[1]) : 200000;
+	uint32_t seed = argc > 2 ? (uint32_t)atoi(argv[2]) : 1;
+	bool before = true, after = true;
+	for (int i = 3; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--before")) after = false;
+		else if (!strcmp(argv[i], "--after")) before = false;
+	}
+
+	QuadTree<Node*> qtn(0, 0, WORLD, WORLD, 8, 16);
+	QuadTree<Edge*> qte(0, 0, WORLD, WORLD, 8, 16);
+	Graph graph;
+	graph.setNodeIndex(&qtn);
+	graph.setEdgeIndex(&qte);
+
+	GraphGenerator gen(seed, 1, 1, WORLD - 1, WORLD - 1);
+	GeneratedGraph g;
+	gen.planar(n, g);
+	shuffle(g, seed);
+	graph.instantiate(g);
+
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<size_t> pick(0, g.x.size() - 1);
+	std::vector<std::pair<float, float> > starts;
+	for (int i = 0; i < 1000; ++i)
+	{
+		size_t k = pick(rng);
+		starts.push_back(std::make_pair(g.x[k], g.y[k]));
+	}
+
+	printf("%u nodes, %u edges; ms per pass\n\n", graph.nodes.size(), graph.edges.size());
+	printf("%-8s %10s %10s %10s\n", "", "bfs", "query", "drag");
+
+	Result r1, r2;
+	if (before)
+	{
+		r1 = run(graph, starts);
+		printf("%-8s %10.2f %10.2f %10.2f\n", "before", r1.bfs, r1.query, r1.drag);
+	}
+
+	Clock::time_point t0 = Clock::now();
+	graph.compact();
+	double compactMs = msSince(t0);
+
+	if (after)
+	{
+		r2 = run(graph, starts);
+		printf("%-8s %10.2f %10.2f %10.2f\n", "after", r2.bfs, r2.query, r2.drag);
+	}
+	if (before && after)
+	{
+		printf("%-8s %9.2fx %9.2fx %9.2fx\n", "speedup", r1.bfs / r2.bfs, r1.query / r2.query, r1.drag / r2.drag);
+		if (r1.check != r2.check)
+			printf("MISMATCH: %llu != %llu\n", (unsigned long long)r1.check, (unsigned long long)r2.check);
+	}
+	printf("\ncompact: %.2f ms\n", compactMs);
+
+	graph.clear();
+	return 0;
+}
@@ -0,0 +1,189 @@
+/*///=====================================================================
+
+	crossing_bench.cpp
+
+	Edge crossing detection on a random geometric graph of n uniform
+	nodes (each connected to those within r, expected degree 6):
+
+		check	Crossings::rebuild against testing every pair of edges, on
+				a small graph
+		rebuild	finding every crossing from scratch, on one thread and on
+				all of them
+		drag	dragging a disc of nodes in small steps, as the editor does:
+				Selection::moveSelection plus Crossings::nodesTranslated
+				per frame, against moveSelection plus a rebuild per frame
+
+	Reports ms.
+
+		crossing_bench [n] [seed]
+
+	Links the editor sources (with -pthread) and SFML's graphics module
+	(for the shapes).
+
+*///======================================================================
+
+#include "crossings.h"
+#include "edge.h"
+#include "graph.h"
+#include "node.h"
+#include "parallel.h"
+#include "quadtree.h"
+#include "selection.h"
+
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+	const float WORLD = 10000;
+	const float DEGREE = 6;
+	const int FRAMES = 100;
+	const int REBUILD_FRAMES = 5;
+
+	typedef std::chrono::steady_clock Clock;
+
+	double msSince(Clock::time_point t0)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+	}
+
+	//
+	// An editor-like graph: node/edge sets and quadtrees bound
+	//
+	struct Bound
+	{
+		Bound()
+			: qtn(0, 0, WORLD, WORLD, 8, 16)
+			, qte(0, 0, WORLD, WORLD, 8, 16)
+		{
+			graph.setNodeSet(&nodes);
+			graph.setNodeIndex(&qtn);
+			graph.setEdgeSet(&edges);
+			graph.setEdgeIndex(&qte);
+		}
+		~Bound()
+		{
+			graph.clear();
+		}
+		std::set<Node*> nodes;
+		QuadTree<Node*> qtn;
+		std::set<Edge*> edges;
+		QuadTree<Edge*> qte;
+		Graph graph;
+	};
+
+	void build(Graph & graph, uint32_t n, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> u(0, WORLD);
+		for (uint32_t i = 0; i < n; ++i)
+			Node::create(graph, u(rng), u(rng));
+		graph.connectWithin(sqrtf(DEGREE * WORLD * WORLD / (3.14159265f * n)));
+	}
+
+	//
+	// Crossing pairs by testing every pair of edges
+	//
+	size_t naive(const Graph & graph)
+	{
+		std::vector<Edge*> e(graph.edges.begin(), graph.edges.end());
+		size_t count = 0;
+		for (size_t i = 0; i < e.size(); ++i)
+		{
+			const Node * a = e[i]->n1, * b = e[i]->n2;
+			for (size_t j = i + 1; j < e.size(); ++j)
+			{
+				const Node * c = e[j]->n1, * d = e[j]->n2;
+				if (a == c || a == d || b == c || b == d) continue;
+				float o1 = (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+				float o2 = (b->x - a->x) * (d->y - a->y) - (b->y - a->y) * (d->x - a->x);
+				float o3 = (d->x - c->x) * (a->y - c->y) - (d->y - c->y) * (a->x - c->x);
+				float o4 = (d->x - c->x) * (b->y - c->y) - (d->y - c->y) * (b->x - c->x);
+				if (((o1 > 0 && o2 < 0) || (o1 < 0 && o2 > 0)) && ((o3 > 0 && o4 < 0) || (o3 < 0 && o4 > 0))) ++count;
+			}
+		}
+		return count;
+	}
+
+	//
+	// Selects the nodes within r of the center
+	//
+	void selectDisc(Bound & b, Selection & selection, float r)
+	{
+		float c = WORLD / 2;
+		std::vector<Node*> v;
+		b.qtn.queryRegion(c - r, c - r, c + r, c + r, v);
+		for (size_t i = 0; i < v.size(); ++i)
+		{
+			float dx = v[i]->x - c, dy = v[i]->y - c;
+			if (dx*dx + dy*dy <= r*r) selection.insertSelection(v[i]);
+		}
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	uint32_t n = argc > 1 ? (uint32_t)atoi(argv[1]) : 200000;
+	uint32_t seed = argc > 2 ? (uint32_t)atoi(argv[2]) : 1;
+	printf("%u nodes, %u threads; ms\n\n", n, hardwareThreads());
+
+	// Check against every pair on a small graph
+	{
+		Bound b;
+		build(b.graph, 5000, seed);
+		Crossings crossings(b.graph);
+		crossings.rebuild();
+		size_t expected = naive(b.graph);
+		printf("check    %u edges: %zu crossings, naive %zu%s\n\n", b.graph.edges.size(), crossings.count(), expected,
+			crossings.count() == expected ? "" : "   MISMATCH");
+	}
+
+	Bound b;
+	build(b.graph, n, seed);
+	Crossings crossings(b.graph);
+
+	Clock::time_point t0 = Clock::now();
+	crossings.rebuild(1);
+	double rebuild1 = msSince(t0);
+	t0 = Clock::now();
+	crossings.rebuild();
+	double rebuildN = msSince(t0);
+	printf("rebuild  %u edges, %zu crossings: 1 thread %10.1f   %u threads %10.1f\n\n",
+		b.graph.edges.size(), crossings.count(), rebuild1, hardwareThreads(), rebuildN);
+
+	// Drags of a disc holding about 1% of the nodes, back and forth
+	Selection selection(6, 0.f, 0.f, WORLD, WORLD);
+	selectDisc(b, selection, WORLD * 0.05f);
+
+	t0 = Clock::now();
+	for (int f = 0; f < FRAMES; ++f)
+	{
+		float d = f < FRAMES / 2 ? 2.f : -2.f;
+		selection.moveSelection(d, d);
+		crossings.nodesTranslated(selection.getNodes());
+	}
+	double incremental = msSince(t0) / FRAMES;
+	size_t tracked = crossings.count();
+	crossings.rebuild();
+	size_t fresh = crossings.count();
+
+	t0 = Clock::now();
+	for (int f = 0; f < REBUILD_FRAMES; ++f)
+	{
+		float d = f % 2 ? -2.f : 2.f;
+		selection.moveSelection(d, d);
+		crossings.rebuild();
+	}
+	double rebuilt = msSince(t0) / REBUILD_FRAMES;
+
+	printf("drag     %zu nodes, per frame: incremental %10.3f   rebuild %10.1f   (%zu crossings, rebuilt %zu%s)\n",
+		selection.size(), incremental, rebuilt, tracked, fresh, tracked == fresh ? "" : "   MISMATCH");
+
+	selection.clearSelection();
+	return 0;
+}
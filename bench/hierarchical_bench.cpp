@@ -0,0 +1,204 @@
+/*///=====================================================================
+
+	hierarchical_bench.cpp
+
+	Shortest paths with HierarchicalSearch against A* on the full graph
+	(PathSearch over Graph::buildSearchGraph), on a random geometric graph
+	of n uniform nodes (each connected to those within r, expected
+	degree 6):
+
+		build	HierarchicalSearch::rebuild: clusters, border nodes and the
+				distances between them
+		query	random pairs: nodes settled and ms per query, for A* and
+				for the hierarchy; lengths are compared and a mismatch is
+				flagged
+		drag	dragging a disc of nodes back and forth, with a query per
+				frame: Selection::moveSelection plus touch (so the query
+				updates only the touched clusters), against
+				moveSelection plus a rebuild per frame
+
+	Reports ms.
+
+		hierarchical_bench [n] [cluster size] [seed]
+
+	Links the editor sources (with -pthread) and SFML's graphics module
+	(for the shapes).
+
+*///======================================================================
+
+#include "edge.h"
+#include "graph.h"
+#include "hierarchicalsearch.h"
+#include "node.h"
+#include "parallel.h"
+#include "quadtree.h"
+#include "search.h"
+#include "selection.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+	const float WORLD = 10000;
+	const float DEGREE = 6;
+	const int QUERIES = 200;
+	const int FRAMES = 50;
+	const int REBUILD_FRAMES = 5;
+
+	typedef std::chrono::steady_clock Clock;
+
+	double msSince(Clock::time_point t0)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+	}
+
+	//
+	// An editor-like graph: node/edge sets and quadtrees bound
+	//
+	struct Bound
+	{
+		Bound()
+			: qtn(0, 0, WORLD, WORLD, 8, 16)
+			, qte(0, 0, WORLD, WORLD, 8, 16)
+		{
+			graph.setNodeSet(&nodes);
+			graph.setNodeIndex(&qtn);
+			graph.setEdgeSet(&edges);
+			graph.setEdgeIndex(&qte);
+		}
+		~Bound()
+		{
+			graph.clear();
+		}
+		std::set<Node*> nodes;
+		QuadTree<Node*> qtn;
+		std::set<Edge*> edges;
+		QuadTree<Edge*> qte;
+		Graph graph;
+	};
+
+	void build(Graph & graph, uint32_t n, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> u(0, WORLD);
+		for (uint32_t i = 0; i < n; ++i)
+			Node::create(graph, u(rng), u(rng));
+		graph.connectWithin(sqrtf(DEGREE * WORLD * WORLD / (3.14159265f * n)));
+	}
+
+	bool same(float a, float b)
+	{
+		return fabsf(a - b) <= 1e-3f * std::max(fabsf(a), 1.f);
+	}
+
+	//
+	// Selects the nodes within r of the center
+	//
+	void selectDisc(Bound & b, Selection & selection, float r)
+	{
+		float c = WORLD / 2;
+		std::vector<Node*> v;
+		b.qtn.queryRegion(c - r, c - r, c + r, c + r, v);
+		for (size_t i = 0; i < v.size(); ++i)
+		{
+			float dx = v[i]->x - c, dy = v[i]->y - c;
+			if (dx*dx + dy*dy <= r*r) selection.insertSelection(v[i]);
+		}
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	uint32_t n = argc > 1 ? (uint32_t)atoi(argv[1]) : 200000;
+	uint32_t clusterSize = argc > 2 ? (uint32_t)atoi(argv[2]) : 256;
+	uint32_t seed = argc > 3 ? (uint32_t)atoi(argv[3]) : 1;
+	printf("%u nodes, clusters of up to %u, %u threads; ms\n\n", n, clusterSize, hardwareThreads());
+
+	Bound b;
+	build(b.graph, n, seed);
+	std::vector<Node*> nodes(b.graph.nodes.begin(), b.graph.nodes.end());
+
+	HierarchicalSearch hs(b.graph, clusterSize);
+	Clock::time_point t0 = Clock::now();
+	hs.rebuild();
+	printf("build    %u edges: %zu clusters, %zu border nodes, %10.1f\n\n",
+		b.graph.edges.size(), hs.numClusters(), hs.numBorderNodes(), msSince(t0));
+
+	SearchGraph sg;
+	b.graph.buildSearchGraph(sg);
+	PathSearch ps(sg);
+
+	std::mt19937 rng(seed);
+	std::vector<std::pair<Node*, Node*> > pairs(QUERIES);
+	for (int q = 0; q < QUERIES; ++q)
+		pairs[q] = std::make_pair(nodes[rng() % nodes.size()], nodes[rng() % nodes.size()]);
+
+	std::vector<float> expected(QUERIES);
+	double settled = 0;
+	t0 = Clock::now();
+	for (int q = 0; q < QUERIES; ++q)
+	{
+		expected[q] = ps.astar(pairs[q].first->id, pairs[q].second->id);
+		settled += ps.getSettled();
+	}
+	double astar = msSince(t0) / QUERIES;
+	printf("query    astar        %10.0f settled %10.3f\n", settled / QUERIES, astar);
+
+	std::vector<Node*> path;
+	int mismatches = 0;
+	settled = 0;
+	t0 = Clock::now();
+	for (int q = 0; q < QUERIES; ++q)
+	{
+		float d = hs.findPath(pairs[q].first, pairs[q].second, path);
+		settled += hs.getSettled();
+		if (!same(d, expected[q])) ++mismatches;
+	}
+	double hierarchical = msSince(t0) / QUERIES;
+	printf("query    hierarchical %10.0f settled %10.3f%s\n\n", settled / QUERIES, hierarchical,
+		mismatches ? "   MISMATCH" : "");
+
+	// Drags of a disc holding about 1% of the nodes, back and forth
+	Selection selection(6, 0.f, 0.f, WORLD, WORLD);
+	selectDisc(b, selection, WORLD * 0.05f);
+	Node * s = pairs[0].first;
+	Node * t = pairs[0].second;
+
+	t0 = Clock::now();
+	float tracked = 0;
+	for (int f = 0; f < FRAMES; ++f)
+	{
+		float d = f % 2 ? -2.f : 2.f;
+		selection.moveSelection(d, d);
+		hs.touch(selection.getNodes());
+		tracked = hs.findPath(s, t, path);
+	}
+	double incremental = msSince(t0) / FRAMES;
+
+	b.graph.buildSearchGraph(sg);
+	PathSearch check(sg);
+	float exact = check.astar(s->id, t->id);
+
+	t0 = Clock::now();
+	for (int f = 0; f < REBUILD_FRAMES; ++f)
+	{
+		float d = f % 2 ? -2.f : 2.f;
+		selection.moveSelection(d, d);
+		hs.rebuild();
+		hs.findPath(s, t, path);
+	}
+	double rebuilt = msSince(t0) / REBUILD_FRAMES;
+
+	printf("drag     %zu nodes, per frame: incremental %10.3f   rebuild %10.1f%s\n",
+		selection.size(), incremental, rebuilt, same(tracked, exact) ? "" : "   MISMATCH");
+
+	selection.clearSelection();
+	return 0;
+}
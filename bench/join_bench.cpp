@@ -0,0 +1,237 @@
+/*///=====================================================================
+
+	join_bench.cpp
+
+	Automatic edge generation on n uniform random nodes:
+
+		pairs	finding every pair within r (expected degree 8): a region
+				query per node, against radiusJoin on one thread and on all
+				of them (4 on a single core)
+		knn		finding each node's 6 nearest with nearestJoin
+		edges	creating the found edges one Edge::createEdge at a time
+				(outside a transaction, as ctrl-clicking does), against
+				the bulk Edge::createEdges path
+		total	joining and then creating the edges in bulk, split into
+				the two phases, with the join on one thread and on all of
+				them; then Graph::connectWithin and Graph::connectNearest
+				on the whole graph. Node/edge sets and quadtrees are bound
+				as in the editor
+
+	Reports ms.
+
+		join_bench [n] [seed]
+
+	Links the editor sources (with -pthread) and SFML's graphics module
+	(for the shapes).
+
+*///======================================================================
+
+#include "edge.h"
+#include "generators.h"
+#include "graph.h"
+#include "node.h"
+#include "quadtree.h"
+#include "spatialjoin.h"
+
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+	const float WORLD = 10000;
+	const float DEGREE = 8;
+	const unsigned int K = 6;
+
+	typedef std::chrono::steady_clock Clock;
+	typedef std::vector<std::pair<Node*, Node*> > Pairs;
+
+	double msSince(Clock::time_point t0)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+	}
+
+	//
+	// An editor-like graph: node/edge sets and quadtrees bound
+	//
+	struct Bound
+	{
+		Bound()
+			: qtn(0, 0, WORLD, WORLD, 8, 16)
+			, qte(0, 0, WORLD, WORLD, 8, 16)
+		{
+			graph.setNodeSet(&nodes);
+			graph.setNodeIndex(&qtn);
+			graph.setEdgeSet(&edges);
+			graph.setEdgeIndex(&qte);
+		}
+		~Bound()
+		{
+			graph.clear();
+		}
+		std::set<Node*> nodes;
+		QuadTree<Node*> qtn;
+		std::set<Edge*> edges;
+		QuadTree<Edge*> qte;
+		Graph graph;
+	};
+
+	void addNodes(Graph & graph, const std::vector<float> & x, const std::vector<float> & y, uint32_t n)
+	{
+		GeneratedGraph g;
+		g.x.assign(x.begin(), x.begin() + n);
+		g.y.assign(y.begin(), y.begin() + n);
+		graph.instantiate(g);
+	}
+
+	//
+	// The pairs a region query per node finds
+	//
+	size_t queryPairs(QuadTree<Node*> & qt, const Graph & graph, float r, Pairs & ret)
+	{
+		std::vector<Node*> near;
+		for (Slab<Node>::iterator it = graph.nodes.begin(); it != graph.nodes.end(); ++it)
+		{
+			Node * n = *it;
+			near.clear();
+			qt.queryRegion(n->x - r, n->y - r, n->x + r, n->y + r, near);
+			for (size_t k = 0; k < near.size(); ++k)
+			{
+				Node * o = near[k];
+				if (o->id <= n->id) continue;
+				float dx = o->x - n->x, dy = o->y - n->y;
+				if (dx*dx + dy*dy <= r*r) ret.push_back(std::make_pair(n, o));
+			}
+		}
+		return ret.size();
+	}
+
+	//
+	// Joins (within r, or the k nearest if r is 0) on the given number of
+	// threads and creates the found edges in bulk, printing both phases
+	//
+	void joinAndCreate(const std::vector<float> & x, const std::vector<float> & y, uint32_t n, float r, unsigned int threads)
+	{
+		Bound b;
+		addNodes(b.graph, x, y, n);
+		Pairs p;
+		Clock::time_point t0 = Clock::now();
+		if (r > 0) radiusJoin(b.qtn, r, p, threads);
+		else nearestJoin(b.qtn, K, p, threads);
+		double join = msSince(t0);
+		t0 = Clock::now();
+		int created = Edge::createEdges(p);
+		double edges = msSince(t0);
+		printf("total    %s %u thread%s: %d edges   join %10.1f   edges %10.1f   sum %10.1f\n",
+			r > 0 ? "within " : "nearest", threads, threads == 1 ? " " : "s", created, join, edges, join + edges);
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	uint32_t n = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000000;
+	uint32_t seed = argc > 2 ? (uint32_t)atoi(argv[2]) : 1;
+	float r = sqrtf(DEGREE * WORLD * WORLD / (3.14159265f * n));
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> u(0, WORLD);
+	std::vector<float> x(n), y(n);
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		x[i] = u(rng);
+		y[i] = u(rng);
+	}
+	// Several threads even on one core, so the split overhead shows
+	unsigned int many = hardwareThreads() > 1 ? hardwareThreads() : 4;
+	printf("%u nodes, r %.2f, %u hardware threads; ms\n\n", n, r, hardwareThreads());
+
+	// Pair finding
+	{
+		Bound b;
+		addNodes(b.graph, x, y, n);
+
+		Pairs p;
+		Clock::time_point t0 = Clock::now();
+		queryPairs(b.qtn, b.graph, r, p);
+		double query = msSince(t0);
+		size_t expected = p.size();
+
+		p.clear();
+		t0 = Clock::now();
+		radiusJoin(b.qtn, r, p, 1);
+		double join1 = msSince(t0);
+		size_t found1 = p.size();
+
+		p.clear();
+		t0 = Clock::now();
+		radiusJoin(b.qtn, r, p, many);
+		double joinN = msSince(t0);
+
+		printf("pairs    %zu: region queries %10.1f   join 1 thread %10.1f   join %u threads %10.1f%s\n",
+			p.size(), query, join1, many, joinN, found1 == expected && p.size() == expected ? "" : "   MISMATCH");
+
+		p.clear();
+		t0 = Clock::now();
+		nearestJoin(b.qtn, K, p, 1);
+		double knn1 = msSince(t0);
+		p.clear();
+		t0 = Clock::now();
+		nearestJoin(b.qtn, K, p, many);
+		double knnN = msSince(t0);
+		printf("knn      %zu: %26s   join 1 thread %10.1f   join %u threads %10.1f\n\n",
+			p.size(), "", knn1, many, knnN);
+	}
+
+	// Edge creation
+	double single, bulk;
+	size_t count;
+	{
+		Bound b;
+		addNodes(b.graph, x, y, n);
+		Pairs p;
+		radiusJoin(b.qtn, r, p);
+		count = p.size();
+		Clock::time_point t0 = Clock::now();
+		for (size_t i = 0; i < p.size(); ++i)
+			Edge::createEdge(p[i].first, p[i].second);
+		single = msSince(t0);
+	}
+	{
+		Bound b;
+		addNodes(b.graph, x, y, n);
+		Pairs p;
+		radiusJoin(b.qtn, r, p);
+		Clock::time_point t0 = Clock::now();
+		Edge::createEdges(p);
+		bulk = msSince(t0);
+	}
+	printf("edges    %zu: one at a time %10.1f   bulk %10.1f\n\n", count, single, bulk);
+
+	// Join and bulk creation, by thread count
+	joinAndCreate(x, y, n, r, 1);
+	joinAndCreate(x, y, n, r, many);
+	joinAndCreate(x, y, n, 0, 1);
+	joinAndCreate(x, y, n, 0, many);
+	printf("\n");
+
+	// Whole graph
+	{
+		Bound b;
+		addNodes(b.graph, x, y, n);
+		Clock::time_point t0 = Clock::now();
+		int created = b.graph.connectWithin(r);
+		printf("total    connectWithin:  %d edges %10.1f\n", created, msSince(t0));
+	}
+	{
+		Bound b;
+		addNodes(b.graph, x, y, n);
+		Clock::time_point t0 = Clock::now();
+		int created = b.graph.connectNearest(K);
+		printf("total    connectNearest: %d edges %10.1f\n", created, msSince(t0));
+	}
+	return 0;
+}
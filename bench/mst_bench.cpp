@@ -0,0 +1,190 @@
+/*///=====================================================================
+
+	mst_bench.cpp
+
+	Minimum spanning trees on seeded synthetic graphs (GraphGenerator):
+
+		forest	minimumSpanningForest (parallel Boruvka over the CSR view)
+				on one thread and on all of them, against Kruskal (sort
+				the edges, then a union-find), on a random geometric graph
+				and on a grid with diagonals (all weights tie)
+		emst	euclideanSpanningTree on the geometric graph's points, on
+				one thread and on all of them
+		check	euclideanSpanningTree against Prim over all pairs, on a
+				small point set
+
+	Reports ms; tree weights are compared and a mismatch is flagged.
+
+	Headless; builds without SFML:
+
+		g++ -O2 -std=c++11 -pthread -DQUADTREE_NO_SFML -Isrc bench/mst_bench.cpp
+			src/generators.cpp src/search.cpp src/spanningtree.cpp -o mst_bench
+
+		mst_bench [n] [seed]
+
+*///======================================================================
+
+#include "generators.h"
+#include "parallel.h"
+#include "search.h"
+#include "spanningtree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+	const float WORLD = 10000;
+	const uint32_t CHECK_POINTS = 5000;
+
+	typedef std::chrono::steady_clock Clock;
+
+	double msSince(Clock::time_point t0)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+	}
+
+	float length(const GeneratedGraph & g, uint32_t a, uint32_t b)
+	{
+		float dx = g.x[b] - g.x[a], dy = g.y[b] - g.y[a];
+		return sqrtf(dx*dx + dy*dy);
+	}
+
+	uint32_t find(std::vector<uint32_t> & parent, uint32_t v)
+	{
+		while (parent[v] != v)
+		{
+			parent[v] = parent[parent[v]];
+			v = parent[v];
+		}
+		return v;
+	}
+
+	//
+	// Weight of a minimum spanning forest by Kruskal's algorithm
+	//
+	double kruskal(const GeneratedGraph & g)
+	{
+		std::vector<std::pair<float, uint32_t> > order(g.edges.size());
+		for (size_t i = 0; i < g.edges.size(); ++i)
+			order[i] = std::make_pair(length(g, g.edges[i].first, g.edges[i].second), (uint32_t)i);
+		std::sort(order.begin(), order.end());
+
+		std::vector<uint32_t> parent(g.x.size());
+		for (size_t v = 0; v < parent.size(); ++v) parent[v] = (uint32_t)v;
+		double weight = 0;
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			uint32_t a = find(parent, g.edges[order[i].second].first);
+			uint32_t b = find(parent, g.edges[order[i].second].second);
+			if (a == b) continue;
+			parent[a] = b;
+			weight += order[i].first;
+		}
+		return weight;
+	}
+
+	//
+	// Weight of a Euclidean minimum spanning tree by Prim's algorithm over
+	// all pairs
+	//
+	double prim(const std::vector<float> & x, const std::vector<float> & y)
+	{
+		size_t n = x.size();
+		std::vector<double> dist(n, 1e30);
+		std::vector<char> done(n, 0);
+		dist[0] = 0;
+		double weight = 0;
+		for (size_t k = 0; k < n; ++k)
+		{
+			size_t best = n;
+			for (size_t i = 0; i < n; ++i)
+			{
+				if (!done[i] && (best == n || dist[i] < dist[best])) best = i;
+			}
+			done[best] = 1;
+			weight += dist[best];
+			for (size_t i = 0; i < n; ++i)
+			{
+				if (done[i]) continue;
+				double dx = x[i] - x[best], dy = y[i] - y[best];
+				dist[i] = std::min(dist[i], sqrt(dx*dx + dy*dy));
+			}
+		}
+		return weight;
+	}
+
+	bool same(double a, double b)
+	{
+		return fabs(a - b) <= 1e-6 * std::max(fabs(a), 1.0);
+	}
+
+	void forest(const char * name, const GeneratedGraph & g)
+	{
+		SearchGraph sg;
+		sg.build(g);
+
+		Clock::time_point t0 = Clock::now();
+		double expected = kruskal(g);
+		double sequential = msSince(t0);
+
+		IndexPairs tree;
+		t0 = Clock::now();
+		double w1 = minimumSpanningForest(sg, tree, 1);
+		double boruvka1 = msSince(t0);
+
+		tree.clear();
+		t0 = Clock::now();
+		double wN = minimumSpanningForest(sg, tree);
+		double boruvkaN = msSince(t0);
+
+		printf("forest   %-9s %8zu edges: kruskal %8.1f   boruvka 1 thread %8.1f   %u threads %8.1f%s\n",
+			name, g.edges.size(), sequential, boruvka1, hardwareThreads(), boruvkaN,
+			same(w1, expected) && same(wN, expected) ? "" : "   MISMATCH");
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	uint32_t n = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000000;
+	uint32_t seed = argc > 2 ? (uint32_t)atoi(argv[2]) : 1;
+	printf("%u nodes, %u threads; ms\n\n", n, hardwareThreads());
+
+	GraphGenerator gen(seed, 0, 0, WORLD, WORLD);
+	GeneratedGraph geometric;
+	gen.geometric(n, 0, geometric);
+	forest("geometric", geometric);
+
+	GeneratedGraph grid;
+	uint32_t side = (uint32_t)sqrt((double)n);
+	gen.grid(side, side, true, grid);
+	forest("grid", grid);
+
+	IndexPairs tree;
+	Clock::time_point t0 = Clock::now();
+	double w1 = euclideanSpanningTree(geometric.x, geometric.y, tree, 8, 1);
+	double emst1 = msSince(t0);
+	tree.clear();
+	t0 = Clock::now();
+	double wN = euclideanSpanningTree(geometric.x, geometric.y, tree);
+	double emstN = msSince(t0);
+	printf("\nemst     %u points: 1 thread %8.1f   %u threads %8.1f%s\n",
+		n, emst1, hardwareThreads(), emstN, same(w1, wN) ? "" : "   MISMATCH");
+
+	std::vector<float> x(geometric.x.begin(), geometric.x.begin() + std::min(n, CHECK_POINTS));
+	std::vector<float> y(geometric.y.begin(), geometric.y.begin() + std::min(n, CHECK_POINTS));
+	tree.clear();
+	t0 = Clock::now();
+	double w = euclideanSpanningTree(x, y, tree);
+	double knn = msSince(t0);
+	t0 = Clock::now();
+	double expected = prim(x, y);
+	double all = msSince(t0);
+	printf("check    %zu points: k nearest %8.1f   all pairs %8.1f%s\n",
+		x.size(), knn, all, same(w, expected) ? "" : "   MISMATCH");
+	return 0;
+}
@@ -0,0 +1,326 @@
+/*///=====================================================================
+
+	persistent_bench.cpp
+
+	PersistentQuadTree against QuadTree:
+
+		copy	taking a snapshot, against deep copying a QuadTree (all items
+				into a new tree with a bulk insert)
+		update	insert, move (small drags) and erase, with no snapshot held
+				and with a snapshot taken every 1, 16 and 256 updates (the
+				cost of path copying)
+		undo	erasing a 10% block with eraseIf and undoing it: restoring a
+				snapshot, against reinserting the erased items
+		reader	region queries on a snapshot in a background thread while
+				the main thread keeps moving items and publishing snapshots
+
+	Reports ns per op.
+
+		g++ -O2 -std=c++11 -pthread bench/persistent_bench.cpp -o persistent_bench
+
+		persistent_bench [n] [seed]
+
+*///======================================================================
+
+#define QUADTREE_NO_SFML
+#include "../src/persistentquadtree.h"
+#include "../src/quadtree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const float WORLD = 4000;
+	const int CAPACITY = 8;
+	const int DEPTH = 14;
+
+	typedef std::chrono::steady_clock Clock;
+	typedef PersistentQuadTree<int> Tree;
+
+	double nsSince(Clock::time_point t0, double ops)
+	{
+		return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / std::max(1.0, ops);
+	}
+
+	struct Points
+	{
+		std::vector<int> id;
+		std::vector<float> x;
+		std::vector<float> y;
+	};
+
+	Points makePoints(int n, std::mt19937 & rng)
+	{
+		std::uniform_real_distribution<float> u(0, WORLD);
+		Points p;
+		for (int i = 0; i < n; ++i)
+		{
+			p.id.push_back(i);
+			p.x.push_back(u(rng));
+			p.y.push_back(u(rng));
+		}
+		return p;
+	}
+
+	float clamp(float v)
+	{
+		return std::min(std::max(v, 0.f), WORLD - 1);
+	}
+
+	struct InBlock
+	{
+		InBlock(const Points & p) : p(p) {}
+		bool operator()(int i) const { return p.x[i] < WORLD / 10; }
+		const Points & p;
+	};
+
+	//
+	// Snapshot copy against deep copy
+	//
+	void copies(const Points & p)
+	{
+		Tree t(0, 0, WORLD, WORLD, CAPACITY, DEPTH);
+		t.insert(p.id, p.x, p.y);
+		QuadTree<int> qt(0, 0, WORLD, WORLD, CAPACITY, DEPTH);
+		qt.insert(p.id, p.x, p.y);
+
+		const int R = 1000;
+		Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < R; ++i)
+		{
+			Tree::Snapshot s = t.snapshot();
+			if (!s.valid()) abort();
+		}
+		double snap = nsSince(t0, R);
+
+		const int D = 5;
+		t0 = Clock::now();
+		for (int i = 0; i < D; ++i)
+		{
+			// QuadTree cannot be copied; a copy is a rebuild
+			std::vector<int> data;
+			qt.getAllItems(data);
+			std::vector<float> xs, ys;
+			for (size_t k = 0; k < data.size(); ++k)
+			{
+				xs.push_back(p.x[data[k]]);
+				ys.push_back(p.y[data[k]]);
+			}
+			QuadTree<int> copy(0, 0, WORLD, WORLD, CAPACITY, DEPTH);
+			copy.insert(data, xs, ys);
+		}
+		double deep = nsSince(t0, D);
+		printf("copy     snapshot %12.1f ns   QuadTree deep copy %12.1f ns\n\n", snap, deep);
+	}
+
+	//
+	// Updates, with a snapshot taken every `every` updates (0: never)
+	//
+	void updates(const Points & p0, int every, std::mt19937 & rng)
+	{
+		Points p = p0;
+		Tree t(0, 0, WORLD, WORLD, CAPACITY, DEPTH);
+		std::uniform_real_distribution<float> step(-2, 2);
+		std::uniform_int_distribution<int> pick(0, (int)p.id.size() - 1);
+		std::vector<Tree::Snapshot> history; // the last 64, as an undo stack
+
+		Clock::time_point t0 = Clock::now();
+		for (size_t i = 0; i < p.id.size(); ++i)
+		{
+			t.insert(p.id[i], p.x[i], p.y[i]);
+			if (every && i % every == 0) history.push_back(t.snapshot());
+			if (history.size() > 64) history.erase(history.begin());
+		}
+		double ins = nsSince(t0, (double)p.id.size());
+
+		const int M = 200000;
+		t0 = Clock::now();
+		for (int i = 0; i < M; ++i)
+		{
+			int k = pick(rng);
+			float nx = clamp(p.x[k] + step(rng)), ny = clamp(p.y[k] + step(rng));
+			t.move(k, p.x[k], p.y[k], nx, ny);
+			p.x[k] = nx;
+			p.y[k] = ny;
+			if (every && i % every == 0) history.push_back(t.snapshot());
+			if (history.size() > 64) history.erase(history.begin());
+		}
+		double mv = nsSince(t0, M);
+
+		t0 = Clock::now();
+		for (size_t i = 0; i < p.id.size(); ++i)
+		{
+			t.erase(p.id[i], p.x[i], p.y[i]);
+			if (every && i % every == 0) history.push_back(t.snapshot());
+			if (history.size() > 64) history.erase(history.begin());
+		}
+		double er = nsSince(t0, (double)p.id.size());
+
+		char label[32];
+		if (every) sprintf(label, "snap/%d", every);
+		else sprintf(label, "none");
+		printf("update   %-9s insert %8.1f   move %8.1f   erase %8.1f ns\n", label, ins, mv, er);
+	}
+
+	void quadTreeUpdates(const Points & p0, std::mt19937 & rng)
+	{
+		Points p = p0;
+		QuadTree<int> t(0, 0, WORLD, WORLD, CAPACITY, DEPTH);
+		std::uniform_real_distribution<float> step(-2, 2);
+		std::uniform_int_distribution<int> pick(0, (int)p.id.size() - 1);
+
+		Clock::time_point t0 = Clock::now();
+		for (size_t i = 0; i < p.id.size(); ++i)
+			t.insert(p.id[i], p.x[i], p.y[i]);
+		double ins = nsSince(t0, (double)p.id.size());
+
+		const int M = 200000;
+		t0 = Clock::now();
+		for (int i = 0; i < M; ++i)
+		{
+			int k = pick(rng);
+			float nx = clamp(p.x[k] + step(rng)), ny = clamp(p.y[k] + step(rng));
+			t.move(k, p.x[k], p.y[k], nx, ny);
+			p.x[k] = nx;
+			p.y[k] = ny;
+		}
+		double mv = nsSince(t0, M);
+
+		t0 = Clock::now();
+		for (size_t i = 0; i < p.id.size(); ++i)
+			t.erase(p.id[i], p.x[i], p.y[i]);
+		double er = nsSince(t0, (double)p.id.size());
+		printf("update   %-9s insert %8.1f   move %8.1f   erase %8.1f ns\n\n", "QuadTree", ins, mv, er);
+	}
+
+	//
+	// Undo of a large erase
+	//
+	void undo(const Points & p)
+	{
+		Tree t(0, 0, WORLD, WORLD, CAPACITY, DEPTH);
+		t.insert(p.id, p.x, p.y);
+		QuadTree<int> qt(0, 0, WORLD, WORLD, CAPACITY, DEPTH);
+		qt.insert(p.id, p.x, p.y);
+		InBlock block(p);
+
+		Tree::Snapshot before = t.snapshot();
+		Clock::time_point t0 = Clock::now();
+		int erased = t.eraseIf(block, 0, 0, WORLD / 10, WORLD);
+		double edit = nsSince(t0, 1);
+		t0 = Clock::now();
+		t.restore(before);
+		double restore = nsSince(t0, 1);
+
+		t0 = Clock::now();
+		std::vector<int> gone;
+		qt.queryRegion(0.f, 0.f, WORLD / 10, WORLD, gone);
+		qt.eraseIf(block, 0, 0, WORLD / 10, WORLD);
+		double qtEdit = nsSince(t0, 1);
+		t0 = Clock::now();
+		std::vector<float> xs, ys;
+		for (size_t k = 0; k < gone.size(); ++k)
+		{
+			xs.push_back(p.x[gone[k]]);
+			ys.push_back(p.y[gone[k]]);
+		}
+		qt.insert(gone, xs, ys);
+		double reinsert = nsSince(t0, 1);
+
+		if (t.numItems() != qt.numItems()) printf("MISMATCH: %d != %d\n", t.numItems(), qt.numItems());
+		printf("undo     %d items: erase %10.0f ns, restore %8.0f ns   QuadTree: erase %10.0f ns, reinsert %10.0f ns\n\n",
+			erased, edit, restore, qtEdit, reinsert);
+	}
+
+	//
+	// Background reader on published snapshots
+	//
+	void reader(const Points & p0, std::mt19937 & rng)
+	{
+		Points p = p0;
+		Tree t(0, 0, WORLD, WORLD, CAPACITY, DEPTH);
+		t.insert(p.id, p.x, p.y);
+
+		std::mutex m;
+		Tree::Snapshot published = t.snapshot();
+		std::atomic<bool> stop(false);
+		std::atomic<long> queries(0);
+		std::atomic<long> wrong(0);
+		int n = (int)p.id.size();
+
+		std::thread bg([&]()
+		{
+			std::mt19937 r(1);
+			std::uniform_real_distribution<float> u(0, WORLD - 100);
+			std::vector<int> v;
+			while (!stop)
+			{
+				Tree::Snapshot s;
+				{
+					std::lock_guard<std::mutex> lock(m);
+					s = published;
+				}
+				for (int i = 0; i < 100; ++i)
+				{
+					float x = u(r), y = u(r);
+					v.clear();
+					s.queryRegion(x, y, x + 100, y + 100, v);
+				}
+				if (s.numItems() != n) ++wrong;
+				queries += 100;
+			}
+		});
+
+		std::uniform_real_distribution<float> step(-2, 2);
+		std::uniform_int_distribution<int> pick(0, n - 1);
+		const int M = 200000;
+		Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < M; ++i)
+		{
+			int k = pick(rng);
+			float nx = clamp(p.x[k] + step(rng)), ny = clamp(p.y[k] + step(rng));
+			t.move(k, p.x[k], p.y[k], nx, ny);
+			p.x[k] = nx;
+			p.y[k] = ny;
+			if (i % 64 == 0)
+			{
+				Tree::Snapshot s = t.snapshot();
+				std::lock_guard<std::mutex> lock(m);
+				published = s;
+			}
+		}
+		double mv = nsSince(t0, M);
+		stop = true;
+		bg.join();
+		double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+		printf("reader   writer move %8.1f ns, publishing every 64   reader %10.0f queries/s%s\n",
+			mv, queries / secs, wrong ? "   MISMATCH" : "");
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	int n = argc > 1 ? atoi(argv[1]) : 200000;
+	unsigned int seed = argc > 2 ? (unsigned int)atoi(argv[2]) : 1;
+	std::mt19937 rng(seed);
+	Points p = makePoints(n, rng);
+
+	printf("%d points, capacity %d, depth %d\n\n", n, CAPACITY, DEPTH);
+	copies(p);
+	updates(p, 0, rng);
+	updates(p, 256, rng);
+	updates(p, 16, rng);
+	updates(p, 1, rng);
+	quadTreeUpdates(p, rng);
+	undo(p);
+	reader(p, rng);
+	return 0;
+}
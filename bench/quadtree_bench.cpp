@@ -0,0 +1,411 @@
+/*///=====================================================================
+
+	quadtree_bench.cpp
+
+	Micro-benchmarks for QuadTree<T>: insert, the three erase overloads,
+	move, queryRegion and getAllItems, over uniform, clustered and
+	line-like point sets, for a grid of MAX_ITEMS_PER_CELL / MAX_DEPTH
+	settings. Reports mean ns/op, p50/p99 latency and heap allocations per
+	op, as a table, CSV or JSON.
+
+	No dependencies beyond the standard library:
+
+		g++ -O2 -std=c++11 bench/quadtree_bench.cpp -o quadtree_bench
+
+	Options (comma-separated lists):
+
+		--sizes 1000,10000,100000
+		--caps 4,8,16,32          MAX_ITEMS_PER_CELL; 0 = adaptive mode
+		                          (QuadTree::setAdaptive), starting at 8
+		--depths 8,10,12          MAX_DEPTH
+		--dists uniform,clustered,lines
+		--format table|csv|json
+		--seed N
+		--stats 1                 print QuadTree::stats() after each build
+		                          and after the move phase (to stderr)
+
+*///======================================================================
+
+#define QUADTREE_NO_SFML
+#include "../src/quadtree.h"
+#include "alloc_count.h"
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const float WORLD = 1000;
+
+	typedef std::chrono::steady_clock Clock;
+	typedef std::mt19937 Rng;
+
+	struct Point
+	{
+		float x;
+		float y;
+	};
+
+	float clampWorld(float v)
+	{
+		if (v < 0) return 0;
+		if (v >= WORLD) return WORLD - 0.001f;
+		return v;
+	}
+
+	//
+	// Point distributions
+	//
+
+	std::vector<Point> generate(const std::string & dist, int n, Rng & rng)
+	{
+		std::vector<Point> ret(n);
+		std::uniform_real_distribution<float> u(0, WORLD);
+
+		if (dist == "clustered")
+		{
+			// Gaussian blobs of varying spread
+			int clusters = std::max(1, n / 2000 + 4);
+			std::vector<Point> centers(clusters);
+			std::vector<float> spread(clusters);
+			std::uniform_real_distribution<float> s(WORLD/200, WORLD/25);
+			for (int i = 0; i < clusters; ++i)
+			{
+				centers[i].x = u(rng);
+				centers[i].y = u(rng);
+				spread[i] = s(rng);
+			}
+			std::uniform_int_distribution<int> pick(0, clusters-1);
+			std::normal_distribution<float> g(0, 1);
+			for (int i = 0; i < n; ++i)
+			{
+				int c = pick(rng);
+				ret[i].x = clampWorld(centers[c].x + g(rng) * spread[c]);
+				ret[i].y = clampWorld(centers[c].y + g(rng) * spread[c]);
+			}
+		}
+		else if (dist == "lines")
+		{
+			// Points strung along random segments, like road networks
+			int lines = std::max(1, n / 500 + 8);
+			std::vector<Point> a(lines), b(lines);
+			for (int i = 0; i < lines; ++i)
+			{
+				a[i].x = u(rng); a[i].y = u(rng);
+				b[i].x = u(rng); b[i].y = u(rng);
+			}
+			std::uniform_int_distribution<int> pick(0, lines-1);
+			std::uniform_real_distribution<float> t(0, 1);
+			std::normal_distribution<float> g(0, WORLD/2000);
+			for (int i = 0; i < n; ++i)
+			{
+				int l = pick(rng);
+				float k = t(rng);
+				ret[i].x = clampWorld(a[l].x + (b[l].x - a[l].x) * k + g(rng));
+				ret[i].y = clampWorld(a[l].y + (b[l].y - a[l].y) * k + g(rng));
+			}
+		}
+		else
+		{
+			for (int i = 0; i < n; ++i)
+			{
+				ret[i].x = u(rng);
+				ret[i].y = u(rng);
+			}
+		}
+		return ret;
+	}
+
+	//
+	// Measurement
+	//
+
+	struct Result
+	{
+		std::string op;
+		std::string dist;
+		int n;
+		int cap;
+		int depth;
+		size_t ops;
+		double nsPerOp;
+		double p50;
+		double p99;
+		double allocsPerOp;
+	};
+
+	double timerOverhead = 0;
+	bool showStats = false;
+
+	double elapsedNs(Clock::time_point a, Clock::time_point b)
+	{
+		return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(b - a).count();
+	}
+
+	//
+	// Times fn(i) for i in [0, ops) individually, for the latency percentiles,
+	// with the clock's own overhead subtracted.
+	//
+	template<typename Fn>
+	Result measure(const char * op, size_t ops, Fn fn)
+	{
+		std::vector<double> samples(ops);
+		unsigned long long allocs = allocations;
+		double total = 0;
+		for (size_t i = 0; i < ops; ++i)
+		{
+			Clock::time_point t0 = Clock::now();
+			fn(i);
+			Clock::time_point t1 = Clock::now();
+			double ns = elapsedNs(t0, t1) - timerOverhead;
+			samples[i] = ns > 0 ? ns : 0;
+			total += samples[i];
+		}
+		allocs = allocations - allocs;
+
+		Result r;
+		r.op = op;
+		r.ops = ops;
+		r.nsPerOp = ops ? total / ops : 0;
+		r.allocsPerOp = ops ? (double)allocs / ops : 0;
+		r.p50 = r.p99 = 0;
+		if (ops)
+		{
+			std::sort(samples.begin(), samples.end());
+			r.p50 = samples[ops/2];
+			r.p99 = samples[std::min(ops-1, ops*99/100)];
+		}
+		return r;
+	}
+
+	void calibrate()
+	{
+		std::vector<double> s(10000);
+		for (size_t i = 0; i < s.size(); ++i)
+		{
+			Clock::time_point t0 = Clock::now();
+			Clock::time_point t1 = Clock::now();
+			s[i] = elapsedNs(t0, t1);
+		}
+		std::sort(s.begin(), s.end());
+		timerOverhead = s[s.size()/2];
+	}
+
+	QuadTree<int> * makeTree(int cap, int depth)
+	{
+		QuadTree<int> * qt = new QuadTree<int>(0, 0, WORLD, WORLD, cap ? cap : 8, depth);
+		if (!cap) qt->setAdaptive(true);
+		return qt;
+	}
+
+	void printStats(const char * when, const std::string & dist, int n, int cap, int depth, QuadTree<int> & qt)
+	{
+		QuadTree<int>::Stats s = qt.stats();
+		fprintf(stderr, "%s %s n=%d cap=%d depth=%d: limits %d/%d, %d cells, %d leaves (%.1f%% empty), deepest %d, %d stuck, %.1f KB\n",
+			when, dist.c_str(), n, cap, depth, qt.getMaxItemsPerCell(), qt.getMaxDepth(), s.cells, s.leaves, 100 * s.emptyRatio(), s.deepest, s.itemsStuck, s.bytes / 1024.0);
+		fprintf(stderr, "  cells/depth:");
+		for (size_t i = 0; i < s.cellsAtDepth.size(); ++i) fprintf(stderr, " %d", s.cellsAtDepth[i]);
+		fprintf(stderr, "\n  items/depth:");
+		for (size_t i = 0; i < s.itemsAtDepth.size(); ++i) fprintf(stderr, " %d", s.itemsAtDepth[i]);
+		fprintf(stderr, "\n  leaves by occupancy:");
+		for (size_t i = 0; i < s.occupancy.size(); ++i) fprintf(stderr, " %d", s.occupancy[i]);
+		fprintf(stderr, "\n");
+	}
+
+	//
+	// Benchmarks for one configuration
+	//
+
+	void run(const std::string & dist, int n, int cap, int depth, Rng & rng, std::vector<Result> & results)
+	{
+		std::vector<Point> pts = generate(dist, n, rng);
+		std::vector<Result> rs;
+
+		// insert
+		QuadTree<int> * qt = makeTree(cap, depth);
+		rs.push_back(measure("insert", n, [&](size_t i) { qt->insert((int)i, pts[i].x, pts[i].y); }));
+		if (showStats) printStats("built", dist, n, cap, depth, *qt);
+
+		// queryRegion: windows of 0.1% of the world's area
+		{
+			float side = WORLD * 0.0316f;
+			std::uniform_real_distribution<float> u(0, WORLD - side);
+			std::vector<Point> q(2000);
+			for (size_t i = 0; i < q.size(); ++i) { q[i].x = u(rng); q[i].y = u(rng); }
+			std::vector<int> ret;
+			ret.reserve(n);
+			rs.push_back(measure("queryRegion", q.size(), [&](size_t i) {
+				ret.clear();
+				qt->queryRegion(q[i].x, q[i].y, q[i].x + side, q[i].y + side, ret);
+			}));
+		}
+
+		// getAllItems
+		{
+			std::vector<int> ret;
+			ret.reserve(n);
+			rs.push_back(measure("getAllItems", 20, [&](size_t) { ret.clear(); qt->getAllItems(ret); }));
+		}
+
+		// move: small jitter, like dragging
+		{
+			size_t ops = std::min<size_t>(n, 20000);
+			std::normal_distribution<float> g(0, WORLD/200);
+			std::vector<Point> to(ops);
+			for (size_t i = 0; i < ops; ++i)
+			{
+				to[i].x = clampWorld(pts[i].x + g(rng));
+				to[i].y = clampWorld(pts[i].y + g(rng));
+			}
+			rs.push_back(measure("move", ops, [&](size_t i) {
+				qt->move((int)i, pts[i].x, pts[i].y, to[i].x, to[i].y);
+				pts[i] = to[i];
+			}));
+			if (showStats) printStats("moved", dist, n, cap, depth, *qt);
+		}
+
+		// erase(data, x, y)
+		{
+			size_t ops = std::min<size_t>(n, 20000);
+			rs.push_back(measure("erase(point)", ops, [&](size_t i) { qt->erase((int)i, pts[i].x, pts[i].y); }));
+		}
+		delete qt;
+
+		// erase(data, region): a small box around the item
+		{
+			QuadTree<int> * t = makeTree(cap, depth);
+			for (int i = 0; i < n; ++i) t->insert(i, pts[i].x, pts[i].y);
+			size_t ops = std::min<size_t>(n, 5000);
+			rs.push_back(measure("erase(region)", ops, [&](size_t i) { t->erase((int)i, pts[i].x-1, pts[i].y-1, pts[i].x+1, pts[i].y+1); }));
+			delete t;
+		}
+
+		// erase(data): full search
+		{
+			QuadTree<int> * t = makeTree(cap, depth);
+			for (int i = 0; i < n; ++i) t->insert(i, pts[i].x, pts[i].y);
+			size_t ops = std::min<size_t>(n, 200);
+			rs.push_back(measure("erase(data)", ops, [&](size_t i) { t->erase((int)(n-1-i)); }));
+			delete t;
+		}
+
+		for (size_t i = 0; i < rs.size(); ++i)
+		{
+			rs[i].dist = dist;
+			rs[i].n = n;
+			rs[i].cap = cap;
+			rs[i].depth = depth;
+			results.push_back(rs[i]);
+		}
+	}
+
+	//
+	// Options
+	//
+
+	std::vector<std::string> split(const std::string & s)
+	{
+		std::vector<std::string> ret;
+		size_t b = 0;
+		while (b <= s.size())
+		{
+			size_t e = s.find(',', b);
+			if (e == std::string::npos) e = s.size();
+			if (e > b) ret.push_back(s.substr(b, e-b));
+			b = e+1;
+		}
+		return ret;
+	}
+
+	std::vector<int> splitInts(const std::string & s)
+	{
+		std::vector<std::string> v = split(s);
+		std::vector<int> ret;
+		for (size_t i = 0; i < v.size(); ++i) ret.push_back(atoi(v[i].c_str()));
+		return ret;
+	}
+
+	void print(const std::vector<Result> & results, const std::string & format)
+	{
+		if (format == "csv")
+		{
+			printf("op,dist,n,cap,depth,ops,ns_per_op,p50_ns,p99_ns,allocs_per_op\n");
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const Result & r = results[i];
+				printf("%s,%s,%d,%d,%d,%zu,%.1f,%.1f,%.1f,%.3f\n", r.op.c_str(), r.dist.c_str(), r.n, r.cap, r.depth, r.ops, r.nsPerOp, r.p50, r.p99, r.allocsPerOp);
+			}
+		}
+		else if (format == "json")
+		{
+			printf("[\n");
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const Result & r = results[i];
+				printf("  {\"op\": \"%s\", \"dist\": \"%s\", \"n\": %d, \"cap\": %d, \"depth\": %d, \"ops\": %zu, \"ns_per_op\": %.1f, \"p50_ns\": %.1f, \"p99_ns\": %.1f, \"allocs_per_op\": %.3f}%s\n",
+					r.op.c_str(), r.dist.c_str(), r.n, r.cap, r.depth, r.ops, r.nsPerOp, r.p50, r.p99, r.allocsPerOp, i+1 < results.size() ? "," : "");
+			}
+			printf("]\n");
+		}
+		else
+		{
+			printf("%-14s %-10s %9s %4s %5s %10s %10s %10s %8s\n", "op", "dist", "n", "cap", "depth", "ns/op", "p50", "p99", "allocs");
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const Result & r = results[i];
+				printf("%-14s %-10s %9d %4d %5d %10.1f %10.1f %10.1f %8.3f\n", r.op.c_str(), r.dist.c_str(), r.n, r.cap, r.depth, r.nsPerOp, r.p50, r.p99, r.allocsPerOp);
+			}
+		}
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	std::vector<int> sizes = splitInts("1000,10000,100000");
+	std::vector<int> caps = splitInts("4,8,16,32");
+	std::vector<int> depths = splitInts("8,10,12");
+	std::vector<std::string> dists = split("uniform,clustered,lines");
+	std::string format = "table";
+	unsigned int seed = 12345;
+
+	for (int i = 1; i+1 < argc; i += 2)
+	{
+		std::string opt = argv[i];
+		std::string val = argv[i+1];
+		if (opt == "--sizes") sizes = splitInts(val);
+		else if (opt == "--caps") caps = splitInts(val);
+		else if (opt == "--depths") depths = splitInts(val);
+		else if (opt == "--dists") dists = split(val);
+		else if (opt == "--format") format = val;
+		else if (opt == "--seed") seed = (unsigned int)strtoul(val.c_str(), 0, 10);
+		else if (opt == "--stats") showStats = atoi(val.c_str()) != 0;
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", opt.c_str());
+			return 1;
+		}
+	}
+
+	calibrate();
+
+	std::vector<Result> results;
+	for (size_t d = 0; d < dists.size(); ++d)
+		for (size_t s = 0; s < sizes.size(); ++s)
+			for (size_t c = 0; c < caps.size(); ++c)
+				for (size_t k = 0; k < depths.size(); ++k)
+				{
+					// Same points for every setting of a distribution and size
+					Rng rng(seed + (unsigned int)(d*1000 + s));
+					run(dists[d], sizes[s], caps[c], depths[k], rng, results);
+				}
+
+	print(results, format);
+	return 0;
+}
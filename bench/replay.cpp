@@ -0,0 +1,182 @@
+/*///=====================================================================
+
+	replay.cpp
+
+	Headless replay of an event trace recorded with "--record <path>".
+	Every event is fed through Editor::handleEvent, exactly as the live
+	window does, but without creating a window or drawing. Reports the
+	handling cost per event type and per frame (all events polled in one
+	frame of the recording), optionally every event as CSV, and optionally
+	a Chrome trace of the profiler's scopes and counters (profiler.h).
+
+		replay <trace> [--repeat N] [--csv <path>] [--profile <path>]
+		       [--index quadtree|hash]
+
+	Links the editor sources and SFML's graphics module (for the shapes);
+	no display is needed. Runs from the same directory as the app, since
+	save/load/import use ../media paths.
+
+*///======================================================================
+
+#include "editor.h"
+#include "profiler.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	const char * eventName(sf::Event::EventType type)
+	{
+		switch (type)
+		{
+		case sf::Event::Closed: return "Closed";
+		case sf::Event::Resized: return "Resized";
+		case sf::Event::LostFocus: return "LostFocus";
+		case sf::Event::GainedFocus: return "GainedFocus";
+		case sf::Event::TextEntered: return "TextEntered";
+		case sf::Event::KeyPressed: return "KeyPressed";
+		case sf::Event::KeyReleased: return "KeyReleased";
+		case sf::Event::MouseWheelMoved: return "MouseWheelMoved";
+		case sf::Event::MouseButtonPressed: return "MouseButtonPressed";
+		case sf::Event::MouseButtonReleased: return "MouseButtonReleased";
+		case sf::Event::MouseMoved: return "MouseMoved";
+		case sf::Event::MouseEntered: return "MouseEntered";
+		case sf::Event::MouseLeft: return "MouseLeft";
+		default: return "Other";
+		}
+	}
+
+	struct Stats
+	{
+		void add(double us) { samples.push_back(us); }
+
+		void print(const char * name)
+		{
+			if (samples.empty()) return;
+			std::sort(samples.begin(), samples.end());
+			double sum = 0;
+			for (size_t i = 0; i < samples.size(); ++i) sum += samples[i];
+			size_t n = samples.size();
+			printf("%-20s %8zu %10.2f %10.2f %10.2f %10.2f %12.1f\n", name, n, sum / n,
+				samples[n/2], samples[std::min(n-1, n*99/100)], samples[n-1], sum);
+		}
+
+		std::vector<double> samples;
+	};
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: replay <trace> [--repeat N] [--csv <path>] [--profile <path>] [--index quadtree|hash]\n");
+		return 1;
+	}
+
+	std::string csvPath;
+	std::string profilePath;
+	int repeat = 1;
+	Editor::Index index = Editor::QUADTREE;
+	for (int i = 2; i+1 < argc; i += 2)
+	{
+		std::string opt = argv[i];
+		if (opt == "--repeat") repeat = std::max(1, atoi(argv[i+1]));
+		else if (opt == "--csv") csvPath = argv[i+1];
+		else if (opt == "--profile") profilePath = argv[i+1];
+		else if (opt == "--index") index = std::string(argv[i+1]) == "hash" ? Editor::SPATIAL_HASH : Editor::QUADTREE;
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", opt.c_str());
+			return 1;
+		}
+	}
+
+	EventTrace trace;
+	if (!trace.load(argv[1]))
+	{
+		fprintf(stderr, "cannot read trace %s\n", argv[1]);
+		return 1;
+	}
+	const std::vector<EventTrace::Record> & records = trace.getRecords();
+
+	FILE * csv = 0;
+	if (!csvPath.empty())
+	{
+		csv = fopen(csvPath.c_str(), "w");
+		if (!csv)
+		{
+			fprintf(stderr, "cannot write %s\n", csvPath.c_str());
+			return 1;
+		}
+		fprintf(csv, "run,index,frame,time_us,type,cost_us,nodes,edges,selected\n");
+	}
+
+	if (!profilePath.empty()) Profiler::setEnabled(true);
+
+	std::map<int, Stats> perType;
+	Stats perFrame;
+	Stats all;
+
+	for (int run = 0; run < repeat; ++run)
+	{
+		// A fresh, empty graph every run, as when the trace was recorded
+		Editor editor(trace.getWidth(), trace.getHeight(), index);
+
+		double frameCost = 0;
+		bool frameOpen = false;
+		uint32_t frame = 0;
+		for (size_t i = 0; i < records.size(); ++i)
+		{
+			const EventTrace::Record & r = records[i];
+			if (frameOpen && r.frame != frame)
+			{
+				perFrame.add(frameCost);
+				frameCost = 0;
+				Profiler::endFrame();
+			}
+			if (!frameOpen || r.frame != frame) Profiler::beginFrame();
+			frame = r.frame;
+			frameOpen = true;
+
+			Clock::time_point t0 = Clock::now();
+			Editor::Action action = editor.handleEvent(r.event);
+			double us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+
+			perType[r.event.type].add(us);
+			all.add(us);
+			frameCost += us;
+			if (csv)
+			{
+				fprintf(csv, "%d,%zu,%u,%lld,%s,%.3f,%u,%u,%zu\n", run, i, r.frame, (long long)r.time, eventName(r.event.type), us,
+					editor.getGraph().nodes.size(), editor.getGraph().edges.size(), editor.getSelection().size());
+			}
+			if (action == Editor::CLOSE) break;
+		}
+		if (frameOpen)
+		{
+			perFrame.add(frameCost);
+			Profiler::endFrame();
+		}
+	}
+
+	if (csv) fclose(csv);
+	if (!profilePath.empty() && !Profiler::writeChromeTrace(profilePath))
+		fprintf(stderr, "cannot write %s\n", profilePath.c_str());
+
+	printf("%u x %u, %zu events, %d run(s); times in microseconds\n\n", trace.getWidth(), trace.getHeight(), records.size(), repeat);
+	printf("%-20s %8s %10s %10s %10s %10s %12s\n", "", "count", "mean", "p50", "p99", "max", "total");
+	for (std::map<int, Stats>::iterator it = perType.begin(); it != perType.end(); ++it)
+		it->second.print(eventName((sf::Event::EventType)it->first));
+	all.print("all events");
+	perFrame.print("frames with events");
+	return 0;
+}
@@ -0,0 +1,215 @@
+/*///=====================================================================
+
+	search_bench.cpp
+
+	Benchmarks BFS, Dijkstra and A* (PathSearch) on seeded synthetic
+	graphs (GraphGenerator) across sizes. Per generator, size and
+	algorithm it reports queries/sec, mean settled nodes per query, the
+	fraction of queries that found a path, and the memory of the search
+	graph and of the search state. Dijkstra and A* distances are compared
+	on every query; a mismatch is reported on stderr.
+
+	Headless; builds without SFML:
+
+		g++ -O2 -std=c++11 -pthread -DQUADTREE_NO_SFML -Isrc bench/search_bench.cpp
+			src/generators.cpp src/search.cpp -o search_bench
+
+	Options (comma-separated lists):
+
+		--sizes 1000,10000,100000,1000000     up to 10000000
+		--gens grid,geometric,planar,scalefree
+		--queries 200
+		--format table|csv|json
+		--seed N
+
+*///======================================================================
+
+#include "generators.h"
+#include "search.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const float WORLD = 10000;
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Result
+	{
+		std::string gen;
+		std::string algo;
+		uint32_t nodes;
+		size_t edges;
+		size_t queries;
+		double qps;
+		double settled;
+		double found;
+		size_t graphBytes;
+		size_t searchBytes;
+		double buildMs;
+	};
+
+	void generate(const std::string & gen, uint32_t n, uint32_t seed, GeneratedGraph & g)
+	{
+		GraphGenerator gg(seed, 0, 0, WORLD, WORLD);
+		if (gen == "grid")
+		{
+			uint32_t side = (uint32_t)std::ceil(std::sqrt((double)n));
+			gg.grid(side, side, false, g);
+		}
+		else if (gen == "geometric") gg.geometric(n, 0, g);
+		else if (gen == "planar") gg.planar(n, g);
+		else if (gen == "scalefree") gg.scaleFree(n, 3, g);
+		else
+		{
+			fprintf(stderr, "unknown generator %s\n", gen.c_str());
+			exit(1);
+		}
+	}
+
+	void run(const std::string & gen, uint32_t n, size_t queries, uint32_t seed, std::vector<Result> & results)
+	{
+		GeneratedGraph g;
+		SearchGraph sg;
+		Clock::time_point t0 = Clock::now();
+		generate(gen, n, seed, g);
+		sg.build(g);
+		double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+		size_t edges = g.edges.size();
+		g = GeneratedGraph();
+
+		// The same random pairs for every algorithm
+		std::mt19937 rng(seed ^ 0x9E3779B9u);
+		std::uniform_int_distribution<uint32_t> pick(0, sg.numNodes()-1);
+		std::vector<std::pair<uint32_t, uint32_t> > pairs(queries);
+		for (size_t i = 0; i < queries; ++i)
+			pairs[i] = std::make_pair(pick(rng), pick(rng));
+
+		const char * algos[] = { "bfs", "dijkstra", "astar" };
+		std::vector<float> reference(queries);
+		for (int a = 0; a < 3; ++a)
+		{
+			PathSearch ps(sg);
+			ps.bfs(0, 0); // allocate the search state outside the timing
+
+			uint64_t settled = 0;
+			size_t found = 0;
+			Clock::time_point start = Clock::now();
+			for (size_t i = 0; i < queries; ++i)
+			{
+				float d;
+				if (a == 0) d = ps.bfs(pairs[i].first, pairs[i].second);
+				else if (a == 1) d = ps.dijkstra(pairs[i].first, pairs[i].second);
+				else d = ps.astar(pairs[i].first, pairs[i].second);
+				settled += ps.getSettled();
+				if (d != PathSearch::UNREACHABLE) ++found;
+
+				if (a == 1) reference[i] = d;
+				else if (a == 2 && std::fabs(d - reference[i]) > 1e-3f * (1 + std::fabs(reference[i])))
+					fprintf(stderr, "%s n=%u: astar %f != dijkstra %f for %u -> %u\n", gen.c_str(), n, d, reference[i], pairs[i].first, pairs[i].second);
+			}
+			double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+			Result r;
+			r.gen = gen;
+			r.algo = algos[a];
+			r.nodes = sg.numNodes();
+			r.edges = edges;
+			r.queries = queries;
+			r.qps = secs > 0 ? queries / secs : 0;
+			r.settled = queries ? (double)settled / queries : 0;
+			r.found = queries ? (double)found / queries : 0;
+			r.graphBytes = sg.memoryBytes();
+			r.searchBytes = ps.memoryBytes();
+			r.buildMs = buildMs;
+			results.push_back(r);
+		}
+	}
+
+	std::vector<std::string> split(const std::string & s)
+	{
+		std::vector<std::string> ret;
+		size_t b = 0;
+		while (b <= s.size())
+		{
+			size_t e = s.find(',', b);
+			if (e == std::string::npos) e = s.size();
+			if (e > b) ret.push_back(s.substr(b, e-b));
+			b = e+1;
+		}
+		return ret;
+	}
+
+	void print(const std::vector<Result> & results, const std::string & format)
+	{
+		if (format == "csv")
+		{
+			printf("gen,algo,nodes,edges,queries,qps,settled,found,graph_bytes,search_bytes,build_ms\n");
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const Result & r = results[i];
+				printf("%s,%s,%u,%zu,%zu,%.1f,%.1f,%.3f,%zu,%zu,%.1f\n", r.gen.c_str(), r.algo.c_str(), r.nodes, r.edges, r.queries, r.qps, r.settled, r.found, r.graphBytes, r.searchBytes, r.buildMs);
+			}
+		}
+		else if (format == "json")
+		{
+			printf("[\n");
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const Result & r = results[i];
+				printf("  {\"gen\": \"%s\", \"algo\": \"%s\", \"nodes\": %u, \"edges\": %zu, \"queries\": %zu, \"qps\": %.1f, \"settled\": %.1f, \"found\": %.3f, \"graph_bytes\": %zu, \"search_bytes\": %zu, \"build_ms\": %.1f}%s\n",
+					r.gen.c_str(), r.algo.c_str(), r.nodes, r.edges, r.queries, r.qps, r.settled, r.found, r.graphBytes, r.searchBytes, r.buildMs, i+1 < results.size() ? "," : "");
+			}
+			printf("]\n");
+		}
+		else
+		{
+			printf("%-10s %-9s %9s %10s %11s %11s %6s %9s %9s %9s\n", "gen", "algo", "nodes", "edges", "queries/s", "settled", "found", "graph MB", "search MB", "build ms");
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const Result & r = results[i];
+				printf("%-10s %-9s %9u %10zu %11.1f %11.1f %6.2f %9.2f %9.2f %9.1f\n", r.gen.c_str(), r.algo.c_str(), r.nodes, r.edges, r.qps, r.settled, r.found, r.graphBytes / 1048576.0, r.searchBytes / 1048576.0, r.buildMs);
+			}
+		}
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	std::vector<std::string> sizes = split("1000,10000,100000,1000000");
+	std::vector<std::string> gens = split("grid,geometric,planar,scalefree");
+	size_t queries = 200;
+	std::string format = "table";
+	uint32_t seed = 12345;
+
+	for (int i = 1; i+1 < argc; i += 2)
+	{
+		std::string opt = argv[i];
+		std::string val = argv[i+1];
+		if (opt == "--sizes") sizes = split(val);
+		else if (opt == "--gens") gens = split(val);
+		else if (opt == "--queries") queries = (size_t)strtoul(val.c_str(), 0, 10);
+		else if (opt == "--format") format = val;
+		else if (opt == "--seed") seed = (uint32_t)strtoul(val.c_str(), 0, 10);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", opt.c_str());
+			return 1;
+		}
+	}
+
+	std::vector<Result> results;
+	for (size_t g = 0; g < gens.size(); ++g)
+		for (size_t s = 0; s < sizes.size(); ++s)
+			run(gens[g], (uint32_t)strtoul(sizes[s].c_str(), 0, 10), queries, seed, results);
+
+	print(results, format);
+	return 0;
+}
@@ -0,0 +1,221 @@
+/*///=====================================================================
+
+	spatial_bench.cpp
+
+	QuadTree against SpatialHash behind the SpatialIndex interface, as Node
+	and Edge use them, on the editor's workloads:
+
+		build	bulk insert of every point (Transaction::commit)
+		pick	12 x 12 region queries at points (clicks, range 6)
+		box		100 x 100 region queries (drag select)
+		drag	a 100 x 100 block of points moved 1 unit per frame for 60
+				frames (Node::move / Edge::update)
+		delete	eraseIf over a 100 x 100 block (Graph::eraseNodes)
+
+	over generated meshes (planar), evenly scattered points (geometric) and
+	clustered blobs, in a 4000 x 4000 world. Reports ns per op (per point
+	for build and drag) and the bytes each index holds after the build.
+
+		g++ -O2 -std=c++11 -pthread -DQUADTREE_NO_SFML -Isrc bench/spatial_bench.cpp src/generators.cpp
+
+		spatial_bench [n] [seed]
+
+*///======================================================================
+
+#include "generators.h"
+#include "quadtree.h"
+#include "spatialhash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const float WORLD = 4000;
+	const int PICKS = 20000;
+	const int BOXES = 2000;
+	const int FRAMES = 60;
+	const int DELETES = 200;
+
+	typedef std::chrono::steady_clock Clock;
+
+	double nsSince(Clock::time_point t0, double ops)
+	{
+		return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / std::max(1.0, ops);
+	}
+
+	struct Points
+	{
+		std::vector<uint32_t> id;
+		std::vector<float> x;
+		std::vector<float> y;
+	};
+
+	Points makePoints(const std::string & dist, uint32_t n, uint32_t seed)
+	{
+		GraphGenerator gen(seed, 0, 0, WORLD, WORLD);
+		GeneratedGraph g;
+		Points p;
+		if (dist == "mesh")
+		{
+			gen.planar(n, g);
+			p.x = g.x;
+			p.y = g.y;
+		}
+		else if (dist == "scattered")
+		{
+			gen.geometric(n, 1, g);
+			p.x = g.x;
+			p.y = g.y;
+		}
+		else
+		{
+			std::mt19937 rng(seed);
+			std::uniform_real_distribution<float> u(WORLD / 10, WORLD * 9 / 10);
+			std::normal_distribution<float> gauss(0, WORLD / 100);
+			float cx[6], cy[6];
+			for (int i = 0; i < 6; ++i) { cx[i] = u(rng); cy[i] = u(rng); }
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				p.x.push_back(std::min(std::max(cx[i % 6] + gauss(rng), 0.f), WORLD - 1));
+				p.y.push_back(std::min(std::max(cy[i % 6] + gauss(rng), 0.f), WORLD - 1));
+			}
+		}
+		for (uint32_t i = 0; i < p.x.size(); ++i) p.id.push_back(i);
+		return p;
+	}
+
+	struct InBlock
+	{
+		InBlock(const Points & p, float x, float y) : p(p), x(x), y(y) {}
+		bool operator()(uint32_t i) const
+		{
+			return p.x[i] >= x && p.x[i] < x + 100 && p.y[i] >= y && p.y[i] < y + 100;
+		}
+		const Points & p;
+		float x;
+		float y;
+	};
+
+	struct Result
+	{
+		double build, pick, box, drag, del;
+		size_t bytes;
+		size_t found;
+	};
+
+	Result run(SpatialIndex<uint32_t> & index, Points p, uint32_t seed, size_t bytes(SpatialIndex<uint32_t> &))
+	{
+		Result r;
+		size_t n = p.id.size();
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<uint32_t> pick(0, (uint32_t)n - 1);
+		std::vector<uint32_t> out;
+
+		Clock::time_point t0 = Clock::now();
+		index.insert(p.id, p.x, p.y);
+		r.build = nsSince(t0, (double)n);
+		r.bytes = bytes(index);
+
+		r.found = 0;
+		t0 = Clock::now();
+		for (int i = 0; i < PICKS; ++i)
+		{
+			uint32_t k = pick(rng);
+			out.clear();
+			r.found += index.queryRegion(p.x[k] - 6, p.y[k] - 6, p.x[k] + 6, p.y[k] + 6, out);
+		}
+		r.pick = nsSince(t0, PICKS);
+
+		t0 = Clock::now();
+		for (int i = 0; i < BOXES; ++i)
+		{
+			uint32_t k = pick(rng);
+			out.clear();
+			r.found += index.queryRegion(p.x[k] - 50, p.y[k] - 50, p.x[k] + 50, p.y[k] + 50, out);
+		}
+		r.box = nsSince(t0, BOXES);
+
+		// Drag the block around a point, as a moved selection
+		uint32_t k = pick(rng);
+		out.clear();
+		index.queryRegion(p.x[k] - 50, p.y[k] - 50, p.x[k] + 50, p.y[k] + 50, out);
+		std::vector<uint32_t> sel(out);
+		t0 = Clock::now();
+		for (int f = 0; f < FRAMES; ++f)
+		{
+			float d = f < FRAMES / 2 ? 1.f : -1.f;
+			for (size_t i = 0; i < sel.size(); ++i)
+			{
+				uint32_t j = sel[i];
+				index.move(j, p.x[j], p.y[j], p.x[j] + d, p.y[j] + d);
+				p.x[j] += d;
+				p.y[j] += d;
+			}
+		}
+		r.drag = nsSince(t0, (double)FRAMES * sel.size());
+
+		t0 = Clock::now();
+		for (int i = 0; i < DELETES; ++i)
+		{
+			uint32_t j = pick(rng);
+			index.eraseIf(InBlock(p, p.x[j], p.y[j]), p.x[j] - 1, p.y[j] - 1, p.x[j] + 101, p.y[j] + 101);
+		}
+		r.del = nsSince(t0, DELETES);
+		return r;
+	}
+
+	size_t quadTreeBytes(SpatialIndex<uint32_t> & index)
+	{
+		return static_cast<QuadTree<uint32_t>&>(index).stats().bytes;
+	}
+
+	size_t hashBytes(SpatialIndex<uint32_t> & index)
+	{
+		return static_cast<SpatialHash<uint32_t>&>(index).bytes();
+	}
+
+	void print(const char * dist, const char * name, const Result & r)
+	{
+		printf("%-10s %-14s %8.1f %9.1f %9.1f %8.1f %10.1f %11zu %9zu\n", dist, name, r.build, r.pick, r.box, r.drag, r.del, r.bytes, r.found);
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	uint32_t n = argc > 1 ? (uint32_t)atoi(argv[1]) : 200000;
+	uint32_t seed = argc > 2 ? (uint32_t)atoi(argv[2]) : 1;
+
+	printf("%u points in %.0f x %.0f; ns per op (build and drag: per point)\n\n", n, WORLD, WORLD);
+	printf("%-10s %-14s %8s %9s %9s %8s %10s %11s %9s\n", "dist", "index", "build", "pick", "box", "drag", "delete", "bytes", "found");
+
+	const char * dists[] = { "mesh", "scattered", "clustered" };
+	for (int d = 0; d < 3; ++d)
+	{
+		Points p = makePoints(dists[d], n, seed);
+
+		int caps[] = { 4, 8, 16 };
+		for (int c = 0; c < 3; ++c)
+		{
+			QuadTree<uint32_t> qt(0, 0, WORLD, WORLD, caps[c], 16);
+			char name[32];
+			sprintf(name, "quadtree %d", caps[c]);
+			print(dists[d], name, run(qt, p, seed, quadTreeBytes));
+		}
+
+		float cells[] = { 8, 16, 32, 64 };
+		for (int c = 0; c < 4; ++c)
+		{
+			SpatialHash<uint32_t> hash(cells[c]);
+			char name[32];
+			sprintf(name, "hash %.0f", cells[c]);
+			print(dists[d], name, run(hash, p, seed, hashBytes));
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,268 @@
+/*///=====================================================================
+
+	static_quadtree_bench.cpp
+
+	QuadTree<int> against StaticQuadTree<int, CAPACITY, Coord> with float,
+	int32_t and 16.16 fixed-point coordinates, and with float coordinates
+	storing slab indices of Slab-allocated items through SlabPayload:
+	insert, queryRegion, move and erase over uniform and clustered points,
+	at the same bucket size and depth limit. Reports mean ns/op, heap
+	allocations per op and the bytes each tree holds once built, and
+	checks every query result against the dynamic tree.
+
+		g++ -O2 -std=c++11 bench/static_quadtree_bench.cpp -o static_quadtree_bench
+
+		static_quadtree_bench [n] [seed]
+
+*///======================================================================
+
+#define QUADTREE_NO_SFML
+#include "../src/quadtree.h"
+#include "../src/staticquadtree.h"
+#include "alloc_count.h"
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const float WORLD = 1000;
+	const int CAPACITY = 8;
+	const int DEPTH = 12;
+	const int QUERIES = 2000;
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Point
+	{
+		float x;
+		float y;
+	};
+
+	struct Workload
+	{
+		std::vector<Point> points;
+		std::vector<Point> moved;		// small jitter of points
+		std::vector<Point> regions;		// pairs of corners
+	};
+
+	Workload makeWorkload(bool clustered, int n, unsigned int seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> u(0, WORLD);
+		std::normal_distribution<float> g(0, 1);
+		std::uniform_real_distribution<float> jitter(-2, 2);
+		Point centers[8];
+		for (int i = 0; i < 8; ++i) { centers[i].x = u(rng); centers[i].y = u(rng); }
+
+		Workload w;
+		w.points.resize(n);
+		w.moved.resize(n);
+		for (int i = 0; i < n; ++i)
+		{
+			Point & p = w.points[i];
+			if (clustered)
+			{
+				const Point & c = centers[i % 8];
+				p.x = c.x + g(rng) * WORLD / 50;
+				p.y = c.y + g(rng) * WORLD / 50;
+			}
+			else
+			{
+				p.x = u(rng);
+				p.y = u(rng);
+			}
+			p.x = std::min(std::max(p.x, 0.f), WORLD - 1);
+			p.y = std::min(std::max(p.y, 0.f), WORLD - 1);
+			w.moved[i].x = std::min(std::max(p.x + jitter(rng), 0.f), WORLD - 1);
+			w.moved[i].y = std::min(std::max(p.y + jitter(rng), 0.f), WORLD - 1);
+		}
+
+		// Regions of about 1% of the world, centered on points
+		std::uniform_int_distribution<int> pick(0, n - 1);
+		for (int i = 0; i < QUERIES; ++i)
+		{
+			const Point & c = w.points[pick(rng)];
+			Point a = { c.x - WORLD / 20, c.y - WORLD / 20 };
+			Point b = { c.x + WORLD / 20, c.y + WORLD / 20 };
+			w.regions.push_back(a);
+			w.regions.push_back(b);
+		}
+		return w;
+	}
+
+	//
+	// Adapters
+	//
+	// One interface over both trees, taking float coordinates. Conversion
+	// to the static tree's Coord is part of its measured cost, as it would
+	// be for a caller holding floats.
+	//
+
+	struct DynamicTree
+	{
+		DynamicTree() : qt(0, 0, WORLD, WORLD, CAPACITY, DEPTH) {}
+		void prepare(size_t) {}
+		void insert(int i, float x, float y) { qt.insert(i, x, y); }
+		bool erase(int i, float x, float y) { return qt.erase(i, x, y); }
+		void move(int i, float x1, float y1, float x2, float y2) { qt.move(i, x1, y1, x2, y2); }
+		int query(float x1, float y1, float x2, float y2, std::vector<int> & ret) { return qt.queryRegion(x1, y1, x2, y2, ret); }
+		size_t bytes() { return qt.stats().bytes; }
+		QuadTree<int> qt;
+	};
+
+	//
+	// Items addressed through a Slab, as the Graph's nodes and edges are
+	//
+	struct Item
+	{
+		unsigned int id;
+	};
+
+	struct StaticSlabTree
+	{
+		typedef StaticQuadTree<Item*, CAPACITY, float, SlabPayload<Item*> > Tree;
+
+		StaticSlabTree() : qt(0, 0, WORLD, WORLD, DEPTH, SlabPayload<Item*>(slab)) {}
+		void prepare(size_t n)
+		{
+			// Items are allocated before the timed inserts
+			for (size_t i = 0; i < n; ++i)
+			{
+				unsigned int id;
+				Item * it = new (slab.allocate(id)) Item;
+				it->id = id;
+				items.push_back(it);
+			}
+		}
+		void insert(int i, float x, float y) { qt.insert(items[i], x, y); }
+		bool erase(int i, float x, float y) { return qt.erase(items[i], x, y); }
+		void move(int i, float x1, float y1, float x2, float y2) { qt.move(items[i], x1, y1, x2, y2); }
+		int query(float x1, float y1, float x2, float y2, std::vector<int> & ret)
+		{
+			found.clear();
+			qt.queryRegion(x1, y1, x2, y2, found);
+			for (size_t k = 0; k < found.size(); ++k) ret.push_back((int)found[k]->id);
+			return (int)ret.size();
+		}
+		size_t bytes() { return qt.bytes(); }
+
+		Slab<Item> slab;
+		std::vector<Item*> items;
+		std::vector<Item*> found;
+		Tree qt;
+	};
+
+	template<typename Coord>
+	struct StaticTree
+	{
+		typedef StaticQuadTree<int, CAPACITY, Coord> Tree;
+		static Coord c(float f) { return Tree::coord(f); }
+
+		StaticTree() : qt(c(0), c(0), c(WORLD), c(WORLD), DEPTH) {}
+		void prepare(size_t) {}
+		void insert(int i, float x, float y) { qt.insert(i, c(x), c(y)); }
+		bool erase(int i, float x, float y) { return qt.erase(i, c(x), c(y)); }
+		void move(int i, float x1, float y1, float x2, float y2) { qt.move(i, c(x1), c(y1), c(x2), c(y2)); }
+		int query(float x1, float y1, float x2, float y2, std::vector<int> & ret) { return qt.queryRegion(c(x1), c(y1), c(x2), c(y2), ret); }
+		size_t bytes() { return qt.bytes(); }
+		Tree qt;
+	};
+
+	struct Result
+	{
+		double ns[4];			// insert, query, move, erase
+		double allocs[4];
+		size_t bytes;
+		size_t found;
+		std::vector<size_t> counts;
+	};
+
+	template<typename Tree>
+	Result run(const Workload & w)
+	{
+		Result r;
+		size_t n = w.points.size();
+		Tree * t = new Tree();
+		t->prepare(n);
+		std::vector<int> out;
+		out.reserve(n);
+
+		Clock::time_point t0 = Clock::now();
+		unsigned long long a0 = allocations;
+		for (size_t i = 0; i < n; ++i) t->insert((int)i, w.points[i].x, w.points[i].y);
+		r.allocs[0] = (double)(allocations - a0) / n;
+		r.ns[0] = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+		r.bytes = t->bytes();
+
+		r.found = 0;
+		t0 = Clock::now();
+		a0 = allocations;
+		for (int q = 0; q < QUERIES; ++q)
+		{
+			out.clear();
+			const Point & a = w.regions[2*q];
+			const Point & b = w.regions[2*q+1];
+			size_t k = t->query(a.x, a.y, b.x, b.y, out);
+			r.found += k;
+			r.counts.push_back(k);
+		}
+		r.allocs[1] = (double)(allocations - a0) / QUERIES;
+		r.ns[1] = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / QUERIES;
+
+		t0 = Clock::now();
+		a0 = allocations;
+		for (size_t i = 0; i < n; ++i) t->move((int)i, w.points[i].x, w.points[i].y, w.moved[i].x, w.moved[i].y);
+		r.allocs[2] = (double)(allocations - a0) / n;
+		r.ns[2] = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+
+		t0 = Clock::now();
+		a0 = allocations;
+		for (size_t i = 0; i < n; ++i) t->erase((int)i, w.moved[i].x, w.moved[i].y);
+		r.allocs[3] = (double)(allocations - a0) / n;
+		r.ns[3] = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+
+		delete t;
+		return r;
+	}
+
+	void print(const char * dist, const char * tree, const Result & r, const Result & ref)
+	{
+		// Fixed and integer coordinates round points, so their counts may
+		// differ slightly at region edges; report the total difference
+		long long diff = 0;
+		for (size_t i = 0; i < r.counts.size(); ++i)
+			diff += r.counts[i] > ref.counts[i] ? r.counts[i] - ref.counts[i] : ref.counts[i] - r.counts[i];
+		printf("%-10s %-14s %9.1f %9.1f %9.1f %9.1f   %5.2f %5.2f %5.2f %5.2f %11zu %8lld\n", dist, tree,
+			r.ns[0], r.ns[1], r.ns[2], r.ns[3], r.allocs[0], r.allocs[1], r.allocs[2], r.allocs[3], r.bytes, diff);
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	int n = argc > 1 ? atoi(argv[1]) : 100000;
+	unsigned int seed = argc > 2 ? (unsigned int)atoi(argv[2]) : 1;
+
+	printf("%d points, capacity %d, depth %d, %d queries of ~1%% area\n\n", n, CAPACITY, DEPTH, QUERIES);
+	printf("%-10s %-14s %9s %9s %9s %9s   %5s %5s %5s %5s %11s %8s\n", "dist", "tree",
+		"insert", "query", "move", "erase", "a/ins", "a/q", "a/mv", "a/er", "bytes", "diff");
+
+	const char * dists[] = { "uniform", "clustered" };
+	for (int d = 0; d < 2; ++d)
+	{
+		Workload w = makeWorkload(d == 1, n, seed);
+		Result dyn = run<DynamicTree>(w);
+		print(dists[d], "QuadTree", dyn, dyn);
+		print(dists[d], "static float", run<StaticTree<float> >(w), dyn);
+		print(dists[d], "static int32", run<StaticTree<int32_t> >(w), dyn);
+		print(dists[d], "static 16.16", run<StaticTree<Fixed<16> > >(w), dyn);
+		print(dists[d], "static slab", run<StaticSlabTree>(w), dyn);
+	}
+	return 0;
+}
@@ -0,0 +1,413 @@
+#include "crossings.h"
+#include "edge.h"
+#include "graph.h"
+#include "node.h"
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+
+namespace
+{
+	// Cells a tester thread takes at a time
+	const size_t BATCH = 64;
+
+	uint64_t key(int32_t ix, int32_t iy)
+	{
+		return ((uint64_t)(uint32_t)ix << 32) | (uint32_t)iy;
+	}
+
+	//
+	// Twice the signed area of abc: positive if c is left of ab
+	//
+	float orient(float ax, float ay, float bx, float by, float cx, float cy)
+	{
+		return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+	}
+
+	bool opposite(float a, float b)
+	{
+		return (a > 0 && b < 0) || (a < 0 && b > 0);
+	}
+
+	typedef std::unordered_map<uint64_t, std::vector<unsigned int> > CellMap;
+
+	struct Insert
+	{
+		Insert(CellMap & cells, unsigned int id) : cells(cells), id(id) {}
+		void operator()(uint64_t k) { cells[k].push_back(id); }
+		CellMap & cells;
+		unsigned int id;
+	};
+
+	struct Remove
+	{
+		Remove(CellMap & cells, unsigned int id) : cells(cells), id(id) {}
+		void operator()(uint64_t k)
+		{
+			CellMap::iterator it = cells.find(k);
+			if (it == cells.end()) return;
+			std::vector<unsigned int> & c = it->second;
+			for (size_t i = 0; i < c.size(); ++i)
+			{
+				if (c[i] != id) continue;
+				c[i] = c.back();
+				c.pop_back();
+				break;
+			}
+			if (c.empty()) cells.erase(it);
+		}
+		CellMap & cells;
+		unsigned int id;
+	};
+
+	//
+	// Gathers the ids sharing any cell with a segment, each once
+	//
+	struct Collect
+	{
+		Collect(const CellMap & cells, std::vector<unsigned int> & stamps, unsigned int stamp, std::vector<unsigned int> & ret)
+			: cells(cells), stamps(stamps), stamp(stamp), ret(ret) {}
+		void operator()(uint64_t k)
+		{
+			CellMap::const_iterator it = cells.find(k);
+			if (it == cells.end()) return;
+			const std::vector<unsigned int> & c = it->second;
+			for (size_t i = 0; i < c.size(); ++i)
+			{
+				if (stamps[c[i]] == stamp) continue;
+				stamps[c[i]] = stamp;
+				ret.push_back(c[i]);
+			}
+		}
+		const CellMap & cells;
+		std::vector<unsigned int> & stamps;
+		unsigned int stamp;
+		std::vector<unsigned int> & ret;
+	};
+}
+
+//
+// Tests the pairs within a share of the cells. A pair sharing several
+// cells is found once per cell; the caller merges them.
+//
+struct Crossings::Tester
+{
+	Tester(const std::vector<Segment> & segments, const std::vector<const Cell*> & cells, std::atomic<size_t> & next, std::vector<std::vector<std::pair<unsigned int, unsigned int> > > & out)
+		: segments(segments), cells(cells), next(next), out(out) {}
+
+	void operator()(unsigned int t) const
+	{
+		std::vector<std::pair<unsigned int, unsigned int> > & ret = out[t];
+		for (;;)
+		{
+			size_t first = next.fetch_add(BATCH);
+			if (first >= cells.size()) break;
+			size_t last = std::min(first + BATCH, cells.size());
+			for (size_t k = first; k < last; ++k)
+			{
+				const Cell & c = *cells[k];
+				for (size_t i = 0; i < c.size(); ++i)
+				{
+					for (size_t j = i + 1; j < c.size(); ++j)
+					{
+						if (!cross(segments[c[i]], segments[c[j]])) continue;
+						ret.push_back(std::make_pair(std::min(c[i], c[j]), std::max(c[i], c[j])));
+					}
+				}
+			}
+		}
+	}
+
+	const std::vector<Segment> & segments;
+	const std::vector<const Cell*> & cells;
+	std::atomic<size_t> & next;
+	std::vector<std::vector<std::pair<unsigned int, unsigned int> > > & out;
+};
+
+Crossings::Crossings(const Graph & graph)
+	: graph(graph), cellSize(1), invCellSize(1), pairs(0), stamp(0)
+{
+}
+
+void Crossings::rebuild(unsigned int threads)
+{
+	PROFILE_SCOPE("Crossings::rebuild");
+	clear();
+
+	unsigned int cap = graph.edges.capacity();
+	Segment dead = { 0, 0, 0, 0, 0, 0, false };
+	segments.assign(cap, dead);
+	partners.resize(cap);
+	stamps.assign(cap, 0);
+	marks.assign(cap, 0);
+
+	// Cells about as large as the average edge
+	double length = 0;
+	size_t n = 0;
+	for (Slab<Edge>::iterator it = graph.edges.begin(); it != graph.edges.end(); ++it)
+	{
+		set((*it)->id, *it);
+		const Segment & s = segments[(*it)->id];
+		length += sqrt((double)(s.x2 - s.x1) * (s.x2 - s.x1) + (double)(s.y2 - s.y1) * (s.y2 - s.y1));
+		++n;
+	}
+	if (n == 0) return;
+	cellSize = std::max((float)(length / n), 1.f);
+	invCellSize = 1 / cellSize;
+	for (unsigned int i = 0; i < cap; ++i)
+	{
+		if (segments[i].live) place(i);
+	}
+
+	// Test each cell's pairs in parallel
+	std::vector<const Cell*> list;
+	for (std::unordered_map<uint64_t, Cell>::const_iterator it = cells.begin(); it != cells.end(); ++it)
+	{
+		if (it->second.size() > 1) list.push_back(&it->second);
+	}
+	if (threads == 0) threads = hardwareThreads();
+	std::vector<std::vector<std::pair<unsigned int, unsigned int> > > found(threads);
+	std::atomic<size_t> next(0);
+	parallelRun(threads, Tester(segments, list, next, found));
+
+	std::vector<std::pair<unsigned int, unsigned int> > all;
+	for (size_t t = 0; t < found.size(); ++t)
+		all.insert(all.end(), found[t].begin(), found[t].end());
+	std::sort(all.begin(), all.end());
+	all.erase(std::unique(all.begin(), all.end()), all.end());
+	for (size_t i = 0; i < all.size(); ++i)
+		link(all[i].first, all[i].second);
+}
+
+void Crossings::clear()
+{
+	segments.clear();
+	partners.clear();
+	cells.clear();
+	stamps.clear();
+	marks.clear();
+	nodeMarks.clear();
+	pairs = 0;
+	stamp = 0;
+}
+
+void Crossings::nodesTranslated(const std::vector<Node*> & nodes)
+{
+	PROFILE_SCOPE("Crossings::nodesTranslated");
+	if (segments.empty()) return;
+
+	// Mark the nodes; an edge with both ends marked moved rigidly
+	nodeMarks.resize(graph.nodes.capacity(), 0);
+	for (size_t i = 0; i < nodes.size(); ++i)
+		nodeMarks[nodes[i]->id] = 1;
+
+	std::vector<unsigned int> ids;
+	std::vector<unsigned char> rigid;
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		Node * n = nodes[i];
+		for (Node::EdgeList::iterator it = n->edges.begin(); it != n->edges.end(); ++it)
+		{
+			Edge * e = *it;
+			if (e->id >= segments.size() || !segments[e->id].live) continue;
+			bool both = nodeMarks[e->other(n)->id] != 0;
+			if (both && e->n1 != n) continue; // taken from its n1 side
+			ids.push_back(e->id);
+			rigid.push_back(both);
+		}
+	}
+
+	for (size_t i = 0; i < nodes.size(); ++i)
+		nodeMarks[nodes[i]->id] = 0;
+
+	recheck(ids, rigid);
+}
+
+void Crossings::edgesChanged(const std::vector<Edge*> & edges)
+{
+	PROFILE_SCOPE("Crossings::edgesChanged");
+	if (segments.empty()) return;
+
+	std::vector<unsigned int> ids;
+	for (size_t i = 0; i < edges.size(); ++i)
+	{
+		unsigned int id = edges[i]->id;
+		if (id >= segments.size() || !segments[id].live || marks[id]) continue;
+		marks[id] = 1;
+		ids.push_back(id);
+	}
+	for (size_t i = 0; i < ids.size(); ++i)
+		marks[ids[i]] = 0;
+
+	recheck(ids, std::vector<unsigned char>(ids.size(), 0));
+}
+
+size_t Crossings::count() const
+{
+	return pairs;
+}
+
+unsigned int Crossings::count(const Edge * e) const
+{
+	if (e->id >= segments.size() || !segments[e->id].live) return 0;
+	return partners[e->id].size();
+}
+
+size_t Crossings::getCrossed(std::vector<Edge*> & ret) const
+{
+	size_t before = ret.size();
+	for (unsigned int i = 0; i < partners.size(); ++i)
+	{
+		if (!partners[i].empty() && graph.edges.isLive(i)) ret.push_back(graph.edges.at(i));
+	}
+	return ret.size() - before;
+}
+
+//
+// Whether two segments properly intersect. Segments sharing a node touch
+// there and do not cross; collinear ones never do.
+//
+bool Crossings::cross(const Segment & a, const Segment & b)
+{
+	if (a.n1 == b.n1 || a.n1 == b.n2 || a.n2 == b.n1 || a.n2 == b.n2) return false;
+	if (std::max(a.x1, a.x2) < std::min(b.x1, b.x2) || std::max(b.x1, b.x2) < std::min(a.x1, a.x2)) return false;
+	if (std::max(a.y1, a.y2) < std::min(b.y1, b.y2) || std::max(b.y1, b.y2) < std::min(a.y1, a.y2)) return false;
+	return opposite(orient(a.x1, a.y1, a.x2, a.y2, b.x1, b.y1), orient(a.x1, a.y1, a.x2, a.y2, b.x2, b.y2))
+		&& opposite(orient(b.x1, b.y1, b.x2, b.y2, a.x1, a.y1), orient(b.x1, b.y1, b.x2, b.y2, a.x2, a.y2));
+}
+
+//
+// Calls fn(key) for every cell the segment passes through: row by row,
+// the columns between where it enters and leaves the row (widened a
+// little against rounding).
+//
+template<typename Fn>
+void Crossings::forEachCell(const Segment & s, Fn & fn) const
+{
+	float ymin = std::min(s.y1, s.y2), ymax = std::max(s.y1, s.y2);
+	float xmin = std::min(s.x1, s.x2), xmax = std::max(s.x1, s.x2);
+	float margin = cellSize * 1e-3f;
+	int32_t iy0 = (int32_t)floorf(ymin * invCellSize);
+	int32_t iy1 = (int32_t)floorf(ymax * invCellSize);
+	for (int32_t iy = iy0; iy <= iy1; ++iy)
+	{
+		float xa = xmin, xb = xmax;
+		if (iy0 != iy1)
+		{
+			float ya = std::max(ymin, iy * cellSize);
+			float yb = std::min(ymax, (iy + 1) * cellSize);
+			float slope = (s.x2 - s.x1) / (s.y2 - s.y1);
+			xa = s.x1 + (ya - s.y1) * slope;
+			xb = s.x1 + (yb - s.y1) * slope;
+			if (xa > xb) std::swap(xa, xb);
+			xa = std::max(xa, xmin);
+			xb = std::min(xb, xmax);
+		}
+		int32_t ix0 = (int32_t)floorf((xa - margin) * invCellSize);
+		int32_t ix1 = (int32_t)floorf((xb + margin) * invCellSize);
+		for (int32_t ix = ix0; ix <= ix1; ++ix)
+			fn(key(ix, iy));
+	}
+}
+
+void Crossings::place(unsigned int id)
+{
+	Insert fn(cells, id);
+	forEachCell(segments[id], fn);
+}
+
+void Crossings::unplace(unsigned int id)
+{
+	Remove fn(cells, id);
+	forEachCell(segments[id], fn);
+}
+
+void Crossings::set(unsigned int id, const Edge * e)
+{
+	Segment & s = segments[id];
+	s.x1 = e->n1->x;
+	s.y1 = e->n1->y;
+	s.x2 = e->n2->x;
+	s.y2 = e->n2->y;
+	s.n1 = e->n1->id;
+	s.n2 = e->n2->id;
+	s.live = true;
+}
+
+void Crossings::link(unsigned int a, unsigned int b)
+{
+	partners[a].push_back(b);
+	partners[b].push_back(a);
+	++pairs;
+}
+
+void Crossings::unlink(unsigned int a, unsigned int b)
+{
+	SmallVector<unsigned int, 2> * lists[2] = { &partners[a], &partners[b] };
+	unsigned int other[2] = { b, a };
+	for (int k = 0; k < 2; ++k)
+	{
+		SmallVector<unsigned int, 2> & p = *lists[k];
+		for (unsigned int i = 0; i < p.size(); ++i)
+		{
+			if (p[i] != other[k]) continue;
+			p[i] = p.back();
+			p.pop_back();
+			break;
+		}
+	}
+	--pairs;
+}
+
+//
+// Drops the crossings of the given edges, re-buckets them at their
+// current position and tests them against the edges around them. Pairs
+// of rigid edges are left alone.
+//
+void Crossings::recheck(const std::vector<unsigned int> & ids, const std::vector<unsigned char> & rigid)
+{
+	// 1: moved, 2: moved rigidly
+	for (size_t i = 0; i < ids.size(); ++i)
+		marks[ids[i]] = rigid[i] ? 2 : 1;
+
+	for (size_t i = 0; i < ids.size(); ++i)
+	{
+		unsigned int a = ids[i];
+		SmallVector<unsigned int, 2> & p = partners[a];
+		for (unsigned int k = 0; k < p.size();)
+		{
+			if (marks[a] == 2 && marks[p[k]] == 2) ++k;
+			else unlink(a, p[k]); // swaps another partner into k
+		}
+		unplace(a);
+		set(a, graph.edges.at(a));
+		place(a);
+	}
+
+	std::vector<unsigned int> near;
+	for (size_t i = 0; i < ids.size(); ++i)
+	{
+		unsigned int a = ids[i];
+		if (++stamp == 0)
+		{
+			std::fill(stamps.begin(), stamps.end(), 0);
+			stamp = 1;
+		}
+		near.clear();
+		Collect fn(cells, stamps, stamp, near);
+		forEachCell(segments[a], fn);
+		for (size_t k = 0; k < near.size(); ++k)
+		{
+			unsigned int b = near[k];
+			if (b == a) continue;
+			if (marks[b] && (b < a || (marks[a] == 2 && marks[b] == 2))) continue; // tested from b, or rigid
+			if (cross(segments[a], segments[b])) link(a, b);
+		}
+	}
+
+	for (size_t i = 0; i < ids.size(); ++i)
+		marks[ids[i]] = 0;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+/*///=====================================================================
+
+	crossings.h
+
+	Finds and tracks the pairs of edges of a Graph that cross, working off
+	each edge's endpoint coordinates. Two edges cross when their segments
+	properly intersect; edges sharing a node, and collinear overlaps, do
+	not count.
+
+	Segments are bucketed in a uniform grid, in every cell they pass
+	through (not just their bounding box), with cells about as large as
+	the average edge. Only segments sharing a cell are tested against
+	each other, so a rebuild costs about the number of edges times the
+	edges per cell rather than O(E^2). The cells are tested in parallel.
+
+	After a drag only the dragged nodes' edges are re-bucketed and
+	rechecked, so crossing counts can be kept up to date while dragging.
+	Edges created or destroyed since the last rebuild (or relocated by
+	Graph::compact) are not tracked; rebuild after such edits.
+
+*///======================================================================
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "smallvector.h"
+
+class Edge;
+class Graph;
+class Node;
+
+class Crossings
+{
+public:
+
+	//
+	// Crossings
+	//
+	// Tracks the given graph's edges; empty until rebuild.
+	//
+	explicit Crossings(const Graph & graph);
+
+	//
+	// rebuild
+	//
+	// Finds every crossing from scratch. threads = 0 uses every hardware
+	// thread.
+	//
+	void rebuild(unsigned int threads = 0);
+
+	//
+	// clear
+	//
+	// Forgets all edges and crossings.
+	//
+	void clear();
+
+	//
+	// nodesTranslated
+	//
+	// Rechecks the edges of nodes that were all translated by the same
+	// offset (as Selection::moveSelection does). Pairs of edges with all
+	// four ends among the nodes kept their relation and are skipped.
+	//
+	void nodesTranslated(const std::vector<Node*> & nodes);
+
+	//
+	// edgesChanged
+	//
+	// Rechecks the given edges after their endpoints moved arbitrarily.
+	//
+	void edgesChanged(const std::vector<Edge*> & edges);
+
+	//
+	// count
+	//
+	// The number of crossing pairs, or the number of edges crossing e.
+	//
+	size_t count() const;
+	unsigned int count(const Edge * e) const;
+
+	//
+	// getCrossed
+	//
+	// Pushes every edge with at least one crossing into the vector and
+	// returns the number pushed.
+	//
+	size_t getCrossed(std::vector<Edge*> & ret) const;
+
+private:
+
+	Crossings(const Crossings &);
+	Crossings & operator=(const Crossings &);
+
+	struct Segment
+	{
+		float x1, y1, x2, y2;
+		unsigned int n1, n2; // node ids
+		bool live;
+	};
+
+	typedef std::vector<unsigned int> Cell;
+
+	struct Tester;
+
+	static bool cross(const Segment & a, const Segment & b);
+
+	template<typename Fn>
+	void forEachCell(const Segment & s, Fn & fn) const;
+
+	void place(unsigned int id);
+	void unplace(unsigned int id);
+	void set(unsigned int id, const Edge * e);
+	void link(unsigned int a, unsigned int b);
+	void unlink(unsigned int a, unsigned int b);
+	void recheck(const std::vector<unsigned int> & ids, const std::vector<unsigned char> & rigid);
+
+	const Graph & graph;
+	float cellSize;
+	float invCellSize;
+	size_t pairs;
+	std::vector<Segment> segments; // by Edge::id
+	std::vector<SmallVector<unsigned int, 2> > partners; // by Edge::id
+	std::unordered_map<uint64_t, Cell> cells;
+	std::vector<unsigned int> stamps; // by Edge::id, for deduplicating candidates
+	unsigned int stamp;
+	std::vector<unsigned char> marks; // by Edge::id, edges being rechecked
+	std::vector<unsigned char> nodeMarks; // by Node::id, nodes being translated
+};
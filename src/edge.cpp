@@ -1,30 +1,84 @@
 #include "edge.h"
+#include "graph.h"
 #include "node.h"
+#include "profiler.h"
+#include "transaction.h"
 
-std::set<Edge*> * Edge::eset = 0;
-QuadTree<Edge*> * Edge::qtree = 0;
+#include <algorithm>
 
-Edge::Edge(Node * n1, Node * n2, float thickness) : n1(n1), n2(n2), ht(thickness/2), selected(false), updateDisabled(false)
+Edge::Edge(Graph * graph, unsigned int id, Node * n1, Node * n2, float thickness) : graph(graph), id(id), n1(n1), n2(n2), s1(0), s2(0), ht(thickness/2), selected(false), updateDisabled(false)
 {
 	if (!(n1 && n2))
 		assert(!"Edge::Edge: nodes");
 	init();
 }
 
+Edge::Edge(Graph * graph, unsigned int id, Node * n1, Node * n2, float thickness, bool) : graph(graph), id(id), n1(n1), n2(n2), s1(0), s2(0), ht(thickness/2), selected(false), updateDisabled(false)
+{
+	style();
+	attach();
+}
+
 Edge::~Edge()
 {
-	// Erase nodes from their neighbors sets
-	n1->neighbors.erase(n2);
-	n2->neighbors.erase(n1);
-	// Erase self from nodes' edge sets
-	n1->edges.erase(this);
-	n2->edges.erase(this);
+}
+
+//
+// Erases the edge from its nodes, the edge map, the edge set and quadtree.
+//
+void Edge::unlink()
+{
+	detach();
 	// Erase self from edge set and quadtree (if they are set)
-	if (eset) eset->erase(this);
-	if (qtree) qtree->erase(this, srect.getPosition().x, srect.getPosition().y);
+	if (graph->eset) graph->eset->erase(this);
+	if (graph->edgeIndex) graph->edgeIndex->erase(this, srect.getPosition().x, srect.getPosition().y);
+}
+
+//
+// Adds the edge to its nodes' edge lists and the edge map.
+//
+void Edge::attach()
+{
+	n1->addEdge(this);
+	n2->addEdge(this);
+	graph->emap.insert(n1->id, n2->id, this);
+}
+
+//
+// Erases the edge from its nodes' edge lists and the edge map.
+//
+void Edge::detach()
+{
+	n1->removeEdge(this);
+	n2->removeEdge(this);
+	graph->emap.erase(n1->id, n2->id);
 }
 
 void Edge::init()
+{
+	style();
+
+	// Add self to nodes' edge lists and the edge map
+	attach();
+
+	// Inside a transaction the sets and quadtree are updated on commit
+	if (graph->transaction)
+	{
+		graph->transaction->edgeCreated(this);
+		return;
+	}
+
+	layout();
+
+	// Add self to edge set and quadtree (if they are set)
+	if (graph->eset) graph->eset->insert(this);
+	if (graph->edgeIndex) graph->edgeIndex->insert(this, srect.getPosition().x, srect.getPosition().y);
+}
+
+//
+// Sets up the shapes' colors, outline and origins.
+//
+void Edge::style()
 {
 	rect.setFillColor(sf::Color::Black);
 	rect.setOutlineColor(sf::Color::Red);
@@ -36,18 +90,6 @@ void Edge::init()
 	srect.setOutlineThickness(0);
 	srect.setSize(sf::Vector2f(10,10));
 	srect.setOrigin(5,5);
-
-	// Add nodes to their neighbors set
-	n1->neighbors.insert(n2);
-	n2->neighbors.insert(n1);
-	// Add self to nodes' edge sets
-	n1->edges.insert(this);
-	n2->edges.insert(this);
-	// Add self to edge set and quadtree (if they are set)
-	if (eset) eset->insert(this);
-	if (qtree) qtree->insert(this, srect.getPosition().x, srect.getPosition().y);
-
-	update(); // Will add self to quadtree
 }
 
 void Edge::update()
@@ -56,11 +98,32 @@ void Edge::update()
 
 	if (!n1 || !n2) return;
 
+	// Inside a transaction geometry is recomputed once on commit
+	if (graph->transaction)
+	{
+		graph->transaction->edgeDirty(this);
+		return;
+	}
+
+	PROFILE_SCOPE("Edge::update");
+	PROFILE_COUNT(EDGES_UPDATED, 1);
+
 	// Save current position
 	float x = srect.getPosition().x;
 	float y = srect.getPosition().y;
 
 	// Update
+	layout();
+
+	// Move in quadtree
+	if (graph->edgeIndex) graph->edgeIndex->move(this, x, y, srect.getPosition().x, srect.getPosition().y);
+}
+
+//
+// Recomputes the edge geometry from its nodes' positions.
+//
+void Edge::layout()
+{
 	float dx = n2->x - n1->x;
 	float dy = n2->y - n1->y;
 	float rot = atan2(dy, dx) * RADTODEG;
@@ -69,9 +132,6 @@ void Edge::update()
 	rect.setRotation(rot);
 	srect.setPosition(n1->x+(dx)/2, n1->y+(dy)/2);
 	srect.setRotation(rot);
-
-	// Move in quadtree
-	if (qtree) qtree->move(this, x, y, srect.getPosition().x, srect.getPosition().y);
 }
 
 void Edge::move(int dx, int dy)
@@ -86,12 +146,40 @@ void Edge::move(float dx, float dy)
 	n2->move(dx, dy);
 	updateDisabled = false;
 
+	// Move edge without recomputing its geometry
+	translate(dx, dy);
+}
+
+void Edge::translate(float dx, float dy)
+{
+	// Inside a transaction geometry is recomputed once on commit
+	if (graph->transaction)
+	{
+		graph->transaction->edgeDirty(this);
+		return;
+	}
+
 	// Move edge and update in quadtree
 	float x = srect.getPosition().x;
 	float y = srect.getPosition().y;
 	rect.move(dx, dy);
 	srect.move(dx, dy);
-	if (qtree) qtree->move(this, x, y, x+dx, y+dy);
+	if (graph->edgeIndex) graph->edgeIndex->move(this, x, y, x+dx, y+dy);
+}
+
+Node * Edge::other(const Node * n) const
+{
+	return n == n1 ? n2 : n1;
+}
+
+unsigned int & Edge::slot(const Node * n)
+{
+	return n == n1 ? s1 : s2;
+}
+
+uint64_t Edge::handle() const
+{
+	return graph->edges.handle(id);
 }
 
 bool Edge::operator==(const Edge & rhs) const
@@ -111,49 +199,155 @@ Edge * Edge::createEdge(Node * n1, Node * n2, float thickness)
 	// If same
 	if (n1 == n2) return 0;
 
+	// Nodes of different graphs
+	Graph * g = n1->graph;
+	if (n2->graph != g)
+		assert(!"Edge::createEdge: nodes in different graphs");
+
 	// If already neighbors
-	if (n1->neighbors.find(n2)!=n1->neighbors.end() || n2->neighbors.find(n1)!=n2->neighbors.end()) return 0;
+	if (g->emap.find(n1->id, n2->id)) return 0;
 
 	// Create edge
-	return new Edge(n1, n2, thickness);
+	unsigned int i;
+	void * p = g->edges.allocate(i);
+	return new (p) Edge(g, i, n1, n2, thickness);
 }
 
-bool Edge::destroyEdge(Node * n1, Node * n2)
+int Edge::createEdges(Node * n, const std::vector<Node*> & others, float thickness)
 {
-	// Not null
-	if (!(n1 && n2)) return false;
+	if (!n) return 0;
+
+	// Size the edge map once up front
+	EdgeMap & emap = n->graph->emap;
+	emap.reserve(emap.size() + others.size());
+
+	int ret = 0;
+	for (std::vector<Node*>::const_iterator it = others.begin(); it != others.end(); ++it)
+	{
+		if (createEdge(n, *it, thickness)) ++ret;
+	}
+	return ret;
+}
+
+int Edge::createEdges(const std::vector<std::pair<Node*, Node*> > & pairs, float thickness)
+{
+	if (pairs.empty() || !pairs[0].first) return 0;
+	Graph * g = pairs[0].first->graph;
+	PROFILE_SCOPE("Edge::createEdges");
+
+	// Size the edge map, the edge slab and every end node's edge list once
+	// up front (pairs all belong to one graph). Degrees are counted from
+	// the sorted end ids, so the work follows the pairs, not the graph
+	g->emap.reserve(g->emap.size() + pairs.size());
+	g->edges.reserve(g->edges.size() + (unsigned int)pairs.size());
+	std::vector<unsigned int> ends;
+	ends.reserve(pairs.size() * 2);
+	for (std::vector<std::pair<Node*, Node*> >::const_iterator it = pairs.begin(); it != pairs.end(); ++it)
+	{
+		if (!it->first || !it->second || it->first == it->second) continue;
+		if (it->first->graph != g || it->second->graph != g)
+			assert(!"Edge::createEdges: nodes in different graphs");
+		ends.push_back(it->first->id);
+		ends.push_back(it->second->id);
+	}
+	std::sort(ends.begin(), ends.end());
+	for (size_t i = 0, j; i < ends.size(); i = j)
+	{
+		for (j = i+1; j < ends.size() && ends[j] == ends[i]; ++j) {}
+		Node * n = g->nodes.at(ends[i]);
+		n->edges.reserve(n->edges.size() + (unsigned int)(j - i));
+	}
+
+	// Construct the edges, attached to their nodes and the edge map
+	std::vector<Edge*> created;
+	created.reserve(pairs.size());
+	for (std::vector<std::pair<Node*, Node*> >::const_iterator it = pairs.begin(); it != pairs.end(); ++it)
+	{
+		Node * n1 = it->first, * n2 = it->second;
+		if (!n1 || !n2 || n1 == n2) continue;
+		if (g->emap.find(n1->id, n2->id)) continue;
+
+		unsigned int i;
+		void * p = g->edges.allocate(i);
+		created.push_back(new (p) Edge(g, i, n1, n2, thickness, true));
+	}
 
-	// If not neighbors...
-	if (n1->neighbors.find(n2)==n1->neighbors.end() && n2->neighbors.find(n1)==n2->neighbors.end())
+	// Inside a transaction the sets and quadtree are updated on commit
+	if (g->transaction)
 	{
-		return false;
+		for (size_t i = 0; i < created.size(); ++i)
+			g->transaction->edgeCreated(created[i]);
+		return (int)created.size();
 	}
-	else
+
+	// Otherwise lay them out and index them in one bulk insert each
+	std::vector<float> xs(created.size());
+	std::vector<float> ys(created.size());
+	for (size_t i = 0; i < created.size(); ++i)
 	{
-		// Find and delete edge
-		for (std::set<Edge*>::iterator it = n1->edges.begin(); it != n1->edges.end(); ++it)
-		{
-			Edge * e = *it;
-			if (e->n1 == n1 && e->n2 == n2 || e->n1 == n2 && e->n2 == n1)
-			{
-				delete e; // Edge destructor will erase edge from its nodes' edge sets
-				// (one of which we're incrementing through) and erase it from the edge
-				// set and the quadtree (if they are set).
-				return true;
-			}
-		}
-		// n1 and n2 are neighbors, they must have an edge!
-		assert(!"Edge::destroyEdge: missing edge");
-		return false;
+		created[i]->layout();
+		xs[i] = created[i]->srect.getPosition().x;
+		ys[i] = created[i]->srect.getPosition().y;
 	}
+	if (g->edgeIndex) g->edgeIndex->insert(created, xs, ys);
+	if (g->eset) g->eset->insert(created.begin(), created.end());
+	return (int)created.size();
 }
 
-void Edge::setEdgeSet(std::set<Edge*> * edgeSet)
+Edge * Edge::findEdge(Node * n1, Node * n2)
 {
-	eset = edgeSet;
+	if (!(n1 && n2)) return 0;
+	if (n1->graph != n2->graph) return 0;
+	return n1->graph->emap.find(n1->id, n2->id);
 }
 
-void Edge::setQuadTree(QuadTree<Edge*> * quadTree)
+bool Edge::destroyEdge(Node * n1, Node * n2)
+{
+	Edge * e = findEdge(n1, n2);
+	if (!e) return false;
+
+	destroy(e); // Edge::unlink will erase edge from its nodes' edge lists,
+	// the edge map, the edge set and the quadtree (if they are set).
+	return true;
+}
+
+Edge * Edge::get(const Graph & graph, uint64_t handle)
+{
+	return graph.edges.get(handle);
+}
+
+void Edge::destroy(Edge * e)
+{
+	// Inside a transaction the edge is detached now but kept alive, and
+	// leaves the sets and quadtree on commit (or is reattached on rollback)
+	if (e->graph->transaction)
+	{
+		e->detach();
+		e->graph->transaction->edgeDestroyed(e);
+		return;
+	}
+
+	e->unlink();
+	free(e);
+}
+
+//
+// Destroys the edge and returns its slot without touching any index.
+//
+void Edge::free(Edge * e)
+{
+	Graph * g = e->graph;
+	unsigned int i = e->id;
+	e->~Edge();
+	g->edges.release(i);
+}
+
+//
+// Copies the edge to p and destroys the original, for Slab::relocate. The
+// copy keeps the old id and node pointers until the caller remaps them.
+//
+void Edge::relocate(void * p, Edge * e)
 {
-	qtree = quadTree;
+	new (p) Edge(*e);
+	e->~Edge();
 }
@@ -2,25 +2,43 @@
 
 #include <SFML/Graphics.hpp>
 #include <math.h>
-
-#include "quadtree.h"
+#include <stdint.h>
+#include <utility>
+#include <vector>
 
 #define RADTODEG 57.29577951f
 
+class Graph;
 class Node;
 
 class Edge
 {
 	friend class Node;
+	friend class Graph;
+	friend class Transaction;
 
 private:
 
-	Edge(Node * n1, Node * n2, float thickness = 2);
+	Edge(Graph * graph, unsigned int id, Node * n1, Node * n2, float thickness = 2);
 
-public:
+	// Attached to its nodes and the edge map only; the caller lays it out
+	// and indexes it (see createEdges)
+	Edge(Graph * graph, unsigned int id, Node * n1, Node * n2, float thickness, bool attachOnly);
 
 	~Edge();
-	
+
+	void unlink();
+
+	void attach();
+
+	void detach();
+
+	void layout();
+
+	void style();
+
+public:
+
 	void init();
 
 	void update();
@@ -28,12 +46,24 @@ public:
 	void move(int dx, int dy);
 	void move(float dx, float dy);
 
+	void translate(float dx, float dy);
+
+	Node * other(const Node * n) const;
+
+	unsigned int & slot(const Node * n);
+
+	uint64_t handle() const;
+
 	bool operator==(const Edge & rhs) const;
 
 	bool operator==(const Edge * rhs) const;
 
+	Graph * graph;
+	unsigned int id; // slab index, reused after the edge is destroyed
 	Node * n1;
 	Node * n2;
+	unsigned int s1; // index in n1->edges
+	unsigned int s2; // index in n2->edges
 	float ht; // half-thickness
 	bool selected;
 	bool updateDisabled;
@@ -44,9 +74,15 @@ public:
 	// Static
 	//
 	static Edge * createEdge(Node * n1, Node * n2, float thickness = 2);
+	static int createEdges(Node * n, const std::vector<Node*> & others, float thickness = 2);
+	static int createEdges(const std::vector<std::pair<Node*, Node*> > & pairs, float thickness = 2);
+	static Edge * findEdge(Node * n1, Node * n2);
 	static bool destroyEdge(Node * n1, Node * n2);
-	static void setEdgeSet(std::set<Edge*> * edgeSet);
-	static void setQuadTree(QuadTree<Edge*> * quadTree);
-	static std::set<Edge*> * eset;
-	static QuadTree<Edge*> * qtree;
+	static Edge * get(const Graph & graph, uint64_t handle);
+
+private:
+
+	static void destroy(Edge * e);
+	static void free(Edge * e);
+	static void relocate(void * p, Edge * e);
 };
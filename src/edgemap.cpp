@@ -0,0 +1,104 @@
+#include "edgemap.h"
+
+#include <algorithm>
+
+EdgeMap::EdgeMap() : count(0), mask(0)
+{
+	rehash(16);
+}
+
+Edge * EdgeMap::find(unsigned int a, unsigned int b) const
+{
+	return slots[findSlot(makeKey(a, b))].edge;
+}
+
+bool EdgeMap::insert(unsigned int a, unsigned int b, Edge * e)
+{
+	// Keep the load factor at or below one half
+	if ((count+1)*2 > slots.size()) rehash(slots.size()*2);
+
+	unsigned long long key = makeKey(a, b);
+	size_t i = findSlot(key);
+	if (slots[i].edge) return false;
+	slots[i].key = key;
+	slots[i].edge = e;
+	++count;
+	return true;
+}
+
+Edge * EdgeMap::erase(unsigned int a, unsigned int b)
+{
+	size_t i = findSlot(makeKey(a, b));
+	Edge * ret = slots[i].edge;
+	if (!ret) return 0;
+
+	// Shift back any later entry whose probe chain passes through the hole
+	size_t j = i;
+	for (;;)
+	{
+		j = (j+1) & mask;
+		if (!slots[j].edge) break;
+		size_t h = home(slots[j].key);
+		if (((j-h) & mask) >= ((j-i) & mask))
+		{
+			slots[i] = slots[j];
+			i = j;
+		}
+	}
+	slots[i] = Slot();
+	--count;
+	return ret;
+}
+
+void EdgeMap::reserve(size_t n)
+{
+	size_t capacity = slots.size();
+	while (n*2 > capacity) capacity *= 2;
+	if (capacity != slots.size()) rehash(capacity);
+}
+
+void EdgeMap::clear()
+{
+	slots.assign(slots.size(), Slot());
+	count = 0;
+}
+
+size_t EdgeMap::size() const
+{
+	return count;
+}
+
+unsigned long long EdgeMap::makeKey(unsigned int a, unsigned int b)
+{
+	// Unordered pair: smaller id in the high word
+	if (a > b) std::swap(a, b);
+	return ((unsigned long long)a << 32) | b;
+}
+
+size_t EdgeMap::home(unsigned long long key) const
+{
+	// Fibonacci hashing
+	return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+size_t EdgeMap::findSlot(unsigned long long key) const
+{
+	size_t i = home(key);
+	while (slots[i].edge && slots[i].key != key)
+		i = (i+1) & mask;
+	return i;
+}
+
+void EdgeMap::rehash(size_t capacity)
+{
+	std::vector<Slot> old;
+	old.swap(slots);
+	slots.resize(capacity);
+	mask = capacity-1;
+	for (size_t i = 0; i < old.size(); ++i)
+	{
+		if (!old[i].edge) continue;
+		size_t j = findSlot(old[i].key);
+		slots[j] = old[i];
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+
+class Edge;
+
+//
+// EdgeMap
+//
+// Open-addressing (linear probing) hash map from an unordered pair of node
+// ids to the edge joining them. Deletion shifts later entries back instead
+// of leaving tombstones, so probe chains stay short under heavy toggling.
+//
+class EdgeMap
+{
+public:
+
+	EdgeMap();
+
+	Edge * find(unsigned int a, unsigned int b) const;
+
+	bool insert(unsigned int a, unsigned int b, Edge * e);
+
+	Edge * erase(unsigned int a, unsigned int b);
+
+	void reserve(size_t n);
+
+	void clear();
+
+	size_t size() const;
+
+private:
+
+	struct Slot
+	{
+		Slot() : key(0), edge(0) {}
+		unsigned long long key;
+		Edge * edge; // null when the slot is empty
+	};
+
+	static unsigned long long makeKey(unsigned int a, unsigned int b);
+
+	size_t home(unsigned long long key) const;
+
+	size_t findSlot(unsigned long long key) const;
+
+	void rehash(size_t capacity);
+
+	std::vector<Slot> slots;
+	size_t count;
+	size_t mask;
+};
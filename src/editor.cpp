@@ -0,0 +1,652 @@
+#include "editor.h"
+#include "graph.h"
+#include "graphfile.h"
+#include "importer.h"
+#include "profiler.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+Editor::Editor(unsigned int width, unsigned int height, Index index)
+	: width(width), height(height), index(index)
+	, qtn(0, 0, (float)width, (float)height, 4)
+	, qte(0, 0, (float)width, (float)height, 4)
+	, hashn(32)
+	, hashe(32)
+	, nodeIndex(index == SPATIAL_HASH ? (SpatialIndex<Node*>*)&hashn : &qtn)
+	, edgeIndex(index == SPATIAL_HASH ? (SpatialIndex<Edge*>*)&hashe : &qte)
+	, selection(6, 0, 0, (int)width, (int)height)
+	, crossings(graph)
+	, showCrossings(false), showTree(false)
+	, hierarchy(graph), showPath(false), pathFrom(0), pathTo(0), pathDirty(false), structureDirty(false)
+	, keySpaceDown(false), keyAltDown(false), keyCtrlDown(false), keyShiftDown(false)
+	, mouseLeftDown(false), mouseRightDown(false), mouseDragMoving(false), mouseDragSelecting(false), mouseDownOnSelection(false)
+	, dragx1(0), dragy1(0), prevx(0), prevy(0), dragx2(0), dragy2(0)
+{
+	graph.setNodeSet(&nodes);
+	graph.setNodeIndex(nodeIndex);
+	graph.setEdgeSet(&edges);
+	graph.setEdgeIndex(edgeIndex);
+
+	// Loaded and imported graphs may reach beyond the window
+	qtn.setGrowable(true);
+	qte.setGrowable(true);
+}
+
+Editor::~Editor()
+{
+	selection.clearSelection();
+	graph.clear();
+}
+
+Selection & Editor::getSelection()
+{
+	return selection;
+}
+
+Graph & Editor::getGraph()
+{
+	return graph;
+}
+
+int Editor::getCrossingCount() const
+{
+	return showCrossings ? (int)crossings.count() : -1;
+}
+
+Editor::Action Editor::handleEvent(const sf::Event & event)
+{
+	PROFILE_SCOPE("Editor::handleEvent");
+	Action action = NONE;
+	switch (event.type)
+	{
+	case sf::Event::Closed:
+		return CLOSE;
+	case sf::Event::KeyPressed:
+		action = keyPressed(event);
+		break;
+	case sf::Event::KeyReleased:
+		keyReleased(event);
+		break;
+	case sf::Event::MouseButtonPressed:
+		mousePressed(event);
+		break;
+	case sf::Event::MouseButtonReleased:
+		mouseReleased(event);
+		break;
+	case sf::Event::MouseMoved:
+		mouseMoved(event);
+		break;
+	default:
+		break;
+	}
+
+	if (structureDirty) updateHighlights();
+	else if (pathDirty) updatePath();
+	return action;
+}
+
+//
+// Key pressed
+//
+Editor::Action Editor::keyPressed(const sf::Event & event)
+{
+	if (event.key.code == sf::Keyboard::Escape) // Escape
+	{
+		return CLOSE;
+	}
+	else if (event.key.code == sf::Keyboard::F1) // F1
+	{
+		return SCREENSHOT;
+	}
+	else if (event.key.code == sf::Keyboard::F2) // F2
+	{
+		return TOGGLE_PROFILER;
+	}
+	else if (event.key.code == sf::Keyboard::F3) // F3
+	{
+		return WRITE_PROFILE;
+	}
+	else if (event.key.code == sf::Keyboard::S && keyCtrlDown) // Ctrl+S
+	{
+		// Save graph
+		if (!GraphFile::write(graph, "../media/graph.bin"))
+			std::cout << "Could not save ../media/graph.bin" << std::endl;
+	}
+	else if (event.key.code == sf::Keyboard::O && keyCtrlDown) // Ctrl+O
+	{
+		// Replace graph with the saved one
+		GraphFile file;
+		if (file.open("../media/graph.bin"))
+		{
+			selection.clearSelection();
+			graph.clear();
+			fitQuadTrees();
+			file.instantiate(graph);
+			compact();
+			hierarchy.clear();
+			structureDirty = true;
+		}
+		else
+		{
+			std::cout << "Could not open ../media/graph.bin" << std::endl;
+		}
+	}
+	else if (event.key.code == sf::Keyboard::I && keyCtrlDown) // Ctrl+I
+	{
+		// Replace graph with an imported DIMACS one, fit to the window
+		selection.clearSelection();
+		graph.clear();
+		fitQuadTrees();
+		DimacsImporter importer;
+		importer.setBounds(10, 10, width-10.f, height-10.f);
+		if (!importer.import(graph, "../media/graph.co", "../media/graph.gr"))
+			std::cout << "Import failed: " << importer.getError() << std::endl;
+		else if (importer.getSkippedLines())
+			std::cout << "Import skipped " << importer.getSkippedLines() << " malformed lines" << std::endl;
+		compact();
+		hierarchy.clear();
+		structureDirty = true;
+	}
+	else if (event.key.code == sf::Keyboard::R && keyCtrlDown) // Ctrl+R
+	{
+		// Relocate nodes and edges into Z-curve order
+		compact();
+		hierarchy.clear();
+		structureDirty = true;
+	}
+	else if (event.key.code == sf::Keyboard::J && keyCtrlDown) // Ctrl+J
+	{
+		// Connect all nodes within 30 pixels of each other
+		graph.connectWithin(30);
+		hierarchy.clear();
+		structureDirty = true;
+	}
+	else if (event.key.code == sf::Keyboard::K && keyCtrlDown) // Ctrl+K
+	{
+		// Connect every node to its 3 nearest
+		graph.connectNearest(3);
+		hierarchy.clear();
+		structureDirty = true;
+	}
+	else if (event.key.code == sf::Keyboard::M && keyCtrlDown) // Ctrl+M
+	{
+		// Connect the nodes along their Euclidean minimum spanning tree
+		// and show it
+		std::vector<std::pair<Node*, Node*> > pairs;
+		graph.euclideanSpanningTree(pairs);
+		Edge::createEdges(pairs);
+		hierarchy.clear();
+		showTree = true;
+		structureDirty = true;
+	}
+	else if (event.key.code == sf::Keyboard::M) // M
+	{
+		// Toggle highlighting a minimum spanning forest
+		showTree = !showTree;
+		structureDirty = true;
+	}
+	else if (event.key.code == sf::Keyboard::C && !keyCtrlDown) // C
+	{
+		// Toggle highlighting crossing edges
+		showCrossings = !showCrossings;
+		structureDirty = true;
+	}
+	else if (event.key.code == sf::Keyboard::P) // P
+	{
+		// Highlight the shortest path between two selected nodes, or hide
+		// it
+		showPath = selection.size() == 2;
+		if (showPath)
+		{
+			pathFrom = selection.getNodes()[0]->handle();
+			pathTo = selection.getNodes()[1]->handle();
+		}
+		pathDirty = true;
+	}
+	else if (event.key.code == sf::Keyboard::LControl || event.key.code == sf::Keyboard::RControl) // Control
+	{
+		keyCtrlDown = true;
+	}
+	else if (event.key.code == sf::Keyboard::LShift || event.key.code == sf::Keyboard::RShift) // Shift
+	{
+		keyShiftDown = true;
+	}
+	else if (event.key.code == sf::Keyboard::LAlt || event.key.code == sf::Keyboard::RAlt) // Alt
+	{
+		keyAltDown = true;
+	}
+	else if (event.key.code == sf::Keyboard::Space) // Space
+	{
+		keySpaceDown = true;
+	}
+	else if (event.key.code == sf::Keyboard::Back || event.key.code == sf::Keyboard::Delete) // Backspace or Delete
+	{
+		// Delete selected nodes and their edges (clear the selection
+		// first, since node ids are reused once the nodes are gone).
+		// Nodes and edges are removed from the sets, the edge map and
+		// the quadtrees in one pass.
+		std::vector<Node*> v(selection.begin(), selection.end());
+		selection.clearSelection();
+		hierarchy.touch(v);
+		graph.eraseNodes(v);
+		fitQuadTrees();
+		structureDirty = true;
+	}
+	else if (event.key.code == sf::Keyboard::Insert || event.key.code == sf::Keyboard::E) // Insert or E
+	{
+		// Toggle edge on a pair of selected nodes
+		if (selection.size() == 2)
+		{
+			Selection::iterator i1 = selection.begin(), i2 = selection.begin();
+			++i2;
+			// Factory creates edge only of nodes are not already neighbors.
+			// Edges add themselves to edge set, quadtree and its nodes' edge lists.
+			if (!Edge::createEdge(*i1, *i2))
+			{
+				// Edge already exists, so remove it instead
+				Edge::destroyEdge(*i1, *i2);
+			}
+			hierarchy.touch(*i1);
+			hierarchy.touch(*i2);
+			structureDirty = true;
+		}
+	}
+	return NONE;
+}
+
+//
+// Key released
+//
+void Editor::keyReleased(const sf::Event & event)
+{
+	if (event.key.code == sf::Keyboard::LControl || event.key.code == sf::Keyboard::RControl) // Control
+	{
+		keyCtrlDown = false;
+	}
+	else if (event.key.code == sf::Keyboard::LShift || event.key.code == sf::Keyboard::RShift) // Shift
+	{
+		keyShiftDown = false;
+	}
+	else if (event.key.code == sf::Keyboard::LAlt || event.key.code == sf::Keyboard::RAlt) // Alt
+	{
+		keyAltDown = false;
+	}
+	else if (event.key.code == sf::Keyboard::Space) // Space
+	{
+		keySpaceDown = false;
+	}
+}
+
+//
+// Mouse pressed
+//
+void Editor::mousePressed(const sf::Event & event)
+{
+	if (event.mouseButton.button == sf::Mouse::Left)
+	{
+		mouseLeftDown = true;
+		dragx1 = prevx = event.mouseButton.x;
+		dragy1 = prevy = event.mouseButton.y;
+
+		if (keySpaceDown) // Space
+		{
+			
+		}
+		else if (keyCtrlDown) // Ctrl
+		{
+			// Check if mouse over node
+			std::vector<Node*> v;
+			if (nodeIndex->queryRegion(event.mouseButton.x+selection.getRange(), event.mouseButton.y+selection.getRange(), event.mouseButton.x-selection.getRange(), event.mouseButton.y-selection.getRange(), v))
+			{
+				Node * n = v[0];
+				// Add edge between clicked node and all selected nodes
+				Edge::createEdges(n, selection.getNodes());
+				hierarchy.touch(n);
+				hierarchy.touch(selection.getNodes());
+				structureDirty = true;
+				// If shift key not down, clear selection set
+				if (!keyShiftDown) selection.clearSelection();
+				// Add to selection
+				selection.insertSelection(n);
+				mouseDownOnSelection = true;
+			}
+			else
+			{
+				// Place node
+				if (nodeIndex->accepts((float)event.mouseButton.x, (float)event.mouseButton.y))
+				{
+					// Nodes add themselves to node set and quadtree
+					Node * n = Node::create(graph, event.mouseButton.x, event.mouseButton.y);
+					if (keyAltDown) selection.clearSelection();
+					// Add edge between new node and all selected nodes.
+					// Factory creates edge only of nodes are not already neighbors.
+					// Edges add themselves to edge set, quadtree and their nodes' edge lists.
+					Edge::createEdges(n, selection.getNodes());
+					hierarchy.touch(n);
+					hierarchy.touch(selection.getNodes());
+					structureDirty = true;
+					// Update selection
+					if (!keyShiftDown) selection.clearSelection();
+					// Add to selection
+					selection.insertSelection(n);
+					mouseDownOnSelection = true;
+				}
+			}
+		}
+		else if (keyShiftDown) // Shift
+		{
+			// Check if mouse over nodes
+			std::vector<Node*> v;
+			if (nodeIndex->queryRegion(event.mouseButton.x+selection.getRange(), event.mouseButton.y+selection.getRange(), event.mouseButton.x-selection.getRange(), event.mouseButton.y-selection.getRange(), v))
+			{
+				// Check if there's a node that's not selected
+				for (size_t i = 0; i < v.size(); ++i)
+				{
+					if (!v[i]->isSelected())
+					{
+						// Add single node to selection
+						selection.insertSelection(v[i]);
+						mouseDownOnSelection = true;
+						break;
+					}
+				}
+			}
+		}
+		else if (keyAltDown) // Alt
+		{
+			// Check if mouse over nodes
+			std::vector<Node*> v;
+			if (nodeIndex->queryRegion(event.mouseButton.x+selection.getRange(), event.mouseButton.y+selection.getRange(), event.mouseButton.x-selection.getRange(), event.mouseButton.y-selection.getRange(), v))
+			{
+				// Check if there's a node that's selected
+				for (size_t i = 0; i < v.size(); ++i)
+				{
+					if (v[i]->isSelected())
+					{
+						// Remove single node from selection
+						selection.eraseSelection(v[i]);
+						break;
+					}
+				}
+			}
+		}
+		else // Else
+		{
+			// Check if mouse over nodes
+			std::vector<Node*> v;
+			if (nodeIndex->queryRegion(event.mouseButton.x+selection.getRange(), event.mouseButton.y+selection.getRange(), event.mouseButton.x-selection.getRange(), event.mouseButton.y-selection.getRange(), v))
+			{
+				// Check if all nodes not selected
+				bool noneSelected = true;
+				for (size_t i = 0; i < v.size(); ++i)
+				{
+					if (v[i]->isSelected())
+					{
+						noneSelected = false;
+						mouseDownOnSelection = true;
+						break;
+					}
+				}
+				if (noneSelected)
+				{
+					// Select single node
+					selection.clearSelection();
+					selection.insertSelection(v[0]);
+					mouseDownOnSelection = true;
+				}
+			}
+			else
+			{
+				// Check if mouse over edges
+				std::vector<Edge*> v;
+				if (edgeIndex->queryRegion(event.mouseButton.x+selection.getRange(), event.mouseButton.y+selection.getRange(), event.mouseButton.x-selection.getRange(), event.mouseButton.y-selection.getRange(), v))
+				{
+					// Check if an edge's nodes are both in selection
+					bool noneSelected = true;
+					for (size_t i = 0; i < v.size(); ++i)
+					{
+						if (v[i]->n1->isSelected() && v[i]->n2->isSelected())
+						{
+							noneSelected = false;
+							mouseDownOnSelection = true;
+							break;
+						}
+					}
+					if (noneSelected)
+					{
+						// Select single edge
+						selection.clearSelection();
+						selection.insertSelection(v[0]->n1);
+						selection.insertSelection(v[0]->n2);
+						mouseDownOnSelection = true;
+					}
+				}
+				else
+				{
+					// Clear selection
+					selection.clearSelection();
+				}
+			}
+		}
+	}
+
+	//
+	// Right
+	//
+	if (event.mouseButton.button == sf::Mouse::Right)
+	{
+		mouseRightDown = true;
+	}
+}
+
+//
+// Mouse released
+//
+void Editor::mouseReleased(const sf::Event & event)
+{
+	if (event.mouseButton.button == sf::Mouse::Left)
+	{
+		if (mouseDragSelecting)
+		{
+			if (keyAltDown) // Alt
+			{
+				// Remove all from selection
+				std::vector<Node*> v;
+				nodeIndex->queryRegion(dragx1, dragy1, dragx2, dragy2, v);
+				selection.eraseSelection(v);
+			}
+			else if (!keyCtrlDown)
+			{
+				if (!keyShiftDown) // ! Shift
+				{
+					// Making new selection
+					selection.clearSelection();
+				}
+				// Add all to selection (that aren't already selected)
+				std::vector<Node*> v;
+				nodeIndex->queryRegion(dragx1, dragy1, dragx2, dragy2, v);
+				selection.insertSelection(v);
+			}
+		}
+
+		// Edge weights are lengths, so the spanning forest is recomputed
+		// once the drag ends
+		if (mouseDragMoving && showTree) structureDirty = true;
+
+		mouseLeftDown = false;
+		mouseDragMoving = false;
+		mouseDragSelecting = false;
+		mouseDownOnSelection = false;
+	}
+
+	//
+	// Right
+	//
+	if (event.mouseButton.button == sf::Mouse::Right)
+	{
+		mouseRightDown = false;
+	}
+}
+
+//
+// Mouse moved
+//
+void Editor::mouseMoved(const sf::Event & event)
+{
+	dragx2 = event.mouseMove.x;
+	dragy2 = event.mouseMove.y;
+	 
+	//
+	// Left
+	//
+	if (mouseLeftDown)
+	{
+		if (mouseDownOnSelection || keySpaceDown)
+		{
+			mouseDragMoving = true;
+			selection.moveSelection(dragx2-prevx, dragy2-prevy);
+			if (showCrossings) crossings.nodesTranslated(selection.getNodes());
+			hierarchy.touch(selection.getNodes());
+			pathDirty = showPath;
+		}
+		else //if (keyShiftDown || keyAltDown)
+		{
+			mouseDragSelecting = true;
+		}
+	}
+
+	//
+	// Right
+	//
+	if (mouseRightDown)
+	{
+
+	}
+
+	prevx = dragx2;
+	prevy = dragy2;
+}
+
+void Editor::draw(sf::RenderWindow & rw)
+{
+	PROFILE_SCOPE("Editor::draw");
+	// Draw QuadTree
+	//qtn.draw(rw);
+	if (index == QUADTREE) qte.draw(rw);
+
+	// Draw edges, crossed ones in red, path ones in blue and spanning
+	// forest ones in green. Nothing is culled: the view is the window the
+	// indices are fitted to, and edges are indexed by their midpoints, so
+	// an edge through the window may be indexed outside it
+	for (Slab<Edge>::iterator it = graph.edges.begin(); it != graph.edges.end(); ++it)
+	{
+		const sf::Color & fill = showCrossings && crossings.count(*it) ? sf::Color::Red
+			: showPath && onPath[(*it)->id] ? sf::Color::Blue
+			: showTree && inTree[(*it)->id] ? sf::Color::Green
+			: sf::Color::Black;
+		if ((*it)->rect.getFillColor() != fill) (*it)->rect.setFillColor(fill);
+		rw.draw((*it)->rect);
+		rw.draw((*it)->srect);
+		PROFILE_COUNT(DRAW_CALLS, 2);
+	}
+
+	// Draw nodes
+	for (Slab<Node>::iterator it = graph.nodes.begin(); it != graph.nodes.end(); ++it)
+	{
+		rw.draw((*it)->circ);
+		PROFILE_COUNT(DRAW_CALLS, 1);
+	}
+
+	// Draw drag select
+	if (mouseDragSelecting)
+	{
+		sf::RectangleShape rect(sf::Vector2f((float)std::abs(dragx1-dragx2), (float)std::abs(dragy1-dragy2)));
+		rect.setPosition((float)std::min(dragx1,dragx2), (float)std::min(dragy1,dragy2));
+		rect.setFillColor(sf::Color::Transparent);
+		rect.setOutlineThickness(1);
+		rect.setOutlineColor(sf::Color::Black);
+		rw.draw(rect);
+		PROFILE_COUNT(DRAW_CALLS, 1);
+	}
+}
+
+//
+// Recompute what is highlighted after edges were created, destroyed or
+// relocated (drags are tracked incrementally)
+//
+void Editor::updateHighlights()
+{
+	if (showCrossings) crossings.rebuild();
+	else crossings.clear();
+
+	inTree.clear();
+	if (showTree)
+	{
+		std::vector<Edge*> tree;
+		graph.minimumSpanningForest(tree);
+		inTree.assign(graph.edges.capacity(), 0);
+		for (size_t i = 0; i < tree.size(); ++i)
+			inTree[tree[i]->id] = 1;
+	}
+	updatePath();
+	structureDirty = false;
+}
+
+//
+// Recompute the highlighted path, updating only the hierarchy's clusters
+// touched since the last query
+//
+void Editor::updatePath()
+{
+	onPath.clear();
+	Node * s = showPath ? Node::get(graph, pathFrom) : 0;
+	Node * t = showPath ? Node::get(graph, pathTo) : 0;
+	showPath = s && t;
+	if (showPath)
+	{
+		std::vector<Node*> path;
+		hierarchy.findPath(s, t, path);
+		onPath.assign(graph.edges.capacity(), 0);
+		// A missed hierarchy.touch leaves a stale path with gaps, not a crash
+		for (size_t i = 1; i < path.size(); ++i)
+			if (Edge * e = Edge::findEdge(path[i-1], path[i])) onPath[e->id] = 1;
+	}
+	pathDirty = false;
+}
+
+//
+// Shrink grown quadtrees back toward the window once the graph contracts
+//
+void Editor::fitQuadTrees()
+{
+	qtn.shrink(0, 0, (float)width, (float)height);
+	qte.shrink(0, 0, (float)width, (float)height);
+}
+
+//
+// Graph::compact, carrying the selection over to the relocated nodes
+//
+void Editor::compact()
+{
+	std::vector<unsigned int> ids;
+	for (Selection::iterator it = selection.begin(); it != selection.end(); ++it)
+		ids.push_back((*it)->id);
+	selection.clearSelection();
+
+	Node * from = showPath ? Node::get(graph, pathFrom) : 0;
+	Node * to = showPath ? Node::get(graph, pathTo) : 0;
+	unsigned int fromId = from ? from->id : 0;
+	unsigned int toId = to ? to->id : 0;
+
+	std::vector<Node*> moved;
+	graph.compact(moved);
+
+	if (from) pathFrom = moved[fromId]->handle();
+	if (to) pathTo = moved[toId]->handle();
+
+	for (size_t i = 0; i < ids.size(); ++i)
+		selection.insertSelection(moved[ids[i]]);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+/*///=====================================================================
+
+	editor.h
+
+	The interactive graph editor: its graph with the sets and quadtrees
+	bound to it, the selection and the key/mouse state, driven by
+	sf::Events. It does not own a window, so the same handlers run under
+	the live window in main and under the headless trace replay.
+
+*///======================================================================
+
+#include <SFML/Graphics.hpp>
+#include <set>
+
+#include "crossings.h"
+#include "node.h"
+#include "edge.h"
+#include "graph.h"
+#include "hierarchicalsearch.h"
+#include "selection.h"
+#include "quadtree.h"
+#include "spatialhash.h"
+
+class Editor
+{
+public:
+
+	//
+	// Action
+	//
+	// What handleEvent asks of the window it runs under.
+	//
+	enum Action
+	{
+		NONE,
+		CLOSE,
+		SCREENSHOT,
+		TOGGLE_PROFILER,
+		WRITE_PROFILE
+	};
+
+	//
+	// Index
+	//
+	// What Node and Edge positions are indexed with.
+	//
+	enum Index
+	{
+		QUADTREE,		// growable QuadTrees
+		SPATIAL_HASH	// SpatialHashes, for evenly spread graphs
+	};
+
+	//
+	// Editor
+	//
+	// Creates an empty graph covering width x height, with node/edge sets
+	// and spatial indexes bound to it. Editors are independent of each
+	// other.
+	//
+	Editor(unsigned int width, unsigned int height, Index index = QUADTREE);
+
+	//
+	// ~Editor
+	//
+	// Destroys the graph.
+	//
+	~Editor();
+
+	//
+	// handleEvent
+	//
+	// Applies one input event: picking, box select, dragging the selection,
+	// edge toggles, deletes, save/load, import, compaction, automatic
+	// edges (Ctrl+J within a radius, Ctrl+K to nearest neighbors, Ctrl+M
+	// along the Euclidean minimum spanning tree), and highlighting of
+	// crossing edges (C), of a minimum spanning forest (M) and of the
+	// shortest path between two selected nodes (P).
+	//
+	Action handleEvent(const sf::Event & event);
+
+	void draw(sf::RenderWindow & rw);
+
+	Selection & getSelection();
+
+	Graph & getGraph();
+
+	//
+	// getCrossingCount
+	//
+	// The number of crossing edge pairs, kept up to date while dragging,
+	// or -1 while crossings are not shown.
+	//
+	int getCrossingCount() const;
+
+private:
+
+	Editor(const Editor &);
+	Editor & operator=(const Editor &);
+
+	Action keyPressed(const sf::Event & event);
+	void keyReleased(const sf::Event & event);
+	void mousePressed(const sf::Event & event);
+	void mouseReleased(const sf::Event & event);
+	void mouseMoved(const sf::Event & event);
+	void fitQuadTrees();
+	void compact();
+	void updateHighlights();
+	void updatePath();
+
+	unsigned int width;
+	unsigned int height;
+	Index index;
+
+	std::set<Node*> nodes;
+	QuadTree<Node*> qtn;
+	std::set<Edge*> edges;
+	QuadTree<Edge*> qte;
+	SpatialHash<Node*> hashn;
+	SpatialHash<Edge*> hashe;
+	SpatialIndex<Node*> * nodeIndex; // qtn or hashn
+	SpatialIndex<Edge*> * edgeIndex; // qte or hashe
+	Selection selection;
+	Graph graph; // after the sets and indexes, so it is destroyed first
+	Crossings crossings;
+	bool showCrossings;
+	bool showTree;
+	std::vector<unsigned char> inTree; // by Edge::id, while showTree
+	HierarchicalSearch hierarchy;
+	bool showPath;
+	uint64_t pathFrom; // Node handles, while showPath
+	uint64_t pathTo;
+	std::vector<unsigned char> onPath; // by Edge::id, while showPath
+	bool pathDirty; // path nodes or their neighbors moved
+	bool structureDirty; // edges were created, destroyed or relocated
+
+	bool keySpaceDown;
+	bool keyAltDown;
+	bool keyCtrlDown;
+	bool keyShiftDown;
+	bool mouseLeftDown;
+	bool mouseRightDown;
+	bool mouseDragMoving;
+	bool mouseDragSelecting;
+	bool mouseDownOnSelection;
+	int dragx1;
+	int dragy1;
+	int prevx;
+	int prevy;
+	int dragx2;
+	int dragy2;
+};
@@ -0,0 +1,196 @@
+#include "generators.h"
+#include "quadtree.h"
+#include "spatialjoin.h"
+
+#include <algorithm>
+#include <cmath>
+
+void GeneratedGraph::clear()
+{
+	x.clear();
+	y.clear();
+	edges.clear();
+}
+
+GraphGenerator::GraphGenerator(uint32_t seed, float x1, float y1, float x2, float y2)
+	: rng(seed)
+{
+	bounds[0] = std::min(x1,x2);
+	bounds[1] = std::min(y1,y2);
+	bounds[2] = std::max(x1,x2);
+	bounds[3] = std::max(y1,y2);
+}
+
+float GraphGenerator::randomX()
+{
+	std::uniform_real_distribution<float> u(bounds[0], bounds[2]);
+	return std::min(u(rng), std::nextafter(bounds[2], bounds[0]));
+}
+
+float GraphGenerator::randomY()
+{
+	std::uniform_real_distribution<float> u(bounds[1], bounds[3]);
+	return std::min(u(rng), std::nextafter(bounds[3], bounds[1]));
+}
+
+void GraphGenerator::grid(uint32_t cols, uint32_t rows, bool diagonals, GeneratedGraph & g)
+{
+	g.clear();
+	if (cols == 0 || rows == 0) return;
+
+	float dx = cols > 1 ? (bounds[2] - bounds[0]) / (cols - 1) : 0;
+	float dy = rows > 1 ? (bounds[3] - bounds[1]) / (rows - 1) : 0;
+	g.x.resize((size_t)cols * rows);
+	g.y.resize((size_t)cols * rows);
+	g.edges.reserve((size_t)cols * rows * (diagonals ? 4 : 2));
+
+	for (uint32_t r = 0; r < rows; ++r)
+	{
+		for (uint32_t c = 0; c < cols; ++c)
+		{
+			uint32_t i = r * cols + c;
+			g.x[i] = bounds[0] + c * dx;
+			g.y[i] = bounds[1] + r * dy;
+			if (c+1 < cols) g.edges.push_back(std::make_pair(i, i+1));
+			if (r+1 < rows) g.edges.push_back(std::make_pair(i, i+cols));
+			if (diagonals && c+1 < cols && r+1 < rows)
+			{
+				g.edges.push_back(std::make_pair(i, i+cols+1));
+				g.edges.push_back(std::make_pair(i+1, i+cols));
+			}
+		}
+	}
+}
+
+void GraphGenerator::geometric(uint32_t n, float radius, GeneratedGraph & g)
+{
+	g.clear();
+	if (n == 0) return;
+
+	float w = bounds[2] - bounds[0];
+	float h = bounds[3] - bounds[1];
+	if (radius <= 0)
+		radius = std::sqrt(6 * w * h / (3.14159265f * n));
+
+	g.x.resize(n);
+	g.y.resize(n);
+	std::vector<uint32_t> ids(n);
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		g.x[i] = randomX();
+		g.y[i] = randomY();
+		ids[i] = i;
+	}
+
+	// Deep enough that leaves stay small at any n
+	int depth = 1;
+	while (depth < 24 && ((uint64_t)1 << (2*depth)) < n / 4) ++depth;
+	QuadTree<uint32_t> qt(bounds[0], bounds[1], bounds[2], bounds[3], 8, depth);
+	qt.insert(ids, g.x, g.y);
+
+	// Pairs come back in thread order; sort them so the output only
+	// depends on the seed
+	radiusJoin(qt, radius, g.edges);
+	for (size_t k = 0; k < g.edges.size(); ++k)
+	{
+		if (g.edges[k].first > g.edges[k].second)
+			std::swap(g.edges[k].first, g.edges[k].second);
+	}
+	std::sort(g.edges.begin(), g.edges.end());
+}
+
+void GraphGenerator::planar(uint32_t n, GeneratedGraph & g)
+{
+	g.clear();
+	if (n == 0) return;
+
+	uint32_t cols = (uint32_t)std::ceil(std::sqrt((double)n));
+	uint32_t rows = (n + cols - 1) / cols;
+	float dx = (bounds[2] - bounds[0]) / cols;
+	float dy = (bounds[3] - bounds[1]) / rows;
+
+	// One point per cell, jittered within the middle of it so every quad
+	// of four neighbors stays convex
+	std::uniform_real_distribution<float> jitter(0.2f, 0.8f);
+	uint32_t count = cols * rows;
+	g.x.resize(count);
+	g.y.resize(count);
+	for (uint32_t r = 0; r < rows; ++r)
+	{
+		for (uint32_t c = 0; c < cols; ++c)
+		{
+			uint32_t i = r * cols + c;
+			g.x[i] = bounds[0] + (c + jitter(rng)) * dx;
+			g.y[i] = bounds[1] + (r + jitter(rng)) * dy;
+		}
+	}
+
+	g.edges.reserve((size_t)count * 3);
+	for (uint32_t r = 0; r < rows; ++r)
+	{
+		for (uint32_t c = 0; c < cols; ++c)
+		{
+			uint32_t i = r * cols + c;
+			if (c+1 < cols) g.edges.push_back(std::make_pair(i, i+1));
+			if (r+1 < rows) g.edges.push_back(std::make_pair(i, i+cols));
+			if (c+1 < cols && r+1 < rows)
+			{
+				uint32_t a = i, b = i+1, d = i+cols, e = i+cols+1;
+				float d1 = (g.x[e]-g.x[a])*(g.x[e]-g.x[a]) + (g.y[e]-g.y[a])*(g.y[e]-g.y[a]);
+				float d2 = (g.x[d]-g.x[b])*(g.x[d]-g.x[b]) + (g.y[d]-g.y[b])*(g.y[d]-g.y[b]);
+				if (d1 <= d2) g.edges.push_back(std::make_pair(a, e));
+				else g.edges.push_back(std::make_pair(b, d));
+			}
+		}
+	}
+}
+
+void GraphGenerator::scaleFree(uint32_t n, uint32_t m, GeneratedGraph & g)
+{
+	g.clear();
+	if (n == 0) return;
+	if (m == 0) m = 1;
+
+	g.x.resize(n);
+	g.y.resize(n);
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		g.x[i] = randomX();
+		g.y[i] = randomY();
+	}
+
+	// Seed with a clique of m+1 nodes
+	uint32_t first = std::min(n, m+1);
+	for (uint32_t i = 0; i < first; ++i)
+		for (uint32_t j = i+1; j < first; ++j)
+			g.edges.push_back(std::make_pair(i, j));
+
+	// Every edge endpoint once, so a uniform pick from it is a pick
+	// proportional to degree
+	std::vector<uint32_t> ends;
+	ends.reserve((size_t)n * m * 2);
+	for (size_t k = 0; k < g.edges.size(); ++k)
+	{
+		ends.push_back(g.edges[k].first);
+		ends.push_back(g.edges[k].second);
+	}
+	g.edges.reserve((size_t)n * m);
+
+	std::vector<uint32_t> picked;
+	for (uint32_t i = first; i < n; ++i)
+	{
+		picked.clear();
+		std::uniform_int_distribution<size_t> u(0, ends.size()-1);
+		while (picked.size() < m)
+		{
+			uint32_t j = ends[u(rng)];
+			if (std::find(picked.begin(), picked.end(), j) == picked.end()) picked.push_back(j);
+		}
+		for (size_t k = 0; k < picked.size(); ++k)
+		{
+			g.edges.push_back(std::make_pair(picked[k], i));
+			ends.push_back(picked[k]);
+			ends.push_back(i);
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+/*///=====================================================================
+
+	generators.h
+
+	Seeded generators for synthetic graphs, used as reproducible inputs for
+	the search benchmarks. They only produce coordinates and an edge list,
+	so they run headless; Graph::instantiate turns the result into live
+	Node/Edge objects.
+
+*///======================================================================
+
+#include <random>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+//
+// GeneratedGraph
+//
+// Node coordinates (SoA) and undirected edges as pairs of node indices,
+// each edge listed once.
+//
+struct GeneratedGraph
+{
+	void clear();
+
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<std::pair<uint32_t, uint32_t> > edges;
+};
+
+class GraphGenerator
+{
+public:
+
+	//
+	// GraphGenerator
+	//
+	// All nodes are placed inside the given rectangle. The same seed always
+	// produces the same graphs.
+	//
+	GraphGenerator(uint32_t seed, float x1, float y1, float x2, float y2);
+
+	//
+	// grid
+	//
+	// cols x rows lattice with 4-neighbor edges, plus both diagonals of
+	// every cell if diagonals is set.
+	//
+	void grid(uint32_t cols, uint32_t rows, bool diagonals, GeneratedGraph & g);
+
+	//
+	// geometric
+	//
+	// n uniform points, each connected to all others within radius. The
+	// pairs are found with a parallel radiusJoin over a QuadTree. A radius
+	// of 0 picks the one giving an expected degree of about 6.
+	//
+	void geometric(uint32_t n, float radius, GeneratedGraph & g);
+
+	//
+	// planar
+	//
+	// Delaunay-like triangulation of about n points: a jittered grid whose
+	// cells are split along their shorter diagonal, so it stays planar and
+	// its triangles are close to the Delaunay ones.
+	//
+	void planar(uint32_t n, GeneratedGraph & g);
+
+	//
+	// scaleFree
+	//
+	// Barabasi-Albert preferential attachment: every new node connects to m
+	// distinct existing nodes picked proportionally to their degree. Nodes
+	// are placed uniformly; positions carry no structure.
+	//
+	void scaleFree(uint32_t n, uint32_t m, GeneratedGraph & g);
+
+private:
+
+	float randomX();
+	float randomY();
+
+	std::mt19937 rng;
+	float bounds[4];
+};
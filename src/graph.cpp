@@ -0,0 +1,557 @@
+#include "graph.h"
+#include "generators.h"
+#include "profiler.h"
+#include "quadtree.h"
+#include "search.h"
+#include "spanningtree.h"
+#include "spatialjoin.h"
+#include "transaction.h"
+
+#include <algorithm>
+#include <float.h>
+#include <stdint.h>
+
+namespace
+{
+	struct Marked
+	{
+		Marked(const std::vector<unsigned char> & marks) : marks(marks) {}
+		template<typename T>
+		bool operator()(T t) const { return marks[t->id] != 0; }
+		const std::vector<unsigned char> & marks;
+	};
+
+	struct Bounds
+	{
+		Bounds() : xmin(FLT_MAX), ymin(FLT_MAX), xmax(-FLT_MAX), ymax(-FLT_MAX) {}
+		void add(float x, float y)
+		{
+			if (x < xmin) xmin = x;
+			if (y < ymin) ymin = y;
+			if (x > xmax) xmax = x;
+			if (y > ymax) ymax = y;
+		}
+		float xmin, ymin, xmax, ymax;
+	};
+
+	struct Everything
+	{
+		template<typename T>
+		bool operator()(T) const { return true; }
+	};
+
+	//
+	// Spreads the low 16 bits of v to the even bits
+	//
+	uint32_t spread(uint32_t v)
+	{
+		v &= 0xffff;
+		v = (v | (v << 8)) & 0x00ff00ff;
+		v = (v | (v << 4)) & 0x0f0f0f0f;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	}
+
+	//
+	// Morton
+	//
+	// Z-curve code of a point, quantized to 16 bits per axis over bounds.
+	//
+	struct Morton
+	{
+		Morton(const Bounds & b) : b(b)
+		{
+			sx = b.xmax > b.xmin ? 65535.f / (b.xmax - b.xmin) : 0.f;
+			sy = b.ymax > b.ymin ? 65535.f / (b.ymax - b.ymin) : 0.f;
+		}
+		uint32_t operator()(float x, float y) const
+		{
+			float qx = std::min(std::max((x - b.xmin) * sx, 0.f), 65535.f);
+			float qy = std::min(std::max((y - b.ymin) * sy, 0.f), 65535.f);
+			return spread((uint32_t)qx) | (spread((uint32_t)qy) << 1);
+		}
+		Bounds b;
+		float sx, sy;
+	};
+
+	//
+	// Sorts (code, slot) keys and returns the slots in that order
+	//
+	std::vector<unsigned int> sortedSlots(std::vector<std::pair<uint32_t, unsigned int> > & keys)
+	{
+		std::sort(keys.begin(), keys.end());
+		std::vector<unsigned int> order(keys.size());
+		for (size_t i = 0; i < keys.size(); ++i)
+			order[i] = keys[i].second;
+		return order;
+	}
+
+	typedef std::vector<std::pair<Node*, Node*> > NodePairs;
+
+	struct WithinJoin
+	{
+		WithinJoin(float r, NodePairs & pairs) : r(r), pairs(pairs) {}
+		void operator()(QuadTree<Node*> & qt) const { radiusJoin(qt, r, pairs); }
+		float r;
+		NodePairs & pairs;
+	};
+
+	struct NearestJoin
+	{
+		NearestJoin(unsigned int k, NodePairs & pairs, unsigned int threads = 0) : k(k), pairs(pairs), threads(threads) {}
+		void operator()(QuadTree<Node*> & qt) const { nearestJoin(qt, k, pairs, threads); }
+		unsigned int k;
+		NodePairs & pairs;
+		unsigned int threads;
+	};
+
+	//
+	// Runs a join on the node quadtree, or on one built over the nodes when
+	// they are indexed otherwise (or not at all)
+	//
+	template<typename Join>
+	void joinNodes(SpatialIndex<Node*> * index, const Slab<Node> & nodes, const Join & join)
+	{
+		QuadTree<Node*> * qt = dynamic_cast<QuadTree<Node*>*>(index);
+		if (qt)
+		{
+			join(*qt);
+			return;
+		}
+
+		Bounds b;
+		std::vector<Node*> v;
+		std::vector<float> xs;
+		std::vector<float> ys;
+		for (Slab<Node>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+		{
+			b.add((*it)->x, (*it)->y);
+			v.push_back(*it);
+			xs.push_back((*it)->x);
+			ys.push_back((*it)->y);
+		}
+		if (v.empty()) return;
+		QuadTree<Node*> tree(b.xmin - 1, b.ymin - 1, b.xmax + 1, b.ymax + 1, 8, 16);
+		tree.insert(v, xs, ys);
+		join(tree);
+	}
+
+	//
+	// NearestNodes
+	//
+	// Candidates for nearestSpanningTree: each node's k nearest, by the
+	// dense index the tree is built over.
+	//
+	struct NearestNodes
+	{
+		NearestNodes(SpatialIndex<Node*> * index, const Slab<Node> & nodes, const std::vector<uint32_t> & dense, unsigned int threads)
+			: index(index), nodes(nodes), dense(dense), threads(threads) {}
+		void operator()(unsigned int k, std::vector<std::pair<uint32_t, uint32_t> > & ret)
+		{
+			pairs.clear();
+			joinNodes(index, nodes, NearestJoin(k, pairs, threads));
+			ret.reserve(ret.size() + pairs.size());
+			for (size_t i = 0; i < pairs.size(); ++i)
+				ret.push_back(std::make_pair(dense[pairs[i].first->id], dense[pairs[i].second->id]));
+		}
+		SpatialIndex<Node*> * index;
+		const Slab<Node> & nodes;
+		const std::vector<uint32_t> & dense;
+		unsigned int threads;
+		NodePairs pairs;
+	};
+
+	//
+	// Erase marked items from a set, rebuilding it when that is cheaper
+	//
+	template<typename T>
+	void sweep(std::set<T*> & set, const std::vector<T*> & doomed, const std::vector<unsigned char> & marks)
+	{
+		if (doomed.size() * 8 < set.size())
+		{
+			for (size_t i = 0; i < doomed.size(); ++i)
+				set.erase(doomed[i]);
+		}
+		else
+		{
+			std::set<T*> keep;
+			for (typename std::set<T*>::iterator it = set.begin(); it != set.end(); ++it)
+			{
+				if (!marks[(*it)->id]) keep.insert(keep.end(), *it);
+			}
+			set.swap(keep);
+		}
+	}
+}
+
+Graph::Graph() : nset(0), nodeIndex(0), eset(0), edgeIndex(0), transaction(0)
+{
+}
+
+Graph::~Graph()
+{
+	clear();
+}
+
+void Graph::setNodeSet(std::set<Node*> * nodeSet)
+{
+	nset = nodeSet;
+}
+
+void Graph::setNodeIndex(SpatialIndex<Node*> * index)
+{
+	nodeIndex = index;
+}
+
+void Graph::setEdgeSet(std::set<Edge*> * edgeSet)
+{
+	eset = edgeSet;
+}
+
+void Graph::setEdgeIndex(SpatialIndex<Edge*> * index)
+{
+	edgeIndex = index;
+}
+
+std::set<Node*> * Graph::getNodeSet() const
+{
+	return nset;
+}
+
+SpatialIndex<Node*> * Graph::getNodeIndex() const
+{
+	return nodeIndex;
+}
+
+std::set<Edge*> * Graph::getEdgeSet() const
+{
+	return eset;
+}
+
+SpatialIndex<Edge*> * Graph::getEdgeIndex() const
+{
+	return edgeIndex;
+}
+
+Transaction * Graph::getTransaction() const
+{
+	return transaction;
+}
+
+void Graph::eraseNodes(const std::vector<Node*> & targets)
+{
+	PROFILE_SCOPE("Graph::eraseNodes");
+	if (transaction)
+		assert(!"Graph::eraseNodes: not supported inside a transaction");
+
+	// Mark nodes
+	std::vector<unsigned char> nodeMarks(nodes.capacity(), 0);
+	std::vector<Node*> doomedNodes;
+	doomedNodes.reserve(targets.size());
+	for (std::vector<Node*>::const_iterator it = targets.begin(); it != targets.end(); ++it)
+	{
+		if (nodeMarks[(*it)->id]) continue;
+		nodeMarks[(*it)->id] = 1;
+		doomedNodes.push_back(*it);
+	}
+	if (doomedNodes.empty()) return;
+
+	// Mark their edges, and the surviving nodes on the other end
+	std::vector<unsigned char> edgeMarks(edges.capacity(), 0);
+	std::vector<Edge*> doomedEdges;
+	std::vector<Node*> touched;
+	for (size_t i = 0; i < doomedNodes.size(); ++i)
+	{
+		Node * n = doomedNodes[i];
+		for (Node::EdgeList::iterator it = n->edges.begin(); it != n->edges.end(); ++it)
+		{
+			Edge * e = *it;
+			if (edgeMarks[e->id]) continue;
+			edgeMarks[e->id] = 1;
+			doomedEdges.push_back(e);
+
+			Node * o = e->other(n);
+			if (!nodeMarks[o->id])
+			{
+				nodeMarks[o->id] = 2; // touched survivor
+				touched.push_back(o);
+			}
+		}
+	}
+
+	// Compact surviving neighbors' edge lists
+	for (size_t i = 0; i < touched.size(); ++i)
+	{
+		Node * n = touched[i];
+		unsigned int k = 0;
+		for (unsigned int j = 0; j < n->edges.size(); ++j)
+		{
+			Edge * e = n->edges[j];
+			if (edgeMarks[e->id]) continue;
+			n->edges[k] = e;
+			e->slot(n) = k;
+			++k;
+		}
+		while (n->edges.size() > k) n->edges.pop_back();
+		nodeMarks[n->id] = 0;
+	}
+
+	// Edge map
+	for (size_t i = 0; i < doomedEdges.size(); ++i)
+		emap.erase(doomedEdges[i]->n1->id, doomedEdges[i]->n2->id);
+
+	// Sets
+	if (nset) sweep(*nset, doomedNodes, nodeMarks);
+	if (eset) sweep(*eset, doomedEdges, edgeMarks);
+
+	// Quadtrees, pruned once over the bounds of what is being erased
+	if (nodeIndex)
+	{
+		Bounds b;
+		for (size_t i = 0; i < doomedNodes.size(); ++i)
+			b.add(doomedNodes[i]->x, doomedNodes[i]->y);
+		nodeIndex->eraseIf(Marked(nodeMarks), b.xmin-1, b.ymin-1, b.xmax+1, b.ymax+1);
+	}
+	if (edgeIndex && !doomedEdges.empty())
+	{
+		Bounds b;
+		for (size_t i = 0; i < doomedEdges.size(); ++i)
+			b.add(doomedEdges[i]->srect.getPosition().x, doomedEdges[i]->srect.getPosition().y);
+		edgeIndex->eraseIf(Marked(edgeMarks), b.xmin-1, b.ymin-1, b.xmax+1, b.ymax+1);
+	}
+
+	// Free storage
+	for (size_t i = 0; i < doomedEdges.size(); ++i)
+		Edge::free(doomedEdges[i]);
+	for (size_t i = 0; i < doomedNodes.size(); ++i)
+	{
+		doomedNodes[i]->edges.clear();
+		Node::free(doomedNodes[i]);
+	}
+}
+
+void Graph::clear()
+{
+	if (transaction)
+		assert(!"Graph::clear: not supported inside a transaction");
+	eraseNodes(nodes.begin(), nodes.end());
+}
+
+std::vector<Node*> Graph::instantiate(const GeneratedGraph & g, float thickness)
+{
+	std::vector<Node*> created(g.x.size(), (Node*)0);
+
+	Transaction t(*this);
+
+	for (size_t i = 0; i < g.x.size(); ++i)
+	{
+		if (nodeIndex && !nodeIndex->accepts(g.x[i], g.y[i])) continue;
+		created[i] = Node::create(*this, g.x[i], g.y[i]);
+	}
+
+	std::vector<std::pair<Node*, Node*> > pairs;
+	pairs.reserve(g.edges.size());
+	for (size_t i = 0; i < g.edges.size(); ++i)
+	{
+		Node * a = created[g.edges[i].first];
+		Node * b = created[g.edges[i].second];
+		if (a && b) pairs.push_back(std::make_pair(a, b));
+	}
+	Edge::createEdges(pairs, thickness);
+
+	t.commit();
+	return created;
+}
+
+void Graph::buildSearchGraph(SearchGraph & sg) const
+{
+	std::vector<float> x(nodes.capacity(), 0.f);
+	std::vector<float> y(nodes.capacity(), 0.f);
+	for (Slab<Node>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+	{
+		x[(*it)->id] = (*it)->x;
+		y[(*it)->id] = (*it)->y;
+	}
+
+	std::vector<std::pair<uint32_t, uint32_t> > pairs;
+	pairs.reserve(edges.size());
+	for (Slab<Edge>::iterator it = edges.begin(); it != edges.end(); ++it)
+		pairs.push_back(std::make_pair((uint32_t)(*it)->n1->id, (uint32_t)(*it)->n2->id));
+
+	sg.build(x, y, pairs);
+}
+
+int Graph::connectWithin(float r, float thickness)
+{
+	PROFILE_SCOPE("Graph::connectWithin");
+	if (transaction)
+		assert(!"Graph::connectWithin: not supported inside a transaction");
+
+	NodePairs pairs;
+	joinNodes(nodeIndex, nodes, WithinJoin(r, pairs));
+	return Edge::createEdges(pairs, thickness);
+}
+
+int Graph::connectNearest(unsigned int k, float thickness)
+{
+	PROFILE_SCOPE("Graph::connectNearest");
+	if (transaction)
+		assert(!"Graph::connectNearest: not supported inside a transaction");
+
+	NodePairs pairs;
+	joinNodes(nodeIndex, nodes, NearestJoin(k, pairs));
+	return Edge::createEdges(pairs, thickness);
+}
+
+double Graph::minimumSpanningForest(std::vector<Edge*> & ret, unsigned int threads) const
+{
+	PROFILE_SCOPE("Graph::minimumSpanningForest");
+	SearchGraph sg;
+	buildSearchGraph(sg);
+	std::vector<std::pair<uint32_t, uint32_t> > pairs;
+	double weight = ::minimumSpanningForest(sg, pairs, threads);
+	ret.reserve(ret.size() + pairs.size());
+	for (size_t i = 0; i < pairs.size(); ++i)
+		ret.push_back(Edge::findEdge(nodes.at(pairs[i].first), nodes.at(pairs[i].second)));
+	return weight;
+}
+
+double Graph::euclideanSpanningTree(std::vector<std::pair<Node*, Node*> > & ret, unsigned int k, unsigned int threads)
+{
+	PROFILE_SCOPE("Graph::euclideanSpanningTree");
+	if (transaction)
+		assert(!"Graph::euclideanSpanningTree: not supported inside a transaction");
+
+	// Live nodes densely, so free slots do not count as unreached points
+	std::vector<uint32_t> dense(nodes.capacity(), 0);
+	std::vector<Node*> live;
+	std::vector<float> x;
+	std::vector<float> y;
+	for (Slab<Node>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+	{
+		dense[(*it)->id] = (uint32_t)live.size();
+		live.push_back(*it);
+		x.push_back((*it)->x);
+		y.push_back((*it)->y);
+	}
+
+	NearestNodes candidates(nodeIndex, nodes, dense, threads);
+	std::vector<std::pair<uint32_t, uint32_t> > pairs;
+	double weight = nearestSpanningTree(x, y, candidates, pairs, k, threads);
+	ret.reserve(ret.size() + pairs.size());
+	for (size_t i = 0; i < pairs.size(); ++i)
+		ret.push_back(std::make_pair(live[pairs[i].first], live[pairs[i].second]));
+	return weight;
+}
+
+void Graph::compact()
+{
+	std::vector<Node*> moved;
+	compact(moved);
+}
+
+void Graph::compact(std::vector<Node*> & moved)
+{
+	PROFILE_SCOPE("Graph::compact");
+	if (transaction)
+		assert(!"Graph::compact: not supported inside a transaction");
+
+	// Z-curve order of nodes, and of edges by midpoint over the same bounds
+	Bounds b;
+	for (Slab<Node>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+		b.add((*it)->x, (*it)->y);
+	Morton morton(b);
+
+	std::vector<std::pair<uint32_t, unsigned int> > keys;
+	keys.reserve(nodes.size());
+	for (Slab<Node>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+		keys.push_back(std::make_pair(morton((*it)->x, (*it)->y), (*it)->id));
+	std::vector<unsigned int> nodeOrder = sortedSlots(keys);
+
+	keys.clear();
+	keys.reserve(edges.size());
+	for (Slab<Edge>::iterator it = edges.begin(); it != edges.end(); ++it)
+	{
+		Edge * e = *it;
+		keys.push_back(std::make_pair(morton((e->n1->x + e->n2->x) / 2, (e->n1->y + e->n2->y) / 2), e->id));
+	}
+	std::vector<unsigned int> edgeOrder = sortedSlots(keys);
+
+	// Record links by old id while the old objects are still there
+	std::vector<unsigned int> ends(2 * edges.capacity(), 0);
+	for (Slab<Edge>::iterator it = edges.begin(); it != edges.end(); ++it)
+	{
+		ends[2 * (*it)->id] = (*it)->n1->id;
+		ends[2 * (*it)->id + 1] = (*it)->n2->id;
+	}
+	std::vector<unsigned int> lists;
+	lists.reserve(2 * edges.size());
+	for (size_t k = 0; k < nodeOrder.size(); ++k)
+	{
+		Node * n = nodes.at(nodeOrder[k]);
+		for (Node::EdgeList::iterator it = n->edges.begin(); it != n->edges.end(); ++it)
+			lists.push_back((*it)->id);
+	}
+
+	// Indexes and sets hold the old pointers; empty them before they dangle
+	if (nodeIndex) nodeIndex->eraseIf(Everything());
+	if (edgeIndex) edgeIndex->eraseIf(Everything());
+	if (nset) nset->clear();
+	if (eset) eset->clear();
+	emap.clear();
+
+	// Move
+	std::vector<Edge*> movedEdges;
+	nodes.relocate(nodeOrder, &Node::relocate, moved);
+	edges.relocate(edgeOrder, &Edge::relocate, movedEdges);
+
+	// Remap ids and links; edge list order (and so s1/s2) is unchanged
+	size_t l = 0;
+	for (unsigned int k = 0; k < nodes.size(); ++k)
+	{
+		Node * n = nodes.at(k);
+		n->id = k;
+		for (unsigned int j = 0; j < n->edges.size(); ++j)
+			n->edges[j] = movedEdges[lists[l++]];
+	}
+	for (unsigned int k = 0; k < edges.size(); ++k)
+	{
+		Edge * e = edges.at(k);
+		e->n1 = moved[ends[2 * edgeOrder[k]]];
+		e->n2 = moved[ends[2 * edgeOrder[k] + 1]];
+		e->id = k;
+	}
+
+	// Rebuild the edge map, sets and indexes in the new order
+	emap.reserve(edges.size());
+	std::vector<Node*> liveNodes;
+	std::vector<float> xs;
+	std::vector<float> ys;
+	liveNodes.reserve(nodes.size());
+	xs.reserve(nodes.size());
+	ys.reserve(nodes.size());
+	for (Slab<Node>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+	{
+		liveNodes.push_back(*it);
+		xs.push_back((*it)->x);
+		ys.push_back((*it)->y);
+	}
+	if (nodeIndex) nodeIndex->insert(liveNodes, xs, ys);
+	if (nset) nset->insert(liveNodes.begin(), liveNodes.end());
+
+	std::vector<Edge*> liveEdges;
+	liveEdges.reserve(edges.size());
+	xs.clear();
+	ys.clear();
+	for (Slab<Edge>::iterator it = edges.begin(); it != edges.end(); ++it)
+	{
+		Edge * e = *it;
+		emap.insert(e->n1->id, e->n2->id, e);
+		liveEdges.push_back(e);
+		xs.push_back(e->srect.getPosition().x);
+		ys.push_back(e->srect.getPosition().y);
+	}
+	if (edgeIndex) edgeIndex->insert(liveEdges, xs, ys);
+	if (eset) eset->insert(liveEdges.begin(), liveEdges.end());
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <set>
+#include <vector>
+
+#include "node.h"
+#include "edge.h"
+#include "edgemap.h"
+#include "slab.h"
+#include "spatialindex.h"
+
+struct GeneratedGraph;
+class SearchGraph;
+class Transaction;
+
+//
+// Graph
+//
+// One graph: the storage of its nodes and edges, its edge map, the
+// node/edge sets and spatial indexes bound to it, and its open
+// transaction. Nodes and edges belong to the graph they were created in
+// and reach it through Node::graph / Edge::graph; nothing is shared
+// between graphs, so separate graphs may be used from separate threads.
+//
+// Also the whole-graph operations that touch many nodes and edges at once
+// and keep the sets, indexes and edge map in sync with a single pass
+// instead of per-object maintenance.
+//
+class Graph
+{
+	friend class Node;
+	friend class Edge;
+	friend class Transaction;
+
+public:
+
+	//
+	// Graph
+	//
+	// An empty graph with no sets or indexes bound.
+	//
+	Graph();
+
+	//
+	// ~Graph
+	//
+	// Destroys every node and edge (and erases them from the bound sets
+	// and indexes).
+	//
+	~Graph();
+
+	//
+	// setNodeSet, setNodeIndex, setEdgeSet, setEdgeIndex
+	//
+	// Binds the containers nodes and edges keep themselves in, or unbinds
+	// them (null). They are not owned, and should be bound while the graph
+	// is empty.
+	//
+	void setNodeSet(std::set<Node*> * nodeSet);
+	void setNodeIndex(SpatialIndex<Node*> * index);
+	void setEdgeSet(std::set<Edge*> * edgeSet);
+	void setEdgeIndex(SpatialIndex<Edge*> * index);
+
+	std::set<Node*> * getNodeSet() const;
+	SpatialIndex<Node*> * getNodeIndex() const;
+	std::set<Edge*> * getEdgeSet() const;
+	SpatialIndex<Edge*> * getEdgeIndex() const;
+
+	//
+	// getTransaction
+	//
+	// The transaction open on this graph, if any.
+	//
+	Transaction * getTransaction() const;
+
+	//
+	// eraseNodes
+	//
+	// Destroys the given nodes (duplicates are ignored) and all of their
+	// edges. Surviving neighbors' edge lists are compacted once each, the
+	// sets are swept (or rebuilt, when most of them goes) and each quadtree
+	// is pruned in one pass over the affected region.
+	//
+	template<typename Iterator>
+	void eraseNodes(Iterator first, Iterator last)
+	{
+		std::vector<Node*> v(first, last);
+		eraseNodes(v);
+	}
+	void eraseNodes(const std::vector<Node*> & targets);
+
+	//
+	// clear
+	//
+	// Destroys every node and edge.
+	//
+	void clear();
+
+	//
+	// instantiate
+	//
+	// Creates a node for every generated point and an edge for every
+	// generated edge, all in one Transaction. Points outside the node
+	// quadtree are skipped, along with their edges. Returns the nodes by
+	// generated index (null where skipped).
+	//
+	std::vector<Node*> instantiate(const GeneratedGraph & g, float thickness = 2);
+
+	//
+	// connectWithin
+	//
+	// Creates an edge between every pair of nodes at most r apart that are
+	// not neighbors yet. Returns the number of edges created.
+	//
+	// connectNearest
+	//
+	// Creates an edge from every node to each of its k nearest others
+	// (ties broken arbitrarily), unless they are neighbors already. Returns
+	// the number of edges created.
+	//
+	// Both find the pairs with a parallel join over the node quadtree's
+	// leaves (see spatialjoin.h), or over a quadtree built for the purpose
+	// when nodes are indexed otherwise, and create the edges in one
+	// Transaction. Not supported inside a transaction, where the index is
+	// behind.
+	//
+	int connectWithin(float r, float thickness = 2);
+	int connectNearest(unsigned int k, float thickness = 2);
+
+	//
+	// minimumSpanningForest
+	//
+	// Pushes the edges of a minimum spanning forest, by edge length, into
+	// ret and returns its total length. Runs Boruvka's algorithm in
+	// parallel over a SearchGraph (see spanningtree.h).
+	//
+	double minimumSpanningForest(std::vector<Edge*> & ret, unsigned int threads = 0) const;
+
+	//
+	// euclideanSpanningTree
+	//
+	// Pushes the node pairs of a minimum spanning tree of the node
+	// positions into ret, whether or not they are neighbors, and returns
+	// its total length. Candidate pairs come from a k-nearest join on the
+	// node quadtree, as in connectNearest. Not supported inside a
+	// transaction.
+	//
+	double euclideanSpanningTree(std::vector<std::pair<Node*, Node*> > & ret, unsigned int k = 8, unsigned int threads = 0);
+
+	//
+	// compact
+	//
+	// Relocates every node and edge into dense slab storage in Morton
+	// (Z-curve) order of position: nodes by their own position, edges by
+	// their midpoint. Neighbors, the nodes a region query returns together
+	// and the edges between them end up close in memory, and ids follow.
+	// Edge endpoints, edge lists, the edge map, the sets and the spatial
+	// indexes are remapped. All Node and Edge pointers and handles are
+	// invalidated; moved gets the new node for each old node id (null for
+	// free slots). Run after building or loading a large graph.
+	//
+	void compact();
+	void compact(std::vector<Node*> & moved);
+
+	//
+	// buildSearchGraph
+	//
+	// Builds a SearchGraph of the live nodes and edges. Search graph
+	// indices are node slab indices (Node::id); free slots become isolated
+	// vertices at the origin.
+	//
+	void buildSearchGraph(SearchGraph & sg) const;
+
+	Slab<Node> nodes;
+	Slab<Edge> edges;
+
+private:
+
+	Graph(const Graph &);
+	Graph & operator=(const Graph &);
+
+	EdgeMap emap;
+	std::set<Node*> * nset;
+	SpatialIndex<Node*> * nodeIndex;
+	std::set<Edge*> * eset;
+	SpatialIndex<Edge*> * edgeIndex;
+	Transaction * transaction;
+};
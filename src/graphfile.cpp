@@ -0,0 +1,370 @@
+#include "graphfile.h"
+#include "edge.h"
+#include "graph.h"
+#include "simd.h"
+#include "transaction.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char MAGIC[8] = { 'G','R','A','P','H','B','I','N' };
+	const uint64_t ALIGN = 64;
+
+	uint64_t align(uint64_t offset)
+	{
+		return (offset + ALIGN-1) & ~(ALIGN-1);
+	}
+
+	bool writeBlock(FILE * f, uint64_t & offset, const void * p, uint64_t bytes)
+	{
+		static const char zeros[ALIGN] = { 0 };
+		uint64_t start = align(offset);
+		if (start != offset && fwrite(zeros, 1, (size_t)(start-offset), f) != start-offset) return false;
+		if (bytes && fwrite(p, 1, (size_t)bytes, f) != bytes) return false;
+		offset = start + bytes;
+		return true;
+	}
+
+	//
+	// Whether count elements of the given size at offset lie inside the
+	// file, 4-byte aligned, without overflowing
+	//
+	bool fits(uint64_t offset, uint64_t count, uint64_t bytes, uint64_t size)
+	{
+		return offset % 4 == 0 && offset <= size && count <= (size - offset) / bytes;
+	}
+
+	struct FileIndex
+	{
+		FileIndex(const std::vector<uint32_t> & index) : index(index) {}
+		unsigned int operator()(Node * n) const { return index[n->id]; }
+		const std::vector<uint32_t> & index;
+	};
+}
+
+GraphFile::GraphFile()
+	: header(0), x(0), y(0), rowStart(0), adjacency(0), cells(0), cellItems(0), data(0), size(0)
+#ifdef _WIN32
+	, file(INVALID_HANDLE_VALUE), mapping(0)
+#else
+	, fd(-1)
+#endif
+{
+}
+
+GraphFile::~GraphFile()
+{
+	close();
+}
+
+bool GraphFile::open(const std::string & path, bool validateAll)
+{
+	close();
+
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(GraphFileHeader)) { close(); return false; }
+	size = (size_t)fileSize.QuadPart;
+	mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping) { close(); return false; }
+	data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data) { close(); return false; }
+#else
+	fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(GraphFileHeader)) { close(); return false; }
+	size = (size_t)st.st_size;
+	void * p = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) { close(); return false; }
+	data = (const char*)p;
+#endif
+
+	// Validate header
+	const GraphFileHeader * h = (const GraphFileHeader*)data;
+	if (memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 || h->version != VERSION || h->endian != 0x01020304)
+	{
+		close();
+		return false;
+	}
+
+	// Validate blocks
+	uint64_t n = h->nodeCount;
+	bool quadtree = (h->flags & HAS_QUADTREE) != 0;
+	if (n >= 0xFFFFFFFFu || h->edgeCount >= 0x7FFFFFFFu
+		|| !fits(h->xOffset, n, 4, size) || !fits(h->yOffset, n, 4, size)
+		|| !fits(h->rowStartOffset, n+1, 4, size) || !fits(h->adjacencyOffset, h->edgeCount*2, 4, size)
+		|| (quadtree && (h->cellCount == 0 || h->cellCount >= 0x7FFFFFFFu
+			|| !fits(h->cellOffset, h->cellCount, sizeof(LayoutCell), size) || !fits(h->cellItemOffset, n, 4, size))))
+	{
+		close();
+		return false;
+	}
+
+	header = h;
+	x = (const float*)(data + h->xOffset);
+	y = (const float*)(data + h->yOffset);
+	rowStart = (const uint32_t*)(data + h->rowStartOffset);
+	adjacency = (const uint32_t*)(data + h->adjacencyOffset);
+	if (quadtree)
+	{
+		cells = (const LayoutCell*)(data + h->cellOffset);
+		cellItems = (const uint32_t*)(data + h->cellItemOffset);
+	}
+
+	// Everything below the header is checked where it is read, unless
+	// asked for up front (which reads the whole file)
+	if (validateAll && !validate())
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+//
+// Checks every stored index: CSR offsets rise and stay within the
+// adjacency, neighbors and leaf items are node indices, leaves stay
+// within cellItems, and child links form a tree (each cell is the child
+// of at most one cell, which comes before it).
+//
+bool GraphFile::validate() const
+{
+	uint32_t n = (uint32_t)header->nodeCount;
+	uint32_t arcs = (uint32_t)header->edgeCount * 2;
+
+	if (rowStart[0] != 0) return false;
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		if (rowStart[i] > rowStart[i+1]) return false;
+	}
+	if (rowStart[n] > arcs) return false;
+	for (uint32_t j = 0; j < arcs; ++j)
+	{
+		if (adjacency[j] >= n) return false;
+	}
+
+	if (!cells) return true;
+	uint32_t count = (uint32_t)header->cellCount;
+	std::vector<unsigned char> parented(count, 0);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const LayoutCell & c = cells[i];
+		if (c.firstChild >= 0)
+		{
+			uint32_t first = (uint32_t)c.firstChild;
+			if (count < 4 || first <= i || first > count - 4) return false;
+			for (uint32_t k = first; k < first + 4; ++k)
+			{
+				if (parented[k]) return false;
+				parented[k] = 1;
+			}
+		}
+		else if ((uint64_t)c.itemBegin + c.itemCount > n)
+		{
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		if (cellItems[i] >= n) return false;
+	}
+	return true;
+}
+
+void GraphFile::close()
+{
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	mapping = 0;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (data) munmap((void*)data, size);
+	if (fd >= 0) ::close(fd);
+	fd = -1;
+#endif
+	data = 0;
+	size = 0;
+	header = 0;
+	x = y = 0;
+	rowStart = adjacency = cellItems = 0;
+	cells = 0;
+}
+
+bool GraphFile::isOpen() const
+{
+	return header != 0;
+}
+
+std::vector<Node*> GraphFile::instantiate(Graph & graph) const
+{
+	std::vector<Node*> nodes;
+	if (!header) return nodes;
+
+	uint32_t n = (uint32_t)header->nodeCount;
+	nodes.resize(n, 0);
+
+	Transaction t(graph);
+
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		if (graph.getNodeIndex() && !graph.getNodeIndex()->accepts(x[i], y[i])) continue;
+		nodes[i] = Node::create(graph, x[i], y[i]);
+	}
+
+	// Each edge is stored in both directions; create it from its lower end.
+	// Rows and neighbors outside the stored blocks are skipped
+	uint32_t arcs = (uint32_t)header->edgeCount * 2;
+	std::vector<std::pair<Node*, Node*> > pairs;
+	pairs.reserve((size_t)header->edgeCount);
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		uint32_t end = std::min(rowStart[i+1], arcs);
+		for (uint32_t j = rowStart[i]; j < end; ++j)
+		{
+			uint32_t k = adjacency[j];
+			if (i < k && k < n && nodes[i] && nodes[k]) pairs.push_back(std::make_pair(nodes[i], nodes[k]));
+		}
+	}
+	Edge::createEdges(pairs);
+
+	t.commit();
+	return nodes;
+}
+
+int GraphFile::queryRegion(float x1, float y1, float x2, float y2, std::vector<uint32_t> & ret) const
+{
+	if (!header) return (int)ret.size();
+
+	float xmin = std::min(x1,x2), xmax = std::max(x1,x2);
+	float ymin = std::min(y1,y2), ymax = std::max(y1,y2);
+
+	if (!cells)
+	{
+		// Straight SoA scan, a block at a time
+		const uint32_t BLOCK = 1024;
+		uint32_t idx[BLOCK + 7];
+		for (uint32_t b = 0; b < header->nodeCount; b += BLOCK)
+		{
+			uint32_t n = (uint32_t)std::min<uint64_t>(BLOCK, header->nodeCount - b);
+			size_t k = filterRegion(x + b, y + b, n, xmin, ymin, xmax, ymax, idx);
+			for (size_t i = 0; i < k; ++i) ret.push_back(b + idx[i]);
+		}
+		return (int)ret.size();
+	}
+
+	// Links and leaves outside the stored blocks are skipped, and a tree
+	// visits each cell at most once, so a walk that runs longer than
+	// cellCount (a cyclic layout) stops there
+	uint32_t count = (uint32_t)header->cellCount;
+	uint32_t n = (uint32_t)header->nodeCount;
+	uint32_t visits = 0;
+	std::vector<uint32_t> stack(1, 0);
+	while (!stack.empty() && visits++ < count)
+	{
+		const LayoutCell & c = cells[stack.back()];
+		stack.pop_back();
+		if (c.cx-c.hw >= xmax || c.cy-c.hh >= ymax || c.cx+c.hw <= xmin || c.cy+c.hh <= ymin) continue;
+		if (c.firstChild >= 0)
+		{
+			if (count < 4 || (uint32_t)c.firstChild > count - 4) continue;
+			for (int i = 0; i < 4; ++i) stack.push_back(c.firstChild + i);
+		}
+		else if ((uint64_t)c.itemBegin + c.itemCount <= n)
+		{
+			for (uint32_t i = c.itemBegin; i < c.itemBegin + c.itemCount; ++i)
+			{
+				uint32_t k = cellItems[i];
+				if (k < n && x[k] >= xmin && x[k] < xmax && y[k] >= ymin && y[k] < ymax) ret.push_back(k);
+			}
+		}
+	}
+	return (int)ret.size();
+}
+
+bool GraphFile::write(const Graph & graph, const std::string & path, bool withQuadTree)
+{
+	// Compact live nodes into file indices
+	std::vector<uint32_t> index(graph.nodes.capacity(), 0);
+	std::vector<float> xs;
+	std::vector<float> ys;
+	std::vector<Node*> nodes;
+	for (Slab<Node>::iterator it = graph.nodes.begin(); it != graph.nodes.end(); ++it)
+	{
+		index[(*it)->id] = (uint32_t)nodes.size();
+		nodes.push_back(*it);
+		xs.push_back((*it)->x);
+		ys.push_back((*it)->y);
+	}
+
+	// CSR adjacency
+	std::vector<uint32_t> rowStart(nodes.size()+1, 0);
+	std::vector<uint32_t> adjacency;
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		rowStart[i] = (uint32_t)adjacency.size();
+		for (unsigned int j = 0; j < nodes[i]->degree(); ++j)
+			adjacency.push_back(index[nodes[i]->neighbor(j)->id]);
+	}
+	rowStart[nodes.size()] = (uint32_t)adjacency.size();
+
+	// Quadtree layout
+	std::vector<LayoutCell> cellv;
+	std::vector<uint32_t> itemv;
+	QuadTree<Node*> * qt = dynamic_cast<QuadTree<Node*>*>(graph.getNodeIndex());
+	if (withQuadTree && qt)
+		qt->exportLayout(cellv, itemv, FileIndex(index));
+
+	GraphFileHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, MAGIC, sizeof(MAGIC));
+	h.version = VERSION;
+	h.endian = 0x01020304;
+	h.flags = cellv.empty() ? 0 : HAS_QUADTREE;
+	h.nodeCount = nodes.size();
+	h.edgeCount = adjacency.size() / 2;
+	h.cellCount = cellv.size();
+	if (!cellv.empty())
+	{
+		h.bounds[0] = cellv[0].cx - cellv[0].hw;
+		h.bounds[1] = cellv[0].cy - cellv[0].hh;
+		h.bounds[2] = cellv[0].cx + cellv[0].hw;
+		h.bounds[3] = cellv[0].cy + cellv[0].hh;
+	}
+
+	// Offsets
+	uint64_t offset = sizeof(h);
+	h.xOffset = offset = align(offset);				offset += xs.size()*4;
+	h.yOffset = offset = align(offset);				offset += ys.size()*4;
+	h.rowStartOffset = offset = align(offset);		offset += rowStart.size()*4;
+	h.adjacencyOffset = offset = align(offset);		offset += adjacency.size()*4;
+	h.cellOffset = offset = align(offset);			offset += cellv.size()*sizeof(LayoutCell);
+	h.cellItemOffset = offset = align(offset);		offset += itemv.size()*4;
+
+	FILE * f = fopen(path.c_str(), "wb");
+	if (!f) return false;
+	offset = 0;
+	bool ok = writeBlock(f, offset, &h, sizeof(h))
+		&& writeBlock(f, offset, xs.empty() ? 0 : &xs[0], xs.size()*4)
+		&& writeBlock(f, offset, ys.empty() ? 0 : &ys[0], ys.size()*4)
+		&& writeBlock(f, offset, &rowStart[0], rowStart.size()*4)
+		&& writeBlock(f, offset, adjacency.empty() ? 0 : &adjacency[0], adjacency.size()*4)
+		&& writeBlock(f, offset, cellv.empty() ? 0 : &cellv[0], cellv.size()*sizeof(LayoutCell))
+		&& writeBlock(f, offset, itemv.empty() ? 0 : &itemv[0], itemv.size()*4);
+	return fclose(f) == 0 && ok;
+}
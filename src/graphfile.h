@@ -0,0 +1,136 @@
+#pragma once
+
+/*///=====================================================================
+
+	graphfile.h
+
+	Compact binary graph format, loaded by memory-mapping the file.
+
+	Layout (little-endian, every block 64-byte aligned):
+
+		GraphFileHeader
+		float    x[nodeCount]                node coordinates (SoA)
+		float    y[nodeCount]
+		uint32_t rowStart[nodeCount+1]       CSR offsets into adjacency
+		uint32_t adjacency[2*edgeCount]      both directions of every edge
+		LayoutCell cells[cellCount]          optional node quadtree layout
+		uint32_t cellItems[nodeCount]        node indices of the leaves
+
+	Opening a file maps it and points straight into it; nothing is parsed,
+	allocated or read per element, so only the header and the block bounds
+	are checked. The stored indices are checked where they are followed
+	(instantiate, queryRegion), or all up front if open is asked to.
+	instantiate() builds live Node/Edge objects from an open file when the
+	graph is to be edited.
+
+*///======================================================================
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "node.h"
+#include "quadtree.h"
+
+class Graph;
+
+struct GraphFileHeader
+{
+	char magic[8];			// "GRAPHBIN"
+	uint32_t version;
+	uint32_t endian;		// 0x01020304 as written
+	uint32_t flags;
+	uint32_t reserved;
+	uint64_t nodeCount;
+	uint64_t edgeCount;
+	uint64_t cellCount;
+	uint64_t xOffset;		// byte offsets from the start of the file
+	uint64_t yOffset;
+	uint64_t rowStartOffset;
+	uint64_t adjacencyOffset;
+	uint64_t cellOffset;
+	uint64_t cellItemOffset;
+	float bounds[4];		// x1, y1, x2, y2 of the quadtree root
+};
+
+class GraphFile
+{
+public:
+
+	typedef QuadTree<Node*>::LayoutCell LayoutCell;
+
+	static const uint32_t VERSION = 1;
+	static const uint32_t HAS_QUADTREE = 1;
+
+	GraphFile();
+
+	~GraphFile();
+
+	//
+	// open
+	//
+	// Maps the file read-only and validates the header and the block
+	// bounds in O(1). With validateAll, every index stored in the blocks
+	// is checked too, which reads the whole file. Returns false, with
+	// nothing open, for a missing, truncated or malformed file.
+	//
+	bool open(const std::string & path, bool validateAll = false);
+
+	void close();
+
+	bool isOpen() const;
+
+	//
+	// instantiate
+	//
+	// Creates a Node for every node in the file (skipping any outside the
+	// node quadtree) and an Edge for every edge, inside one Transaction.
+	// Returns the created nodes, indexed like the file.
+	//
+	std::vector<Node*> instantiate(Graph & graph) const;
+
+	//
+	// queryRegion
+	//
+	// Pushes the file indices of nodes inside the region, walking the stored
+	// quadtree layout (or scanning, if the file has none).
+	//
+	int queryRegion(float x1, float y1, float x2, float y2, std::vector<uint32_t> & ret) const;
+
+	//
+	// write
+	//
+	// Saves every live node and edge of graph, and the node quadtree layout
+	// if withQuadTree is set and the graph's node index is a QuadTree.
+	//
+	static bool write(const Graph & graph, const std::string & path, bool withQuadTree = true);
+
+	uint64_t nodeCount() const { return header ? header->nodeCount : 0; }
+	uint64_t edgeCount() const { return header ? header->edgeCount : 0; }
+	// Unchecked unless opened with validateAll
+	uint32_t degree(uint32_t i) const { return rowStart[i+1] - rowStart[i]; }
+
+	const GraphFileHeader * header;
+	const float * x;
+	const float * y;
+	const uint32_t * rowStart;
+	const uint32_t * adjacency;
+	const LayoutCell * cells;
+	const uint32_t * cellItems;
+
+private:
+
+	GraphFile(const GraphFile &);
+	GraphFile & operator=(const GraphFile &);
+
+	bool validate() const;
+
+	const char * data;
+	size_t size;
+#ifdef _WIN32
+	void * file;
+	void * mapping;
+#else
+	int fd;
+#endif
+};
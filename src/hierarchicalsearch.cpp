@@ -0,0 +1,535 @@
+#include "hierarchicalsearch.h"
+#include "edge.h"
+#include "graph.h"
+#include "node.h"
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <float.h>
+#include <functional>
+#include <math.h>
+
+namespace
+{
+	struct NodeId
+	{
+		unsigned int operator()(Node * n) const { return n->id; }
+	};
+
+	float length(const Node * a, const Node * b)
+	{
+		float dx = b->x - a->x;
+		float dy = b->y - a->y;
+		return sqrtf(dx*dx + dy*dy);
+	}
+}
+
+const float HierarchicalSearch::UNREACHABLE = -1;
+const uint32_t HierarchicalSearch::NONE;
+
+//
+// Updates a share of the dirty clusters, each with this thread's labels
+//
+struct HierarchicalSearch::Refresher
+{
+	Refresher(HierarchicalSearch & hs, std::atomic<size_t> & next) : hs(hs), next(next) {}
+
+	void operator()(unsigned int t) const
+	{
+		for (;;)
+		{
+			size_t i = next.fetch_add(1);
+			if (i >= hs.dirty.size()) break;
+			hs.refresh(hs.dirty[i], hs.scratch[t]);
+		}
+	}
+
+	HierarchicalSearch & hs;
+	std::atomic<size_t> & next;
+};
+
+void HierarchicalSearch::Labels::reset(size_t n)
+{
+	if (stamp.size() != n)
+	{
+		dist.assign(n, 0);
+		parent.assign(n, NONE);
+		stamp.assign(n, 0);
+		round = 0;
+	}
+	if (++round == 0)
+	{
+		// Stamps wrapped; clear them once
+		std::fill(stamp.begin(), stamp.end(), 0);
+		round = 1;
+	}
+	heap.clear();
+	settled = 0;
+}
+
+void HierarchicalSearch::Labels::reach(uint32_t v, float d, uint32_t p)
+{
+	stamp[v] = round;
+	dist[v] = d;
+	parent[v] = p;
+}
+
+HierarchicalSearch::HierarchicalSearch(const Graph & graph, unsigned int clusterSize)
+	: graph(graph), clusterSize(clusterSize ? clusterSize : 1), goalX(0), goalY(0), settled(0), stale(false)
+{
+}
+
+void HierarchicalSearch::rebuild()
+{
+	PROFILE_SCOPE("HierarchicalSearch::rebuild");
+	clear();
+
+	// The node quadtree's layout, or that of one built over the nodes
+	std::vector<unsigned int> items;
+	QuadTree<Node*> * qt = dynamic_cast<QuadTree<Node*>*>(graph.getNodeIndex());
+	if (qt)
+	{
+		qt->exportLayout(cells, items, NodeId());
+	}
+	else
+	{
+		float xmin = FLT_MAX, ymin = FLT_MAX, xmax = -FLT_MAX, ymax = -FLT_MAX;
+		std::vector<Node*> v;
+		std::vector<float> xs;
+		std::vector<float> ys;
+		for (Slab<Node>::iterator it = graph.nodes.begin(); it != graph.nodes.end(); ++it)
+		{
+			xmin = std::min(xmin, (*it)->x);
+			ymin = std::min(ymin, (*it)->y);
+			xmax = std::max(xmax, (*it)->x);
+			ymax = std::max(ymax, (*it)->y);
+			v.push_back(*it);
+			xs.push_back((*it)->x);
+			ys.push_back((*it)->y);
+		}
+		if (v.empty()) xmin = ymin = xmax = ymax = 0;
+		QuadTree<Node*> tree(xmin - 1, ymin - 1, xmax + 1, ymax + 1, 8, 16);
+		tree.insert(v, xs, ys);
+		tree.exportLayout(cells, items, NodeId());
+	}
+
+	// Nodes per cell, bottom up (children come after their parents)
+	std::vector<uint32_t> count(cells.size(), 0);
+	for (size_t i = cells.size(); i-- > 0;)
+	{
+		if (cells[i].firstChild < 0) count[i] = cells[i].itemCount;
+		else for (int k = 0; k < 4; ++k) count[i] += count[cells[i].firstChild + k];
+	}
+
+	// Clusters are the topmost cells within clusterSize, and deeper leaves
+	std::vector<uint32_t> owner(cells.size(), NONE);
+	cellCluster.assign(cells.size(), NONE);
+	for (size_t i = 0; i < cells.size(); ++i)
+	{
+		if (owner[i] == NONE && (count[i] <= clusterSize || cells[i].firstChild < 0))
+		{
+			owner[i] = cellCluster[i] = (uint32_t)clusters.size();
+			clusters.push_back(Cluster());
+			clusters.back().limit = std::max<size_t>(4 * (size_t)clusterSize, 2 * (size_t)count[i]);
+		}
+		if (cells[i].firstChild >= 0)
+		{
+			for (int k = 0; k < 4; ++k) owner[cells[i].firstChild + k] = owner[i];
+		}
+	}
+
+	unsigned int cap = graph.nodes.capacity();
+	clusterOf.assign(cap, NONE);
+	handles.assign(cap, 0);
+	borderIndex.assign(cap, NONE);
+	for (size_t i = 0; i < cells.size(); ++i)
+	{
+		if (cells[i].firstChild >= 0) continue;
+		Cluster & cl = clusters[owner[i]];
+		for (unsigned int k = cells[i].itemBegin; k < cells[i].itemBegin + cells[i].itemCount; ++k)
+		{
+			uint32_t id = items[k];
+			clusterOf[id] = owner[i];
+			handles[id] = graph.nodes.at(id)->handle();
+			cl.members.push_back(id);
+		}
+	}
+
+	for (uint32_t c = 0; c < clusters.size(); ++c)
+		mark(c);
+	update();
+}
+
+void HierarchicalSearch::clear()
+{
+	cells.clear();
+	cellCluster.clear();
+	clusters.clear();
+	clusterOf.clear();
+	handles.clear();
+	borderIndex.clear();
+	dirty.clear();
+	stale = false;
+}
+
+void HierarchicalSearch::touch(const std::vector<Node*> & nodes)
+{
+	for (size_t i = 0; i < nodes.size(); ++i)
+		touch(nodes[i]);
+}
+
+void HierarchicalSearch::touch(Node * n)
+{
+	if (clusters.empty()) return;
+	assign(n);
+	mark(clusterOf[n->id]);
+	for (Node::EdgeList::iterator it = n->edges.begin(); it != n->edges.end(); ++it)
+	{
+		Node * o = (*it)->other(n);
+		if (assigned(o)) mark(clusterOf[o->id]);
+		else assign(o);
+	}
+}
+
+void HierarchicalSearch::update()
+{
+	if (stale)
+	{
+		rebuild();
+		return;
+	}
+	if (dirty.empty()) return;
+	PROFILE_SCOPE("HierarchicalSearch::update");
+
+	// Drop members that left or were destroyed, and take in new neighbors
+	// (which may dirty more clusters)
+	for (size_t i = 0; i < dirty.size(); ++i)
+	{
+		uint32_t c = dirty[i];
+		std::vector<uint32_t> & members = clusters[c].members;
+		std::sort(members.begin(), members.end());
+		members.erase(std::unique(members.begin(), members.end()), members.end());
+		size_t kept = 0;
+		for (size_t k = 0; k < members.size(); ++k)
+		{
+			uint32_t id = members[k];
+			if (clusterOf[id] != c) continue;
+			Node * n = graph.nodes.isLive(id) ? graph.nodes.at(id) : 0;
+			if (!n || n->handle() != handles[id])
+			{
+				clusterOf[id] = NONE;
+				borderIndex[id] = NONE;
+				continue;
+			}
+			members[kept++] = id;
+			for (Node::EdgeList::iterator it = n->edges.begin(); it != n->edges.end(); ++it)
+			{
+				Node * o = (*it)->other(n);
+				if (!assigned(o)) assign(o);
+			}
+		}
+		members.resize(kept);
+		if (members.size() > clusters[c].limit) stale = true;
+	}
+	if (stale)
+	{
+		rebuild();
+		return;
+	}
+
+	// Borders and distances, in parallel over clusters
+	unsigned int threads = (unsigned int)std::min<size_t>(hardwareThreads(), dirty.size());
+	if (scratch.size() < threads) scratch.resize(threads);
+	std::atomic<size_t> next(0);
+	parallelRun(threads, Refresher(*this, next));
+
+	for (size_t i = 0; i < dirty.size(); ++i)
+		clusters[dirty[i]].dirty = false;
+	dirty.clear();
+}
+
+float HierarchicalSearch::findPath(Node * s, Node * t, std::vector<Node*> & path)
+{
+	PROFILE_SCOPE("HierarchicalSearch::findPath");
+	path.clear();
+	settled = 0;
+	if (clusters.empty()) rebuild();
+	if (!assigned(s) || !assigned(t))
+	{
+		touch(s);
+		touch(t);
+	}
+	update();
+	if (s == t)
+	{
+		path.push_back(s);
+		return 0;
+	}
+
+	uint32_t si = s->id, ti = t->id;
+	const Cluster & cs = clusters[clusterOf[si]];
+	const Cluster & ct = clusters[clusterOf[ti]];
+	goalX = t->x;
+	goalY = t->y;
+
+	// Inside the start and goal clusters
+	searchCluster(si, NONE, local);
+	settled += local.settled;
+	std::vector<float> fromS(cs.border.size(), UNREACHABLE);
+	for (size_t k = 0; k < cs.border.size(); ++k)
+	{
+		if (local.reached(cs.border[k])) fromS[k] = local.dist[cs.border[k]];
+	}
+	float direct = clusterOf[si] == clusterOf[ti] && local.reached(ti) ? local.dist[ti] : UNREACHABLE;
+
+	searchCluster(ti, NONE, local);
+	settled += local.settled;
+	std::vector<float> toT(ct.border.size(), UNREACHABLE);
+	for (size_t k = 0; k < ct.border.size(); ++k)
+	{
+		if (local.reached(ct.border[k])) toT[k] = local.dist[ct.border[k]];
+	}
+
+	// A* over the border nodes
+	std::greater<Entry> cmp;
+	top.reset(graph.nodes.capacity());
+	top.reach(si, 0, NONE);
+	top.heap.push_back(Entry(length(s, t), si));
+	while (!top.heap.empty())
+	{
+		std::pop_heap(top.heap.begin(), top.heap.end(), cmp);
+		Entry e = top.heap.back();
+		top.heap.pop_back();
+		uint32_t v = e.second;
+		const Node * n = graph.nodes.at(v);
+		if (e.first > top.dist[v] + length(n, t)) continue;
+		++top.settled;
+		if (v == ti) break;
+		expand(v, si, ti, fromS, direct, toT);
+	}
+	settled += top.settled;
+	if (!top.reached(ti)) return UNREACHABLE;
+
+	std::vector<uint32_t> corridor;
+	for (uint32_t v = ti; v != NONE; v = top.parent[v])
+		corridor.push_back(v);
+	std::reverse(corridor.begin(), corridor.end());
+
+	// Refine the steps inside clusters; steps between them are edges
+	path.push_back(s);
+	std::vector<uint32_t> step;
+	for (size_t i = 1; i < corridor.size(); ++i)
+	{
+		uint32_t u = corridor[i-1], v = corridor[i];
+		if (clusterOf[u] != clusterOf[v])
+		{
+			path.push_back(graph.nodes.at(v));
+			continue;
+		}
+		searchCluster(u, v, local);
+		settled += local.settled;
+		step.clear();
+		for (uint32_t w = v; w != u; w = local.parent[w])
+			step.push_back(w);
+		for (size_t k = step.size(); k-- > 0;)
+			path.push_back(graph.nodes.at(step[k]));
+	}
+	return top.dist[ti];
+}
+
+uint32_t HierarchicalSearch::getSettled() const
+{
+	return settled;
+}
+
+size_t HierarchicalSearch::numClusters() const
+{
+	return clusters.size();
+}
+
+size_t HierarchicalSearch::numBorderNodes() const
+{
+	size_t n = 0;
+	for (size_t c = 0; c < clusters.size(); ++c)
+		n += clusters[c].border.size();
+	return n;
+}
+
+//
+// The cluster whose cell covers (x, y); points outside the tree go to the
+// nearest cell down each level
+//
+uint32_t HierarchicalSearch::locate(float x, float y) const
+{
+	size_t i = 0;
+	while (cellCluster[i] == NONE)
+	{
+		const Cell & c = cells[i];
+		i = c.firstChild + (x < c.cx ? 2 : 0) + (y < c.cy ? 1 : 0);
+	}
+	return cellCluster[i];
+}
+
+bool HierarchicalSearch::assigned(const Node * n) const
+{
+	return n->id < clusterOf.size() && clusterOf[n->id] != NONE && handles[n->id] == n->handle();
+}
+
+//
+// Puts a node in the cluster covering its position, marking the clusters
+// it leaves and joins
+//
+void HierarchicalSearch::assign(Node * n)
+{
+	unsigned int cap = graph.nodes.capacity();
+	if (clusterOf.size() < cap)
+	{
+		clusterOf.resize(cap, NONE);
+		handles.resize(cap, 0);
+		borderIndex.resize(cap, NONE);
+	}
+
+	uint32_t old = assigned(n) ? clusterOf[n->id] : NONE;
+	uint32_t c = locate(n->x, n->y);
+	if (old == c) return;
+	if (old != NONE) mark(old);
+	clusterOf[n->id] = c;
+	handles[n->id] = n->handle();
+	borderIndex[n->id] = NONE;
+	clusters[c].members.push_back(n->id);
+	mark(c);
+}
+
+void HierarchicalSearch::mark(uint32_t c)
+{
+	if (clusters[c].dirty) return;
+	clusters[c].dirty = true;
+	dirty.push_back(c);
+}
+
+//
+// Recomputes a cluster's border nodes and the distances between them.
+// Writes only the cluster and its own nodes' border indices, so clusters
+// can be refreshed side by side.
+//
+void HierarchicalSearch::refresh(uint32_t c, Labels & labels)
+{
+	Cluster & cl = clusters[c];
+	for (size_t k = 0; k < cl.border.size(); ++k)
+	{
+		if (clusterOf[cl.border[k]] == c) borderIndex[cl.border[k]] = NONE;
+	}
+
+	cl.border.clear();
+	for (size_t k = 0; k < cl.members.size(); ++k)
+	{
+		const Node * n = graph.nodes.at(cl.members[k]);
+		for (Node::EdgeList::const_iterator it = n->edges.begin(); it != n->edges.end(); ++it)
+		{
+			if (clusterOf[(*it)->other(n)->id] == c) continue;
+			borderIndex[n->id] = (uint32_t)cl.border.size();
+			cl.border.push_back(n->id);
+			break;
+		}
+	}
+
+	size_t b = cl.border.size();
+	cl.dist.assign(b * b, UNREACHABLE);
+	for (size_t i = 0; i < b; ++i)
+	{
+		searchCluster(cl.border[i], NONE, labels);
+		for (size_t j = 0; j < b; ++j)
+		{
+			if (labels.reached(cl.border[j])) cl.dist[i * b + j] = labels.dist[cl.border[j]];
+		}
+	}
+}
+
+//
+// Dijkstra from s over the nodes of its cluster only, or A* when a target
+// t is given (stopping once it is settled)
+//
+void HierarchicalSearch::searchCluster(uint32_t s, uint32_t t, Labels & labels) const
+{
+	uint32_t c = clusterOf[s];
+	const Node * target = t != NONE ? graph.nodes.at(t) : 0;
+	std::greater<Entry> cmp;
+	labels.reset(graph.nodes.capacity());
+	labels.reach(s, 0, NONE);
+	labels.heap.push_back(Entry(0, s));
+	while (!labels.heap.empty())
+	{
+		std::pop_heap(labels.heap.begin(), labels.heap.end(), cmp);
+		Entry e = labels.heap.back();
+		labels.heap.pop_back();
+		uint32_t v = e.second;
+		const Node * n = graph.nodes.at(v);
+		float h = target ? length(n, target) : 0;
+		if (e.first > labels.dist[v] + h) continue;
+		++labels.settled;
+		if (v == t) return;
+
+		for (Node::EdgeList::const_iterator it = n->edges.begin(); it != n->edges.end(); ++it)
+		{
+			const Node * o = (*it)->other(n);
+			if (clusterOf[o->id] != c) continue;
+			float d = labels.dist[v] + length(n, o);
+			if (labels.reached(o->id) && d >= labels.dist[o->id]) continue;
+			labels.reach(o->id, d, v);
+			labels.heap.push_back(Entry(d + (target ? length(o, target) : 0), o->id));
+			std::push_heap(labels.heap.begin(), labels.heap.end(), cmp);
+		}
+	}
+}
+
+//
+// Abstract arcs out of v: from s to its cluster's border nodes (and
+// straight to t when they share it), between border nodes of a cluster,
+// along edges leaving the cluster, and from the goal cluster's border
+// nodes to t
+//
+void HierarchicalSearch::expand(uint32_t v, uint32_t s, uint32_t t, const std::vector<float> & fromS, float direct, const std::vector<float> & toT)
+{
+	uint32_t c = clusterOf[v];
+	const Cluster & cl = clusters[c];
+	uint32_t b = borderIndex[v];
+	float d = top.dist[v];
+
+	if (v == s)
+	{
+		for (size_t k = 0; k < cl.border.size(); ++k)
+		{
+			if (fromS[k] >= 0) relax(cl.border[k], d + fromS[k], v);
+		}
+		if (direct >= 0) relax(t, d + direct, v);
+	}
+	else if (b != NONE)
+	{
+		const float * row = &cl.dist[b * cl.border.size()];
+		for (size_t k = 0; k < cl.border.size(); ++k)
+		{
+			if (row[k] >= 0) relax(cl.border[k], d + row[k], v);
+		}
+		if (c == clusterOf[t] && toT[b] >= 0) relax(t, d + toT[b], v);
+	}
+
+	if (b == NONE) return;
+	const Node * n = graph.nodes.at(v);
+	for (Node::EdgeList::const_iterator it = n->edges.begin(); it != n->edges.end(); ++it)
+	{
+		const Node * o = (*it)->other(n);
+		if (clusterOf[o->id] != c) relax(o->id, d + length(n, o), v);
+	}
+}
+
+void HierarchicalSearch::relax(uint32_t w, float d, uint32_t p)
+{
+	if (top.reached(w) && d >= top.dist[w]) return;
+	top.reach(w, d, p);
+	const Node * n = graph.nodes.at(w);
+	float dx = goalX - n->x, dy = goalY - n->y;
+	top.heap.push_back(Entry(d + sqrtf(dx*dx + dy*dy), w));
+	std::push_heap(top.heap.begin(), top.heap.end(), std::greater<Entry>());
+}
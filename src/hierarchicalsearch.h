@@ -0,0 +1,172 @@
+#pragma once
+
+/*///=====================================================================
+
+	hierarchicalsearch.h
+
+	Shortest paths on the live Node/Edge graph, searched on two levels
+	(HPA*-style).
+
+	Clusters are the largest cells of the node QuadTree that hold at most
+	clusterSize nodes. A cluster's border nodes are those with an edge to
+	another cluster, and for each cluster the shortest distances between
+	its border nodes, staying inside it, are precomputed. The abstract
+	graph is the border nodes, joined by those distances within clusters
+	and by the real edges between clusters, so its distances are exact.
+
+	A query searches inside the start and goal clusters, runs A* on the
+	abstract graph, then refines only the clusters along the chosen
+	corridor back into real nodes. Settled nodes scale with the number of
+	clusters crossed and their border sizes rather than the area A* would
+	sweep on the full graph.
+
+	Clusters are updated lazily: touch marks the clusters of changed
+	nodes and of their neighbors, and the next query (or update)
+	recomputes only those, in parallel. Cluster bounds are fixed at
+	rebuild; nodes that move are reassigned to the cluster covering their
+	new position, and a cluster grown past four times clusterSize (or
+	twice its size at rebuild) brings on a rebuild.
+
+*///======================================================================
+
+#include <stdint.h>
+#include <vector>
+
+#include "quadtree.h"
+
+class Graph;
+class Node;
+
+class HierarchicalSearch
+{
+public:
+
+	static const float UNREACHABLE;
+
+	//
+	// HierarchicalSearch
+	//
+	// Searches the given graph; empty until rebuild.
+	//
+	explicit HierarchicalSearch(const Graph & graph, unsigned int clusterSize = 256);
+
+	//
+	// rebuild
+	//
+	// Partitions the nodes into clusters along the node quadtree (or a
+	// quadtree built over them, when nodes are indexed otherwise) and
+	// computes every cluster.
+	//
+	void rebuild();
+
+	//
+	// clear
+	//
+	// Forgets all clusters.
+	//
+	void clear();
+
+	//
+	// touch
+	//
+	// Marks for update the clusters of the given nodes and of their
+	// neighbors. Call after moving or creating nodes and after creating or
+	// destroying edges (with their end nodes), and before destroying
+	// nodes.
+	//
+	void touch(const std::vector<Node*> & nodes);
+	void touch(Node * n);
+
+	//
+	// update
+	//
+	// Recomputes the touched clusters. Queries update first.
+	//
+	void update();
+
+	//
+	// findPath
+	//
+	// Shortest path from s to t by edge length: fills path with its nodes,
+	// from s to t, and returns its length, or UNREACHABLE (path empty).
+	//
+	float findPath(Node * s, Node * t, std::vector<Node*> & path);
+
+	//
+	// getSettled
+	//
+	// Nodes settled by the last query, on both levels.
+	//
+	uint32_t getSettled() const;
+
+	size_t numClusters() const;
+
+	size_t numBorderNodes() const;
+
+private:
+
+	HierarchicalSearch(const HierarchicalSearch &);
+	HierarchicalSearch & operator=(const HierarchicalSearch &);
+
+	static const uint32_t NONE = 0xFFFFFFFF;
+
+	typedef QuadTree<Node*>::LayoutCell Cell;
+	typedef std::pair<float, uint32_t> Entry;
+
+	struct Cluster
+	{
+		Cluster() : limit(0), dirty(false) {}
+		std::vector<uint32_t> members; // node ids; may hold stale ones until updated
+		std::vector<uint32_t> border; // node ids
+		std::vector<float> dist; // border x border, row major; UNREACHABLE if not connected inside
+		size_t limit; // members past which to rebuild
+		bool dirty;
+	};
+
+	//
+	// Labels
+	//
+	// Per-node search state, invalidated per search by bumping round.
+	//
+	struct Labels
+	{
+		Labels() : round(0), settled(0) {}
+		void reset(size_t n);
+		bool reached(uint32_t v) const { return stamp[v] == round; }
+		void reach(uint32_t v, float d, uint32_t p);
+		std::vector<float> dist;
+		std::vector<uint32_t> parent;
+		std::vector<uint32_t> stamp;
+		std::vector<Entry> heap;
+		uint32_t round;
+		uint32_t settled;
+	};
+
+	struct Refresher;
+
+	uint32_t locate(float x, float y) const;
+	bool assigned(const Node * n) const;
+	void assign(Node * n);
+	void mark(uint32_t c);
+	void refresh(uint32_t c, Labels & labels);
+	void searchCluster(uint32_t s, uint32_t t, Labels & labels) const;
+	void expand(uint32_t v, uint32_t s, uint32_t t, const std::vector<float> & fromS, float direct, const std::vector<float> & toT);
+	void relax(uint32_t w, float d, uint32_t p);
+
+	const Graph & graph;
+	unsigned int clusterSize;
+	std::vector<Cell> cells;
+	std::vector<uint32_t> cellCluster; // by cell, NONE above the clusters
+	std::vector<Cluster> clusters;
+	std::vector<uint32_t> clusterOf; // by Node::id
+	std::vector<uint64_t> handles; // by Node::id, the node each entry was assigned for
+	std::vector<uint32_t> borderIndex; // by Node::id, NONE if not a border node
+	std::vector<uint32_t> dirty;
+	std::vector<Labels> scratch; // per updating thread
+	Labels top; // abstract search
+	Labels local; // searches inside a cluster
+	float goalX;
+	float goalY;
+	uint32_t settled;
+	bool stale;
+};
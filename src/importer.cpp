@@ -0,0 +1,487 @@
+#include "importer.h"
+#include "node.h"
+#include "edge.h"
+#include "graph.h"
+#include "parallel.h"
+#include "transaction.h"
+
+#include <algorithm>
+#include <float.h>
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+	//
+	// Number parsing
+	//
+
+	inline const char * skipBlanks(const char * p, const char * e)
+	{
+		while (p < e && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+		return p;
+	}
+
+	inline bool parseUInt(const char *& p, const char * e, uint64_t & v)
+	{
+		p = skipBlanks(p, e);
+		if (p == e || *p < '0' || *p > '9') return false;
+		v = 0;
+		while (p < e && *p >= '0' && *p <= '9') v = v*10 + (uint64_t)(*p++ - '0');
+		return true;
+	}
+
+	inline bool parseReal(const char *& p, const char * e, double & v)
+	{
+		p = skipBlanks(p, e);
+		bool negative = false;
+		if (p < e && (*p == '-' || *p == '+')) negative = *p++ == '-';
+		if (p == e || ((*p < '0' || *p > '9') && *p != '.')) return false;
+
+		double r = 0;
+		while (p < e && *p >= '0' && *p <= '9') r = r*10 + (*p++ - '0');
+		if (p < e && *p == '.')
+		{
+			++p;
+			double scale = 0.1;
+			while (p < e && *p >= '0' && *p <= '9')
+			{
+				r += (*p++ - '0') * scale;
+				scale *= 0.1;
+			}
+		}
+		if (p < e && (*p == 'e' || *p == 'E'))
+		{
+			++p;
+			bool negativeExp = false;
+			if (p < e && (*p == '-' || *p == '+')) negativeExp = *p++ == '-';
+			uint64_t x;
+			if (!parseUInt(p, e, x)) return false;
+			double m = 1;
+			for (uint64_t i = 0; i < x && i < 400; ++i) m *= 10;
+			r = negativeExp ? r/m : r*m;
+		}
+		v = negative ? -r : r;
+		return true;
+	}
+
+	//
+	// Splits [b, e) into up to n ranges that start and end on line boundaries
+	//
+	std::vector<const char*> splitLines(const char * b, const char * e, unsigned int n)
+	{
+		std::vector<const char*> cuts(1, b);
+		for (unsigned int i = 1; i < n; ++i)
+		{
+			const char * p = b + (e-b) * i / n;
+			if (p < cuts.back()) p = cuts.back();
+			const char * nl = (const char*)memchr(p, '\n', e-p);
+			p = nl ? nl+1 : e;
+			if (p > cuts.back() && p < e) cuts.push_back(p);
+		}
+		cuts.push_back(e);
+		return cuts;
+	}
+
+	inline const char * lineEnd(const char * p, const char * e)
+	{
+		const char * nl = (const char*)memchr(p, '\n', e-p);
+		return nl ? nl : e;
+	}
+
+	struct Coord
+	{
+		uint64_t id;
+		double x;
+		double y;
+	};
+
+	struct Arc
+	{
+		uint32_t u;
+		uint32_t v;
+	};
+}
+
+//
+// Chunk consumers
+//
+
+struct DimacsImporter::Chunk
+{
+	Chunk(unsigned int threads) : threads(threads), skipped(0) {}
+	virtual ~Chunk() {}
+	virtual void consume(const char * b, const char * e) = 0;
+	unsigned int threads;
+	uint64_t skipped;
+};
+
+namespace
+{
+	struct CoordParser
+	{
+		CoordParser(const std::vector<const char*> & cuts, std::vector<std::vector<Coord> > & out, std::vector<uint64_t> & skipped, std::vector<uint64_t> & declared)
+			: cuts(cuts), out(out), skipped(skipped), declared(declared) {}
+
+		void operator()(unsigned int t) const
+		{
+			std::vector<Coord> & v = out[t];
+			v.clear();
+			const char * p = cuts[t];
+			const char * e = cuts[t+1];
+			while (p < e)
+			{
+				const char * eol = lineEnd(p, e);
+				const char * q = skipBlanks(p, eol);
+				if (q < eol && *q == 'v')
+				{
+					++q;
+					Coord c;
+					if (parseUInt(q, eol, c.id) && parseReal(q, eol, c.x) && parseReal(q, eol, c.y) && c.id > 0)
+						v.push_back(c);
+					else
+						++skipped[t];
+				}
+				else if (q < eol && *q == 'p')
+				{
+					// "p aux sp co n": the node count is the first number
+					while (q < eol && (*q < '0' || *q > '9')) ++q;
+					uint64_t n;
+					if (parseUInt(q, eol, n)) declared[t] = n;
+				}
+				else if (q < eol && *q != 'c')
+				{
+					++skipped[t];
+				}
+				p = eol+1;
+			}
+		}
+
+		const std::vector<const char*> & cuts;
+		std::vector<std::vector<Coord> > & out;
+		std::vector<uint64_t> & skipped;
+		std::vector<uint64_t> & declared;
+	};
+
+	struct ArcParser
+	{
+		ArcParser(const std::vector<const char*> & cuts, std::vector<std::vector<Arc> > & out, std::vector<uint64_t> & skipped)
+			: cuts(cuts), out(out), skipped(skipped) {}
+
+		void operator()(unsigned int t) const
+		{
+			std::vector<Arc> & v = out[t];
+			v.clear();
+			const char * p = cuts[t];
+			const char * e = cuts[t+1];
+			while (p < e)
+			{
+				const char * eol = lineEnd(p, e);
+				const char * q = skipBlanks(p, eol);
+				if (q < eol && *q == 'a')
+				{
+					++q;
+					uint64_t u, w;
+					if (parseUInt(q, eol, u) && parseUInt(q, eol, w) && u > 0 && w > 0 && u <= 0xFFFFFFFFu && w <= 0xFFFFFFFFu)
+					{
+						Arc a;
+						a.u = (uint32_t)(u-1);
+						a.v = (uint32_t)(w-1);
+						v.push_back(a);
+					}
+					else
+					{
+						++skipped[t];
+					}
+				}
+				else if (q < eol && *q != 'c' && *q != 'p')
+				{
+					++skipped[t];
+				}
+				p = eol+1;
+			}
+		}
+
+		const std::vector<const char*> & cuts;
+		std::vector<std::vector<Arc> > & out;
+		std::vector<uint64_t> & skipped;
+	};
+}
+
+struct DimacsImporter::CoordChunk : DimacsImporter::Chunk
+{
+	CoordChunk(unsigned int threads) : Chunk(threads), out(threads), skippedPer(threads, 0), declaredPer(threads, 0), limit(MAX_NODES) {}
+
+	void consume(const char * b, const char * e)
+	{
+		std::vector<const char*> cuts = splitLines(b, e, threads);
+		unsigned int n = (unsigned int)cuts.size() - 1;
+		parallelRun(n, CoordParser(cuts, out, skippedPer, declaredPer));
+
+		// A problem line bounds the ids that follow it
+		for (unsigned int t = 0; t < n; ++t)
+		{
+			if (declaredPer[t]) limit = std::min(declaredPer[t], (uint64_t)MAX_NODES);
+			declaredPer[t] = 0;
+		}
+
+		for (unsigned int t = 0; t < n; ++t)
+		{
+			for (size_t i = 0; i < out[t].size(); ++i)
+			{
+				const Coord & c = out[t][i];
+				if (c.id > limit)
+				{
+					++skipped;
+					continue;
+				}
+				size_t k = (size_t)(c.id-1);
+				if (k >= x.size())
+				{
+					x.resize(k+1, 0);
+					y.resize(k+1, 0);
+					has.resize(k+1, 0);
+				}
+				x[k] = c.x;
+				y[k] = c.y;
+				has[k] = 1;
+			}
+			skipped += skippedPer[t];
+			skippedPer[t] = 0;
+		}
+	}
+
+	std::vector<std::vector<Coord> > out;
+	std::vector<uint64_t> skippedPer;
+	std::vector<uint64_t> declaredPer;
+	uint64_t limit;
+	std::vector<double> x;
+	std::vector<double> y;
+	std::vector<unsigned char> has;
+};
+
+struct DimacsImporter::ArcChunk : DimacsImporter::Chunk
+{
+	ArcChunk(unsigned int threads, const std::vector<Node*> & nodes) : Chunk(threads), out(threads), skippedPer(threads, 0), nodes(nodes) {}
+
+	void consume(const char * b, const char * e)
+	{
+		std::vector<const char*> cuts = splitLines(b, e, threads);
+		unsigned int n = (unsigned int)cuts.size() - 1;
+		parallelRun(n, ArcParser(cuts, out, skippedPer));
+
+		pairs.clear();
+		for (unsigned int t = 0; t < n; ++t)
+		{
+			for (size_t i = 0; i < out[t].size(); ++i)
+			{
+				const Arc & a = out[t][i];
+				if (a.u < nodes.size() && a.v < nodes.size() && nodes[a.u] && nodes[a.v])
+					pairs.push_back(std::make_pair(nodes[a.u], nodes[a.v]));
+				else
+					++skipped;
+			}
+			skipped += skippedPer[t];
+			skippedPer[t] = 0;
+		}
+
+		// One bulk pass per chunk; reverse arcs are rejected by the edge map
+		Edge::createEdges(pairs);
+	}
+
+	std::vector<std::vector<Arc> > out;
+	std::vector<uint64_t> skippedPer;
+	const std::vector<Node*> & nodes;
+	std::vector<std::pair<Node*, Node*> > pairs;
+};
+
+DimacsImporter::DimacsImporter()
+	: threads(hardwareThreads()), chunkSize(16 << 20), callback(0), user(0), fit(false), skipped(0)
+{
+	bounds[0] = bounds[1] = bounds[2] = bounds[3] = 0;
+}
+
+void DimacsImporter::setThreads(unsigned int n)
+{
+	threads = n ? n : 1;
+}
+
+void DimacsImporter::setChunkSize(size_t bytes)
+{
+	chunkSize = bytes < 4096 ? 4096 : bytes;
+}
+
+void DimacsImporter::setProgressCallback(ProgressCallback cb, void * u)
+{
+	callback = cb;
+	user = u;
+}
+
+void DimacsImporter::setBounds(float x1, float y1, float x2, float y2)
+{
+	fit = true;
+	bounds[0] = std::min(x1,x2);
+	bounds[1] = std::min(y1,y2);
+	bounds[2] = std::max(x1,x2);
+	bounds[3] = std::max(y1,y2);
+}
+
+bool DimacsImporter::import(Graph & graph, const std::string & coPath, const std::string & grPath, std::vector<Node*> * ret)
+{
+	error.clear();
+	skipped = 0;
+
+	// The transaction rolls back whatever was created when this unwinds
+	try
+	{
+		return importFiles(graph, coPath, grPath, ret);
+	}
+	catch (const std::bad_alloc &)
+	{
+		error = "out of memory";
+		return false;
+	}
+}
+
+bool DimacsImporter::importFiles(Graph & graph, const std::string & coPath, const std::string & grPath, std::vector<Node*> * ret)
+{
+	// Coordinates
+	CoordChunk coords(threads);
+	if (!readChunks(coPath, "nodes", coords)) return false;
+	skipped += coords.skipped;
+
+	// Fit into bounds: uniform scale, centered
+	double scale = 1, ox = 0, oy = 0;
+	if (fit)
+	{
+		double xmin = DBL_MAX, ymin = DBL_MAX, xmax = -DBL_MAX, ymax = -DBL_MAX;
+		for (size_t i = 0; i < coords.x.size(); ++i)
+		{
+			if (!coords.has[i]) continue;
+			xmin = std::min(xmin, coords.x[i]);
+			ymin = std::min(ymin, coords.y[i]);
+			xmax = std::max(xmax, coords.x[i]);
+			ymax = std::max(ymax, coords.y[i]);
+		}
+		if (xmin <= xmax)
+		{
+			double w = xmax-xmin, h = ymax-ymin;
+			double bw = bounds[2]-bounds[0], bh = bounds[3]-bounds[1];
+			if (w > 0 || h > 0) scale = std::min(w > 0 ? bw/w : DBL_MAX, h > 0 ? bh/h : DBL_MAX);
+			ox = bounds[0] + (bw - w*scale)/2 - xmin*scale;
+			oy = bounds[1] + (bh - h*scale)/2 - ymin*scale;
+		}
+	}
+
+	Transaction t(graph);
+
+	std::vector<Node*> nodes(coords.x.size(), (Node*)0);
+	for (size_t i = 0; i < coords.x.size(); ++i)
+	{
+		if (!coords.has[i]) continue;
+		float x = (float)(coords.x[i]*scale + ox);
+		float y = (float)(coords.y[i]*scale + oy);
+		if (graph.getNodeIndex() && !graph.getNodeIndex()->accepts(x, y))
+		{
+			++skipped;
+			continue;
+		}
+		nodes[i] = Node::create(graph, x, y);
+	}
+
+	// Release coordinate storage before reading arcs
+	std::vector<double>().swap(coords.x);
+	std::vector<double>().swap(coords.y);
+
+	// Arcs
+	if (!grPath.empty())
+	{
+		ArcChunk arcs(threads, nodes);
+		if (!readChunks(grPath, "edges", arcs))
+		{
+			t.rollback();
+			return false;
+		}
+		skipped += arcs.skipped;
+	}
+
+	t.commit();
+
+	if (ret) ret->swap(nodes);
+	return true;
+}
+
+const std::string & DimacsImporter::getError() const
+{
+	return error;
+}
+
+uint64_t DimacsImporter::getSkippedLines() const
+{
+	return skipped;
+}
+
+bool DimacsImporter::readChunks(const std::string & path, const char * stage, Chunk & chunk)
+{
+	FILE * f = fopen(path.c_str(), "rb");
+	if (!f)
+	{
+		error = "could not open " + path;
+		return false;
+	}
+
+	// Total size, for progress
+	uint64_t total = 0;
+#ifdef _WIN32
+	if (_fseeki64(f, 0, SEEK_END) == 0) total = (uint64_t)_ftelli64(f);
+	_fseeki64(f, 0, SEEK_SET);
+#else
+	if (fseeko(f, 0, SEEK_END) == 0) total = (uint64_t)ftello(f);
+	fseeko(f, 0, SEEK_SET);
+#endif
+
+	std::vector<char> buf(chunkSize);
+	size_t carry = 0;
+	uint64_t done = 0;
+	for (;;)
+	{
+		// A line longer than the buffer grows it
+		if (carry == buf.size()) buf.resize(buf.size()*2);
+
+		size_t want = buf.size() - carry;
+		size_t n = fread(&buf[0] + carry, 1, want, f);
+		size_t len = carry + n;
+		bool eof = n < want;
+		if (eof && ferror(f))
+		{
+			error = "could not read " + path;
+			fclose(f);
+			return false;
+		}
+		if (len == 0) break;
+
+		// Cut after the last complete line, unless this is the end
+		size_t cut = len;
+		if (!eof)
+		{
+			while (cut > 0 && buf[cut-1] != '\n') --cut;
+			if (cut == 0)
+			{
+				carry = len;
+				continue;
+			}
+		}
+
+		chunk.consume(&buf[0], &buf[0] + cut);
+		done += cut;
+		if (callback) callback(stage, done, total, user);
+
+		memmove(&buf[0], &buf[0] + cut, len - cut);
+		carry = len - cut;
+		if (eof && carry == 0) break;
+	}
+
+	fclose(f);
+	return true;
+}
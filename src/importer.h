@@ -0,0 +1,98 @@
+#pragma once
+
+/*///=====================================================================
+
+	importer.h
+
+	Streaming importer for DIMACS shortest-path style text graphs: a
+	coordinate file (.co, "v id x y" lines) and an arc file (.gr,
+	"a u v w" lines). Ids are 1-based; comment ("c") lines are skipped.
+	Node ids above the count of the coordinate file's problem ("p") line,
+	or above MAX_NODES without one, are skipped as malformed lines.
+
+	Files are read in fixed-size chunks that are cut at line boundaries and
+	split again among worker threads, each parsing its share with a
+	hand-rolled number parser. Parsing buffers are bounded by the chunk
+	size, but the import as a whole is not: the coordinates are gathered
+	into arrays indexed by id (O(N), released before the arcs are read),
+	the id to Node table lives until the end (O(N)), and everything is
+	created inside one Transaction, which records every node and edge
+	(O(N+E)) so the node and edge quadtrees and sets are filled by the
+	bulk paths when the import ends. Arcs are added a chunk at a time
+	through the bulk Edge::createEdges.
+
+*///======================================================================
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class Graph;
+class Node;
+
+class DimacsImporter
+{
+public:
+
+	//
+	// ProgressCallback
+	//
+	// Called after every chunk with the current stage ("nodes" or "edges")
+	// and the bytes of that stage's file read so far.
+	//
+	typedef void (*ProgressCallback)(const char * stage, uint64_t done, uint64_t total, void * user);
+
+	// Largest node id accepted, declared or not
+	static const uint64_t MAX_NODES = 1 << 26;
+
+	DimacsImporter();
+
+	void setThreads(unsigned int threads);
+
+	void setChunkSize(size_t bytes);
+
+	void setProgressCallback(ProgressCallback callback, void * user);
+
+	//
+	// setBounds
+	//
+	// Coordinates are scaled uniformly (keeping the aspect ratio) and
+	// centered to fit the given rectangle. Without bounds they are used as
+	// they are.
+	//
+	void setBounds(float x1, float y1, float x2, float y2);
+
+	//
+	// import
+	//
+	// Imports the coordinate file and then, if grPath is not empty, the arc
+	// file into graph. Returns false (see getError), with nothing imported,
+	// if a file cannot be read or memory runs out. Created
+	// nodes are pushed to nodes, if given, indexed by DIMACS id - 1 (null
+	// for ids that had no coordinates).
+	//
+	bool import(Graph & graph, const std::string & coPath, const std::string & grPath, std::vector<Node*> * nodes = 0);
+
+	const std::string & getError() const;
+
+	uint64_t getSkippedLines() const;
+
+private:
+
+	struct Chunk;
+	struct CoordChunk;
+	struct ArcChunk;
+
+	bool importFiles(Graph & graph, const std::string & coPath, const std::string & grPath, std::vector<Node*> * nodes);
+
+	bool readChunks(const std::string & path, const char * stage, Chunk & chunk);
+
+	unsigned int threads;
+	size_t chunkSize;
+	ProgressCallback callback;
+	void * user;
+	bool fit;
+	float bounds[4];
+	std::string error;
+	uint64_t skipped;
+};
@@ -1,17 +1,35 @@
 #include <SFML/Graphics.hpp>
 #include <iostream>
+#include <sstream>
+#include <string>
 #include <vector>
-#include <set>
 #include <math.h>
 #include <algorithm>
 
-#include "node.h"
-#include "edge.h"
-#include "selection.h"
-#include "quadtree.h"
-
-int main()
+#include "editor.h"
+#include "profiler.h"
+#include "trace.h"
+
+//
+// Command line: --record <path> records the session's events to a trace
+// file (see trace.h) that bench/replay.cpp plays back headless. --index hash
+// indexes nodes and edges with spatial hashes instead of quadtrees.
+//
+// F2 toggles the profiler overlay (and recording), F3 writes the recorded
+// profile to ../media/profile.json as a Chrome trace. C highlights crossing
+// edges and shows their count in the title. P with two nodes selected
+// highlights the shortest path between them, kept up to date while editing.
+//
+int main(int argc, char ** argv)
 {
+	std::string recordPath;
+	Editor::Index index = Editor::QUADTREE;
+	for (int i = 1; i+1 < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--record") recordPath = argv[++i];
+		else if (std::string(argv[i]) == "--index" && std::string(argv[++i]) == "hash") index = Editor::SPATIAL_HASH;
+	}
+
 	//
     // Create the main rendering window
 	//
@@ -41,438 +59,112 @@ int main()
 	}
 
 	//
-	// Graph
+	// Graph, selection and input state
 	//
-	std::set<Node*> nodes;
-	QuadTree<Node*> qtn(0, 0, (float)App.getSize().x, (float)App.getSize().y, 4);
-	Node::setNodeSet(&nodes);
-	Node::setQuadTree(&qtn);
-
-	std::set<Edge*> edges;
-	QuadTree<Edge*> qte(0, 0, (float)App.getSize().x, (float)App.getSize().y, 4);
-	Edge::setEdgeSet(&edges);
-	Edge::setQuadTree(&qte);
+	Editor editor(App.getSize().x, App.getSize().y, index);
 
 	//
-	// Selection
+	// Trace
 	//
-	Selection selection(6, 0, 0, App.getSize().x, App.getSize().y);
+	EventTrace trace;
+	trace.setSize(App.getSize().x, App.getSize().y);
+	sf::Clock traceClock;
+	uint32_t frame = 0;
+
+	// Crossing count shown in the title
+	int crossingCount = -1;
 
 	//
-	// State
+	// Profiler
 	//
-	bool keySpaceDown = false;
-	bool keyAltDown = false;
-	bool keyCtrlDown = false;
-	bool keyShiftDown = false;
-	bool mouseLeftDown = false;
-	bool mouseRightDown = false;
-	bool mouseDragMoving = false;
-	bool mouseDragSelecting = false;
-	bool mouseDownOnSelection = false;
-	int dragx1 = 0;
-	int dragy1 = 0;
-	int prevx = 0;
-	int prevy = 0;
-	int dragx2 = 0;
-	int dragy2 = 0;
+	sf::Font font;
+	if (font.loadFromFile("../media/font.ttf"))
+		Profiler::setFont(&font);
 
 	//
     // Start game loop
 	//
     while (App.isOpen())
     {
+		Profiler::beginFrame();
+
 		//
         // Process events
 		//
 
-        sf::Event Event;
-		while (App.pollEvent(Event))
-        {
-            // Close window : exit
-            if (Event.type == sf::Event::Closed)
-                App.close();
-			
-			//
-			// Key pressed
-			//
-            if (Event.type == sf::Event::KeyPressed)
-            {
-				if (Event.key.code == sf::Keyboard::Escape) // Escape
-				{
-                    App.close();
-				}
-				else if (Event.key.code == sf::Keyboard::F1) // F1
-                {
-                    sf::Image Screen = App.capture();
-                    Screen.saveToFile("../media/screenshot.jpg");
-                }
-				else if (Event.key.code == sf::Keyboard::LControl || Event.key.code == sf::Keyboard::RControl) // Control
-				{
-					keyCtrlDown = true;
-				}
-				else if (Event.key.code == sf::Keyboard::LShift || Event.key.code == sf::Keyboard::RShift) // Shift
-				{
-					keyShiftDown = true;
-				}
-				else if (Event.key.code == sf::Keyboard::LAlt || Event.key.code == sf::Keyboard::RAlt) // Alt
-				{
-					keyAltDown = true;
-				}
-				else if (Event.key.code == sf::Keyboard::Space) // Space
-				{
-					keySpaceDown = true;
-				}
-				else if (Event.key.code == sf::Keyboard::Back || Event.key.code == sf::Keyboard::Delete) // Backspace or Delete
-				{
-					// Delete selected nodes and their edges
-					for (Selection::iterator it = selection.begin(); it != selection.end(); ++it)
-					{
-						// Node destructor will remove node from node set and quadtree
-						// and will delete its edges. Edge destructor will remove edge
-						// from its nodes, the edge set, and quadtree.
-						delete *it;
-					}
-					selection.clear();
-				}
-				else if (Event.key.code == sf::Keyboard::Insert || Event.key.code == sf::Keyboard::E) // Insert or E
-				{
-					// Toggle edge on a pair of selected nodes
-					if (selection.size() == 2)
-					{
-						Selection::iterator i1 = selection.begin(), i2 = selection.begin();
-						++i2;
-						// Factory creates edge only of nodes are not already neighbors.
-						// Edges add themselves to edge set, quadtree and its nodes' edge sets.
-						if (!Edge::createEdge(*i1, *i2))
-						{
-							// Edge already exists, so remove it instead
-							Edge::destroyEdge(*i1, *i2);
-						}
-					}
-				}
-			}
-
-			//
-			// Key released
-			//
-			if (Event.type == sf::Event::KeyReleased)
+		{
+			PROFILE_SCOPE("events");
+			sf::Event Event;
+			while (App.pollEvent(Event))
 			{
-				if (Event.key.code == sf::Keyboard::LControl || Event.key.code == sf::Keyboard::RControl) // Control
-				{
-					keyCtrlDown = false;
-				}
-				else if (Event.key.code == sf::Keyboard::LShift || Event.key.code == sf::Keyboard::RShift) // Shift
-				{
-					keyShiftDown = false;
-				}
-				else if (Event.key.code == sf::Keyboard::LAlt || Event.key.code == sf::Keyboard::RAlt) // Alt
-				{
-					keyAltDown = false;
-				}
-				else if (Event.key.code == sf::Keyboard::Space) // Space
-				{
-					keySpaceDown = false;
-				}
-			}
+				if (!recordPath.empty())
+					trace.record(Event, frame, traceClock.getElapsedTime().asMicroseconds());
 
-			//
-			// Mouse pressed
-			//
-			if (Event.type == sf::Event::MouseButtonPressed)
-			{
-				//
-				// Left
-				//
-				if (Event.mouseButton.button == sf::Mouse::Left)
+				Editor::Action action = editor.handleEvent(Event);
+				if (action == Editor::CLOSE)
 				{
-					mouseLeftDown = true;
-					dragx1 = prevx = Event.mouseButton.x;
-					dragy1 = prevy = Event.mouseButton.y;
-
-					if (keySpaceDown) // Space
-					{
-						
-					}
-					else if (keyCtrlDown) // Ctrl
-					{
-						// Check if mouse over node
-						std::vector<Node*> v;
-						if (qtn.queryRegion(Event.mouseButton.x+selection.getRange(), Event.mouseButton.y+selection.getRange(), Event.mouseButton.x-selection.getRange(), Event.mouseButton.y-selection.getRange(), v))
-						{
-							Node * n = v[0];
-							// Add edge between clicked node and all selected nodes
-							for (Selection::iterator it = selection.begin(); it != selection.end(); ++it)
-								Edge::createEdge(n, *it);
-							// If shift key not down, clear selection set
-							if (!keyShiftDown) selection.clearSelection();
-							// Add to selection
-							selection.insertSelection(n);
-							mouseDownOnSelection = true;
-						}
-						else
-						{
-							// Place node
-							if (qtn.contains(Event.mouseButton.x, Event.mouseButton.y))
-							{
-								// Nodes add themselves to node set and quadtree
-								Node * n = new Node(Event.mouseButton.x, Event.mouseButton.y);
-								if (keyAltDown) selection.clearSelection();
-								// Add edge between new node and all selected nodes
-								for (Selection::iterator it = selection.begin(); it != selection.end(); ++it)
-								{
-									// Factory creates edge only of nodes are not already neighbors.
-									// Edges add themselves to edge set, quadtree and their nodes' edge sets.
-									Edge::createEdge(n, *it);
-								}
-								// Update selection
-								if (!keyShiftDown) selection.clearSelection();
-								// Add to selection
-								selection.insertSelection(n);
-								mouseDownOnSelection = true;
-							}
-						}
-					}
-					else if (keyShiftDown) // Shift
-					{
-						// Check if mouse over nodes
-						std::vector<Node*> v;
-						if (qtn.queryRegion(Event.mouseButton.x+selection.getRange(), Event.mouseButton.y+selection.getRange(), Event.mouseButton.x-selection.getRange(), Event.mouseButton.y-selection.getRange(), v))
-						{
-							// Check if there's a node that's not selected
-							for (size_t i = 0; i < v.size(); ++i)
-							{
-								if (!v[i]->isSelected())
-								{
-									// Add single node to selection
-									selection.insertSelection(v[i]);
-									mouseDownOnSelection = true;
-									break;
-								}
-							}
-						}
-					}
-					else if (keyAltDown) // Alt
-					{
-						// Check if mouse over nodes
-						std::vector<Node*> v;
-						if (qtn.queryRegion(Event.mouseButton.x+selection.getRange(), Event.mouseButton.y+selection.getRange(), Event.mouseButton.x-selection.getRange(), Event.mouseButton.y-selection.getRange(), v))
-						{
-							// Check if there's a node that's selected
-							for (size_t i = 0; i < v.size(); ++i)
-							{
-								if (v[i]->isSelected())
-								{
-									// Remove single node from selection
-									selection.eraseSelection(v[i]);
-									break;
-								}
-							}
-						}
-					}
-					else // Else
-					{
-						// Check if mouse over nodes
-						std::vector<Node*> v;
-						if (qtn.queryRegion(Event.mouseButton.x+selection.getRange(), Event.mouseButton.y+selection.getRange(), Event.mouseButton.x-selection.getRange(), Event.mouseButton.y-selection.getRange(), v))
-						{
-							// Check if all nodes not selected
-							bool noneSelected = true;
-							for (size_t i = 0; i < v.size(); ++i)
-							{
-								if (v[i]->isSelected())
-								{
-									noneSelected = false;
-									mouseDownOnSelection = true;
-									break;
-								}
-							}
-							if (noneSelected)
-							{
-								// Select single node
-								selection.clearSelection();
-								selection.insertSelection(v[0]);
-								mouseDownOnSelection = true;
-							}
-						}
-						else
-						{
-							// Check if mouse over edges
-							std::vector<Edge*> v;
-							if (qte.queryRegion(Event.mouseButton.x+selection.getRange(), Event.mouseButton.y+selection.getRange(), Event.mouseButton.x-selection.getRange(), Event.mouseButton.y-selection.getRange(), v))
-							{
-								// Check if an edge's nodes are both in selection
-								bool noneSelected = true;
-								for (size_t i = 0; i < v.size(); ++i)
-								{
-									if (v[i]->n1->isSelected() && v[i]->n2->isSelected())
-									{
-										noneSelected = false;
-										mouseDownOnSelection = true;
-										break;
-									}
-								}
-								if (noneSelected)
-								{
-									// Select single edge
-									selection.clearSelection();
-									selection.insertSelection(v[0]->n1);
-									selection.insertSelection(v[0]->n2);
-									mouseDownOnSelection = true;
-								}
-							}
-							else
-							{
-								// Clear selection
-								selection.clearSelection();
-							}
-						}
-					}
+					App.close();
 				}
-
-				//
-				// Right
-				//
-				if (Event.mouseButton.button == sf::Mouse::Right)
+				else if (action == Editor::SCREENSHOT)
 				{
-					mouseRightDown = true;
+					sf::Image Screen = App.capture();
+					Screen.saveToFile("../media/screenshot.jpg");
 				}
-			}
-
-			//
-			// Mouse released
-			//
-			if (Event.type == sf::Event::MouseButtonReleased)
-			{
-				//
-				// Left
-				//
-				if (Event.mouseButton.button == sf::Mouse::Left)
+				else if (action == Editor::TOGGLE_PROFILER)
 				{
-					if (mouseDragSelecting)
-					{
-						if (keyAltDown) // Alt
-						{
-							// Remove all from selection
-							std::vector<Node*> v;
-							qtn.queryRegion(dragx1, dragy1, dragx2, dragy2, v);
-							selection.eraseSelection(v);
-						}
-						else if (!keyCtrlDown)
-						{
-							if (!keyShiftDown) // ! Shift
-							{
-								// Making new selection
-								selection.clearSelection();
-							}
-							// Add all to selection (that aren't already selected)
-							std::vector<Node*> v;
-							qtn.queryRegion(dragx1, dragy1, dragx2, dragy2, v);
-							selection.insertSelection(v);
-						}
-					}
-
-					mouseLeftDown = false;
-					mouseDragMoving = false;
-					mouseDragSelecting = false;
-					mouseDownOnSelection = false;
+					Profiler::setEnabled(!Profiler::isEnabled());
 				}
-
-				//
-				// Right
-				//
-				if (Event.mouseButton.button == sf::Mouse::Right)
+				else if (action == Editor::WRITE_PROFILE)
 				{
-					mouseRightDown = false;
+					if (!Profiler::writeChromeTrace("../media/profile.json"))
+						std::cout << "Could not write ../media/profile.json" << std::endl;
 				}
-
 			}
+		}
 
-			//
-			// Mouse moved
-			//
-			if (Event.type == sf::Event::MouseMoved)
-			{
-				dragx2 = Event.mouseMove.x;
-				dragy2 = Event.mouseMove.y;
-				 
-				//
-				// Left
-				//
-				if (mouseLeftDown)
-				{
-					if (mouseDownOnSelection || keySpaceDown)
-					{
-						mouseDragMoving = true;
-						selection.moveSelection(dragx2-prevx, dragy2-prevy);
-					}
-					else //if (keyShiftDown || keyAltDown)
-					{
-						mouseDragSelecting = true;
-					}
-				}
-
-				//
-				// Right
-				//
-				if (mouseRightDown)
-				{
-
-				}
-
-				prevx = dragx2;
-				prevy = dragy2;
-			}
-        }
+		if (editor.getCrossingCount() != crossingCount)
+		{
+			crossingCount = editor.getCrossingCount();
+			std::ostringstream title;
+			title << "Graph Search";
+			if (crossingCount >= 0) title << " - " << crossingCount << " crossings";
+			App.setTitle(title.str());
+		}
 
 		//
 		// Draw
 		//
 
-        // Clear the screen
-        App.clear(sf::Color(255, 255, 255));
+		{
+			PROFILE_SCOPE("draw");
 
-		// Draw lines
-		//for (size_t i = 0; i < lines.size(); ++i) App.draw(*(lines[i]));
-		//sf::Vertex vertices[2] =	{ sf::Vertex(sf::Vector2f(123,231), sf::Color::Blue)
-		//							, sf::Vertex(sf::Vector2f(257,249), sf::Color::Red) };
-		//App.draw(vertices, 2, sf::Lines);
+			// Clear the screen
+			App.clear(sf::Color(255, 255, 255));
 
-		// Draw QuadTree
-		//qtn.draw(App);
-		qte.draw(App);
+			// Draw lines
+			//for (size_t i = 0; i < lines.size(); ++i) App.draw(*(lines[i]));
+			//sf::Vertex vertices[2] =	{ sf::Vertex(sf::Vector2f(123,231), sf::Color::Blue)
+			//							, sf::Vertex(sf::Vector2f(257,249), sf::Color::Red) };
+			//App.draw(vertices, 2, sf::Lines);
 
-		// Draw edges
-		for (std::set<Edge*>::iterator it = edges.begin(); it != edges.end(); ++it)
-		{
-			App.draw((*it)->rect);
-			App.draw((*it)->srect);
-		}
+			// Draw graph
+			editor.draw(App);
 
-		// Draw nodes
-		for (std::set<Node*>::iterator it = nodes.begin(); it != nodes.end(); ++it)
-		{
-			App.draw((*it)->circ);
-			//std::cout << "n=" << (*it)->neighbors.size() << " e=" << (*it)->edges.size() << std::endl;
+			// Draw profiler overlay (last frame's numbers)
+			Profiler::draw(App);
 		}
 
-		// Draw drag select
-		if (mouseDragSelecting)
+		// Update the window
 		{
-			sf::RectangleShape rect(sf::Vector2f((float)std::abs(dragx1-dragx2), (float)std::abs(dragy1-dragy2)));
-			rect.setPosition((float)std::min(dragx1,dragx2), (float)std::min(dragy1,dragy2));
-			rect.setFillColor(sf::Color::Transparent);
-			rect.setOutlineThickness(1);
-			rect.setOutlineColor(sf::Color::Black);
-			App.draw(rect);
+			PROFILE_SCOPE("display");
+			App.display();
 		}
-
-		//std::cout << "n=" << nodes.size() << " qn=" << qtn.numItems() << " e=" << edges.size() << " qe=" << qte.numItems() << std::endl;
-		//std::cout << selection.size() << std::endl;
-
-		// Update the window
-		App.display();
+		Profiler::endFrame();
+		++frame;
     }
 
+	if (!recordPath.empty() && !trace.save(recordPath))
+		std::cout << "Could not save trace " << recordPath << std::endl;
+
     return EXIT_SUCCESS;
 }
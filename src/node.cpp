@@ -1,32 +1,31 @@
 #include "node.h"
 #include "edge.h"
+#include "graph.h"
+#include "transaction.h"
 
-std::set<Node*> * Node::nset = 0;
-QuadTree<Node*> * Node::qtree = 0;
-
-Node::Node(int x, int y) : x((float)x), y((float)y), selected(false)
+Node::Node(Graph * graph, unsigned int id, float x, float y) : graph(graph), id(id), x(x), y(y), selected(false)
 {
 	init();
 }
 
-Node::Node(float x, float y) : x(x), y(y), selected(false)
+Node::~Node()
 {
-	init();
 }
 
-Node::~Node()
+//
+// Deletes the node's edges and erases it from the node set and quadtree.
+//
+void Node::unlink()
 {
-	for (std::set<Edge*>::iterator it = edges.begin(); it != edges.end();)
+	while (!edges.empty())
 	{
-		Edge * e = *it; // Grab edge before it is erased from its nodes' edge sets.
-		++it; // Increment before edge erased from set we're incrementing through.
-		delete e; // Edge destructor will erase edge from its nodes' edge sets
-		// (one of which we're incrementing through) and erase it from the edge
-		// set and the quadtree (if they are set).
+		Edge::destroy(edges.back()); // Edge::unlink will erase edge from its
+		// nodes' edge lists (one of which we're draining) and erase it from
+		// the edge set and the quadtree (if they are set).
 	}
 	// Erase self from node set and quadtree (if they are set)
-	if (nset) nset->erase(this);
-	if (qtree) qtree->erase(this, x, y);
+	if (graph->nset) graph->nset->erase(this);
+	if (graph->nodeIndex) graph->nodeIndex->erase(this, x, y);
 }
 
 void Node::init()
@@ -36,9 +35,15 @@ void Node::init()
 	circ.setFillColor(sf::Color::Black);
 	circ.setOutlineColor(sf::Color::Red);
 	circ.setOutlineThickness(0);
+	// Inside a transaction the set and quadtree are updated on commit
+	if (graph->transaction)
+	{
+		graph->transaction->nodeCreated(this);
+		return;
+	}
 	// Add self to node set and quadtree (if they are set)
-	if (nset) nset->insert(this);
-	if (qtree) qtree->insert(this, x, y);
+	if (graph->nset) graph->nset->insert(this);
+	if (graph->nodeIndex) graph->nodeIndex->insert(this, x, y);
 }
 
 void Node::select()
@@ -64,18 +69,19 @@ void Node::setPosition(int nx, int ny)
 }
 void Node::setPosition(float nx, float ny)
 {
-	// Erase self from quadtree
-	if (qtree) qtree->erase(this, x, y);
+	// Erase self from quadtree (deferred inside a transaction)
+	if (graph->transaction) graph->transaction->nodeMoved(this);
+	else if (graph->nodeIndex) graph->nodeIndex->erase(this, x, y);
 
 	// Set position
 	x = nx;
 	y = ny;
 	circ.setPosition(nx-5, ny-5);
-	for (std::set<Edge*>::iterator it = edges.begin(); it != edges.end(); ++it)
+	for (EdgeList::iterator it = edges.begin(); it != edges.end(); ++it)
 		(*it)->update();
 
 	// Insert self into quadtree
-	if (qtree) qtree->insert(this, x, y);
+	if (!graph->transaction && graph->nodeIndex) graph->nodeIndex->insert(this, x, y);
 }
 
 void Node::move(int dx, int dy)
@@ -84,17 +90,55 @@ void Node::move(int dx, int dy)
 }
 void Node::move(float dx, float dy)
 {
-	// Move in quadtree
-	if (qtree) qtree->move(this, x, y, x+dx, y+dy);
-
 	// Move
+	translate(dx, dy);
+
+	// Update edges
+	for (EdgeList::iterator it = edges.begin(); it != edges.end(); ++it)
+		(*it)->update();
+}
+
+void Node::translate(float dx, float dy)
+{
+	// Move in quadtree (deferred inside a transaction)
+	if (graph->transaction) graph->transaction->nodeMoved(this);
+	else if (graph->nodeIndex) graph->nodeIndex->move(this, x, y, x+dx, y+dy);
+
+	// Move without updating edges
 	x += dx;
 	y += dy;
 	circ.move(dx, dy);
+}
 
-	// Update edges
-	for (std::set<Edge*>::iterator it = edges.begin(); it != edges.end(); ++it)
-		(*it)->update();
+unsigned int Node::degree() const
+{
+	return edges.size();
+}
+
+Node * Node::neighbor(unsigned int i) const
+{
+	return edges[i]->other(this);
+}
+
+uint64_t Node::handle() const
+{
+	return graph->nodes.handle(id);
+}
+
+void Node::addEdge(Edge * e)
+{
+	e->slot(this) = edges.size();
+	edges.push_back(e);
+}
+
+void Node::removeEdge(Edge * e)
+{
+	// Swap last edge into the removed edge's slot
+	unsigned int i = e->slot(this);
+	Edge * last = edges.back();
+	edges[i] = last;
+	last->slot(this) = i;
+	edges.pop_back();
 }
 
 std::ostream & operator<<(std::ostream & out, const Node & rhs)
@@ -103,12 +147,48 @@ std::ostream & operator<<(std::ostream & out, const Node & rhs)
 	return out;
 }
 
-void Node::setNodeSet(std::set<Node*> * nodeSet)
+Node * Node::create(Graph & graph, int x, int y)
+{
+	return create(graph, (float)x, (float)y);
+}
+
+Node * Node::create(Graph & graph, float x, float y)
+{
+	unsigned int i;
+	void * p = graph.nodes.allocate(i);
+	return new (p) Node(&graph, i, x, y);
+}
+
+void Node::destroy(Node * n)
+{
+	if (n->graph->transaction)
+		assert(!"Node::destroy: not supported inside a transaction");
+	n->unlink();
+	free(n);
+}
+
+//
+// Destroys the node and returns its slot without touching any index.
+//
+void Node::free(Node * n)
+{
+	Graph * g = n->graph;
+	unsigned int i = n->id;
+	n->~Node();
+	g->nodes.release(i);
+}
+
+//
+// Copies the node to p and destroys the original, for Slab::relocate. The
+// copy keeps the old id and edge pointers until the caller remaps them.
+//
+void Node::relocate(void * p, Node * n)
 {
-	nset = nodeSet;
+	new (p) Node(*n);
+	n->~Node();
 }
 
-void Node::setQuadTree(QuadTree<Node*> * quadTree)
+Node * Node::get(const Graph & graph, uint64_t handle)
 {
-	qtree = quadTree;
+	return graph.nodes.get(handle);
 }
@@ -2,23 +2,24 @@
 
 #include <SFML/Graphics.hpp>
 #include <set>
+#include <stdint.h>
+#include <vector>
 #include <iostream>
 
-#include "quadtree.h"
+#include "smallvector.h"
 
 class Edge;
+class Graph;
 
 class Node
 {
 	friend class Edge;
+	friend class Graph;
+	friend class Transaction;
 
 public:
 
-	Node(int x, int y);
-
-	Node(float x, float y);
-
-	~Node();
+	typedef SmallVector<Edge*, 4> EdgeList;
 
 	void init();
 
@@ -34,20 +35,43 @@ public:
 	void move(int dx, int dy);
 	void move(float dx, float dy);
 
+	void translate(float dx, float dy);
+
+	unsigned int degree() const;
+
+	Node * neighbor(unsigned int i) const;
+
+	uint64_t handle() const;
+
 	friend std::ostream & operator<<(std::ostream & out, const Node & rhs);
 
+	Graph * graph;
+	unsigned int id; // slab index, reused after the node is destroyed
 	float x;
 	float y;
 	bool selected;
-	std::set<Edge*> edges;
-	std::set<Node*> neighbors;
+	EdgeList edges; // neighbors are the other ends of these
 	sf::CircleShape circ;
 	
 	//
 	// Static
 	//
-	static void setNodeSet(std::set<Node*> * nodeSet);
-	static void setQuadTree(QuadTree<Node*> * quadTree);
-	static std::set<Node*> * nset;
-	static QuadTree<Node*> * qtree;
+	static Node * create(Graph & graph, int x, int y);
+	static Node * create(Graph & graph, float x, float y);
+	static void destroy(Node * n);
+	static Node * get(const Graph & graph, uint64_t handle);
+
+private:
+
+	Node(Graph * graph, unsigned int id, float x, float y);
+
+	~Node();
+
+	void unlink();
+
+	void addEdge(Edge * e);
+	void removeEdge(Edge * e);
+
+	static void free(Node * n);
+	static void relocate(void * p, Node * n);
 };
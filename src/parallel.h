@@ -0,0 +1,64 @@
+#pragma once
+
+/*///=====================================================================
+
+	parallel.h
+
+	Minimal fork/join helpers over std::thread.
+
+*///======================================================================
+
+#include <thread>
+#include <vector>
+
+//
+// hardwareThreads
+//
+// Returns the number of hardware threads, or 1 if it cannot be determined.
+//
+inline unsigned int hardwareThreads()
+{
+	unsigned int n = std::thread::hardware_concurrency();
+	return n ? n : 1;
+}
+
+//
+// parallelRun
+//
+// Calls fn(i) for every i in [0, count), each on its own thread (the last
+// one on the calling thread), and returns once all of them have finished.
+//
+template<typename Fn>
+void parallelRun(unsigned int count, Fn fn)
+{
+	if (count == 0) return;
+	std::vector<std::thread> threads;
+	threads.reserve(count-1);
+	for (unsigned int i = 0; i+1 < count; ++i)
+		threads.push_back(std::thread(fn, i));
+	fn(count-1);
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+}
+
+//
+// parallelFor
+//
+// Splits [0, n) into one contiguous range per thread and calls
+// fn(begin, end) for each range in parallel.
+//
+template<typename Fn>
+void parallelFor(size_t n, Fn fn, unsigned int threads = 0)
+{
+	if (threads == 0) threads = hardwareThreads();
+	if (threads > n) threads = (unsigned int)(n ? n : 1);
+	struct Range
+	{
+		Range(size_t n, unsigned int threads, Fn & fn) : n(n), threads(threads), fn(fn) {}
+		void operator()(unsigned int i) const { fn(n * i / threads, n * (i+1) / threads); }
+		size_t n;
+		unsigned int threads;
+		Fn & fn;
+	};
+	parallelRun(threads, Range(n, threads, fn));
+}
@@ -0,0 +1,685 @@
+#pragma once
+
+/*///=====================================================================
+
+	persistentquadtree.h
+
+	A quad tree whose cells are immutable once shared. Cells are reference
+	counted; copying the tree or taking a Snapshot shares the root in O(1),
+	and an update copies only the cells on its path that are shared with
+	some other tree or snapshot (cells reachable only from this tree are
+	updated in place, as in QuadTree). Restoring a snapshot is O(1) too, so
+	undo of a large edit keeps a snapshot instead of a deep copy.
+
+	Reference counts are atomic: a Snapshot may be queried and destroyed on
+	another thread while the tree it came from keeps changing. The tree
+	itself, and each Snapshot object, is used from one thread at a time.
+
+	Same subdivision rules as QuadTree (split past MAX_ITEMS_PER_CELL,
+	unify at half of it, MAX_DEPTH), over fixed bounds.
+
+*///======================================================================
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "profiler.h"
+#include "simd.h"
+#include "spatialindex.h"
+
+template<typename T>
+class PersistentQuadTree : public SpatialIndex<T>
+{
+private:
+
+	struct Cell
+	{
+		Cell() : refs(1), count(0)
+		{
+			c[0] = c[1] = c[2] = c[3] = 0;
+		}
+		bool leaf() const { return c[0] == 0; }
+
+		std::atomic<int> refs;
+		int count; // items under this cell
+		Cell * c[4]; // children, all null for a leaf
+		std::vector<T> data;
+		std::vector<float, AlignedAllocator<float> > x;
+		std::vector<float, AlignedAllocator<float> > y;
+	};
+
+	//
+	// Box
+	//
+	// Cell bounds, [x1, x2) x [y1, y2). Not stored in cells: a cell's box
+	// follows from the path to it. Child i is on the x+ side if i & 1, on
+	// the y+ side if i & 2.
+	//
+	struct Box
+	{
+		Box() : x1(0), y1(0), x2(0), y2(0) {}
+		Box(float xa, float ya, float xb, float yb)
+			: x1(std::min(xa,xb)), y1(std::min(ya,yb)), x2(std::max(xa,xb)), y2(std::max(ya,yb)) {}
+
+		bool contains(float x, float y) const
+		{
+			return x >= x1 && y >= y1 && x < x2 && y < y2;
+		}
+		bool contains(const Box & o) const
+		{
+			return x1 <= o.x1 && y1 <= o.y1 && x2 >= o.x2 && y2 >= o.y2;
+		}
+		bool intersects(const Box & o) const
+		{
+			return x1 < o.x2 && y1 < o.y2 && x2 > o.x1 && y2 > o.y1;
+		}
+		bool operator==(const Box & o) const
+		{
+			return x1 == o.x1 && y1 == o.y1 && x2 == o.x2 && y2 == o.y2;
+		}
+		int child(float x, float y) const
+		{
+			return (x >= (x1+x2)/2 ? 1 : 0) | (y >= (y1+y2)/2 ? 2 : 0);
+		}
+		Box quadrant(int i) const
+		{
+			Box b(*this);
+			float mx = (x1+x2)/2, my = (y1+y2)/2;
+			if (i & 1) b.x1 = mx; else b.x2 = mx;
+			if (i & 2) b.y1 = my; else b.y2 = my;
+			return b;
+		}
+
+		float x1, y1, x2, y2;
+	};
+
+public:
+
+	//
+	// Snapshot
+	//
+	// A read-only view of the tree as it was when taken. Copies share the
+	// same cells.
+	//
+	class Snapshot
+	{
+	public:
+
+		Snapshot() : root(0) {}
+
+		Snapshot(const Snapshot & other) : root(other.root), bounds(other.bounds)
+		{
+			acquire(root);
+		}
+
+		Snapshot & operator=(const Snapshot & rhs)
+		{
+			acquire(rhs.root);
+			release(root);
+			root = rhs.root;
+			bounds = rhs.bounds;
+			return *this;
+		}
+
+		~Snapshot()
+		{
+			release(root);
+		}
+
+		bool valid() const
+		{
+			return root != 0;
+		}
+
+		int queryRegion(float x1, float y1, float x2, float y2, std::vector<T> & ret) const
+		{
+			if (root) PersistentQuadTree::queryRegion(root, bounds, Box(x1, y1, x2, y2), ret);
+			return ret.size();
+		}
+
+		int getAllItems(std::vector<T> & ret) const
+		{
+			if (root) PersistentQuadTree::getAllItems(root, ret);
+			return ret.size();
+		}
+
+		int numItems() const
+		{
+			return root ? root->count : 0;
+		}
+
+	private:
+
+		friend class PersistentQuadTree;
+
+		Snapshot(Cell * root, const Box & bounds) : root(root), bounds(bounds)
+		{
+			acquire(root);
+		}
+
+		Cell * root;
+		Box bounds;
+	};
+
+	//
+	// PersistentQuadTree
+	//
+	// An empty tree over the given bounds.
+	//
+	PersistentQuadTree(float x1, float y1, float x2, float y2, int MAX_ITEMS_PER_CELL=6, int MAX_DEPTH=10)
+		: MAX_ITEMS_PER_CELL(MAX_ITEMS_PER_CELL), MAX_DEPTH(MAX_DEPTH), bounds(x1, y1, x2, y2), root(new Cell())
+	{
+	}
+
+	//
+	// PersistentQuadTree
+	//
+	// Copies share all cells: O(1), and either tree may change afterwards
+	// without the other seeing it.
+	//
+	PersistentQuadTree(const PersistentQuadTree & other)
+		: MAX_ITEMS_PER_CELL(other.MAX_ITEMS_PER_CELL), MAX_DEPTH(other.MAX_DEPTH), bounds(other.bounds), root(other.root)
+	{
+		acquire(root);
+	}
+
+	PersistentQuadTree & operator=(const PersistentQuadTree & rhs)
+	{
+		acquire(rhs.root);
+		release(root);
+		root = rhs.root;
+		bounds = rhs.bounds;
+		MAX_ITEMS_PER_CELL = rhs.MAX_ITEMS_PER_CELL;
+		MAX_DEPTH = rhs.MAX_DEPTH;
+		return *this;
+	}
+
+	~PersistentQuadTree()
+	{
+		release(root);
+	}
+
+	//
+	// snapshot
+	//
+	// Returns a view of the tree as it is now, in O(1).
+	//
+	Snapshot snapshot() const
+	{
+		return Snapshot(root, bounds);
+	}
+
+	//
+	// restore
+	//
+	// Makes the tree what it was when the snapshot was taken, in O(1). The
+	// snapshot must come from this tree (or a copy of it).
+	//
+	void restore(const Snapshot & s)
+	{
+		if (!s.root || !(s.bounds == bounds))
+			assert(!"PersistentQuadTree::restore: snapshot");
+		acquire(s.root);
+		release(root);
+		root = s.root;
+	}
+
+	//
+	// insert
+	//
+	// Inserts data into the appropriate cell. Does not check for uniqueness.
+	//
+	void insert(T data, float x, float y)
+	{
+		if (!bounds.contains(x, y))
+			assert(!"PersistentQuadTree::insert: bounds");
+		Cell ** slot = &root;
+		Box b = bounds;
+		for (int depth = 0;; ++depth)
+		{
+			Cell * c = own(*slot);
+			++c->count;
+			if (c->leaf())
+			{
+				if ((int)c->data.size() < MAX_ITEMS_PER_CELL || depth >= MAX_DEPTH)
+				{
+					c->data.push_back(data);
+					c->x.push_back(x);
+					c->y.push_back(y);
+					return;
+				}
+				subdivide(c, b);
+			}
+			int i = b.child(x, y);
+			b = b.quadrant(i);
+			slot = &c->c[i];
+		}
+	}
+	void insert(const std::vector<T> & data, const std::vector<float> & x, const std::vector<float> & y)
+	{
+		PROFILE_SCOPE("PersistentQuadTree::insert(bulk)");
+		for (size_t i = 0; i < data.size(); ++i)
+			insert(data[i], x[i], y[i]);
+	}
+
+	//
+	// erase
+	//
+	// Erases the first item equal to data in the leaf holding (x, y), if
+	// any. Only copies cells when the item is there.
+	//
+	bool erase(T data, float x, float y)
+	{
+		if (!bounds.contains(x, y) || !find(data, x, y)) return false;
+
+		// Own the path down to the leaf, remembering the highest cell that
+		// falls to half capacity so it can be unified
+		Cell ** slot = &root;
+		Box b = bounds;
+		Cell * unifyAt = 0;
+		for (;;)
+		{
+			Cell * c = own(*slot);
+			--c->count;
+			if (c->leaf())
+			{
+				for (size_t i = 0; i < c->data.size(); ++i)
+				{
+					if (c->data[i] == data)
+					{
+						removeAt(c, i);
+						break;
+					}
+				}
+				break;
+			}
+			if (!unifyAt && c->count <= MAX_ITEMS_PER_CELL/2) unifyAt = c;
+			int i = b.child(x, y);
+			b = b.quadrant(i);
+			slot = &c->c[i];
+		}
+		if (unifyAt) unify(unifyAt);
+		return true;
+	}
+
+	//
+	// move
+	//
+	// Moves data from (x1, y1) to (x2, y2): in place when both are in the
+	// same leaf, else erase and insert. Returns true if the item was updated
+	// in place.
+	//
+	bool move(T data, float x1, float y1, float x2, float y2)
+	{
+		PROFILE_SCOPE("PersistentQuadTree::move");
+		PROFILE_COUNT(QT_MOVES, 1);
+		if (bounds.contains(x1, y1) && bounds.contains(x2, y2) && sameLeaf(x1, y1, x2, y2) && find(data, x1, y1))
+		{
+			Cell ** slot = &root;
+			Box b = bounds;
+			for (;;)
+			{
+				Cell * c = own(*slot);
+				if (c->leaf())
+				{
+					for (size_t i = 0; i < c->data.size(); ++i)
+					{
+						if (c->data[i] == data)
+						{
+							c->x[i] = x2;
+							c->y[i] = y2;
+							return true;
+						}
+					}
+					assert(!"PersistentQuadTree::move: lost item");
+					return false;
+				}
+				int i = b.child(x1, y1);
+				b = b.quadrant(i);
+				slot = &c->c[i];
+			}
+		}
+		PROFILE_COUNT(QT_REINSERTS, 1);
+		if (erase(data, x1, y1)) insert(data, x2, y2);
+		return false;
+	}
+
+	//
+	// queryRegion
+	//
+	// Pushes all items inside [x1, x2) x [y1, y2) into the vector and
+	// returns its size.
+	//
+	int queryRegion(float x1, float y1, float x2, float y2, std::vector<T> & ret)
+	{
+		PROFILE_SCOPE("PersistentQuadTree::queryRegion");
+		queryRegion(root, bounds, Box(x1, y1, x2, y2), ret);
+		return ret.size();
+	}
+
+	int getAllItems(std::vector<T> & ret)
+	{
+		ret.reserve(ret.size() + root->count);
+		getAllItems(root, ret);
+		return ret.size();
+	}
+
+	int numItems()
+	{
+		return root->count;
+	}
+
+	bool accepts(float x, float y)
+	{
+		return bounds.contains(x, y);
+	}
+
+	//
+	// eraseIf
+	//
+	// Erases every item (in the given region) for which pred(data) is true
+	// and returns the number erased. Cells are copied only where something
+	// was erased below them.
+	//
+	template<typename Pred>
+	int eraseIf(Pred pred)
+	{
+		PROFILE_SCOPE("PersistentQuadTree::eraseIf");
+		return eraseIfRoot(pred, bounds);
+	}
+	template<typename Pred>
+	int eraseIf(Pred pred, float x1, float y1, float x2, float y2)
+	{
+		PROFILE_SCOPE("PersistentQuadTree::eraseIf");
+		return eraseIfRoot(pred, Box(x1, y1, x2, y2));
+	}
+
+	int eraseMatching(typename SpatialIndex<T>::Predicate & pred)
+	{
+		return eraseIf(typename SpatialIndex<T>::PredicateRef(pred));
+	}
+	int eraseMatching(typename SpatialIndex<T>::Predicate & pred, float x1, float y1, float x2, float y2)
+	{
+		return eraseIf(typename SpatialIndex<T>::PredicateRef(pred), x1, y1, x2, y2);
+	}
+
+	//
+	// numCells
+	//
+	// Cells reachable from this tree, shared or not.
+	//
+	int numCells() const
+	{
+		return numCells(root);
+	}
+
+	//
+	// numShared
+	//
+	// Cells reachable from this tree that are also reachable from a copy or
+	// snapshot (counting a shared cell's whole subtree).
+	//
+	int numShared() const
+	{
+		return numShared(root, false);
+	}
+
+private:
+
+	static void acquire(Cell * c)
+	{
+		if (c) c->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static void release(Cell * c)
+	{
+		if (c && c->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			for (int i = 0; i < 4; ++i) release(c->c[i]);
+			delete c;
+		}
+	}
+
+	//
+	// Copy of a shared cell: items copied, children shared
+	//
+	static Cell * copy(const Cell * c)
+	{
+		PROFILE_COUNT(QT_CELL_COPIES, 1);
+		Cell * d = new Cell();
+		d->count = c->count;
+		d->data = c->data;
+		d->x = c->x;
+		d->y = c->y;
+		for (int i = 0; i < 4; ++i)
+		{
+			d->c[i] = c->c[i];
+			acquire(d->c[i]);
+		}
+		return d;
+	}
+
+	//
+	// Makes the cell in slot exclusively this tree's, copying it if shared.
+	// Called along a path from the root: a copied cell's children become
+	// shared, so they are copied in turn.
+	//
+	static Cell * own(Cell *& slot)
+	{
+		if (slot->refs.load(std::memory_order_acquire) == 1) return slot;
+		Cell * d = copy(slot);
+		release(slot);
+		slot = d;
+		return d;
+	}
+
+	void subdivide(Cell * c, const Box & b)
+	{
+		PROFILE_COUNT(QT_SUBDIVIDES, 1);
+		for (int i = 0; i < 4; ++i) c->c[i] = new Cell();
+		for (size_t k = 0; k < c->data.size(); ++k)
+		{
+			Cell * d = c->c[b.child(c->x[k], c->y[k])];
+			d->data.push_back(c->data[k]);
+			d->x.push_back(c->x[k]);
+			d->y.push_back(c->y[k]);
+			++d->count;
+		}
+		c->data.clear();
+		c->x.clear();
+		c->y.clear();
+	}
+
+	//
+	// Gathers everything under an owned cell into it and drops its children
+	//
+	void unify(Cell * c)
+	{
+		PROFILE_COUNT(QT_UNIFIES, 1);
+		std::vector<T> data;
+		std::vector<float> x, y;
+		gather(c, data, x, y);
+		for (int i = 0; i < 4; ++i)
+		{
+			release(c->c[i]);
+			c->c[i] = 0;
+		}
+		c->data.assign(data.begin(), data.end());
+		c->x.assign(x.begin(), x.end());
+		c->y.assign(y.begin(), y.end());
+		c->count = (int)c->data.size();
+	}
+
+	static void gather(const Cell * c, std::vector<T> & data, std::vector<float> & x, std::vector<float> & y)
+	{
+		data.insert(data.end(), c->data.begin(), c->data.end());
+		x.insert(x.end(), c->x.begin(), c->x.end());
+		y.insert(y.end(), c->y.begin(), c->y.end());
+		if (!c->leaf())
+		{
+			for (int i = 0; i < 4; ++i) gather(c->c[i], data, x, y);
+		}
+	}
+
+	static void removeAt(Cell * c, size_t i)
+	{
+		size_t last = c->data.size() - 1;
+		c->data[i] = c->data[last];
+		c->x[i] = c->x[last];
+		c->y[i] = c->y[last];
+		c->data.pop_back();
+		c->x.pop_back();
+		c->y.pop_back();
+	}
+
+	bool find(T data, float x, float y) const
+	{
+		const Cell * c = root;
+		Box b = bounds;
+		while (!c->leaf())
+		{
+			int i = b.child(x, y);
+			b = b.quadrant(i);
+			c = c->c[i];
+		}
+		for (size_t i = 0; i < c->data.size(); ++i)
+		{
+			if (c->data[i] == data) return true;
+		}
+		return false;
+	}
+
+	bool sameLeaf(float x1, float y1, float x2, float y2) const
+	{
+		const Cell * c = root;
+		Box b = bounds;
+		while (!c->leaf())
+		{
+			int i = b.child(x1, y1);
+			if (i != b.child(x2, y2)) return false;
+			b = b.quadrant(i);
+			c = c->c[i];
+		}
+		return true;
+	}
+
+	static void getAllItems(const Cell * c, std::vector<T> & ret)
+	{
+		ret.insert(ret.end(), c->data.begin(), c->data.end());
+		if (!c->leaf())
+		{
+			for (int i = 0; i < 4; ++i) getAllItems(c->c[i], ret);
+		}
+	}
+
+	static void queryRegion(const Cell * c, const Box & b, const Box & region, std::vector<T> & ret)
+	{
+		if (region.contains(b))
+		{
+			getAllItems(c, ret);
+		}
+		else if (region.intersects(b))
+		{
+			if (!c->leaf())
+			{
+				for (int i = 0; i < 4; ++i) queryRegion(c->c[i], b.quadrant(i), region, ret);
+			}
+			else
+			{
+				appendInRegion(c->data, c->x, c->y, region.x1, region.y1, region.x2, region.y2, ret);
+			}
+		}
+	}
+
+	template<typename Pred>
+	int eraseIfRoot(Pred & pred, const Box & region)
+	{
+		int deleted = 0;
+		Cell * r = eraseIf(root, bounds, true, pred, region, deleted);
+		if (r != root)
+		{
+			release(root);
+			root = r;
+		}
+		return deleted;
+	}
+
+	//
+	// Erases matching items under c. Returns c if nothing changed or c was
+	// updated in place (only when unique: it and every cell above it are
+	// this tree's alone), else a new cell the caller takes over.
+	//
+	template<typename Pred>
+	Cell * eraseIf(Cell * c, const Box & b, bool unique, Pred & pred, const Box & region, int & deleted)
+	{
+		unique = unique && c->refs.load(std::memory_order_acquire) == 1;
+		if (c->leaf())
+		{
+			std::vector<size_t> hits;
+			for (size_t i = 0; i < c->data.size(); ++i)
+			{
+				if (region.contains(c->x[i], c->y[i]) && pred(c->data[i]))
+					hits.push_back(i);
+			}
+			if (hits.empty()) return c;
+			Cell * d = unique ? c : copy(c);
+			for (size_t k = hits.size(); k-- > 0;)
+				removeAt(d, hits[k]);
+			d->count = (int)d->data.size();
+			deleted += (int)hits.size();
+			return d;
+		}
+
+		int before = deleted;
+		Cell * next[4];
+		for (int i = 0; i < 4; ++i)
+		{
+			Box q = b.quadrant(i);
+			next[i] = region.intersects(q) ? eraseIf(c->c[i], q, unique, pred, region, deleted) : c->c[i];
+		}
+		if (deleted == before) return c;
+
+		Cell * d = unique ? c : copy(c);
+		for (int i = 0; i < 4; ++i)
+		{
+			if (next[i] != c->c[i])
+			{
+				release(d->c[i]);
+				d->c[i] = next[i];
+			}
+		}
+		d->count -= deleted - before;
+		if (d->count <= MAX_ITEMS_PER_CELL/2) unify(d);
+		return d;
+	}
+
+	static int numCells(const Cell * c)
+	{
+		int n = 1;
+		if (!c->leaf())
+		{
+			for (int i = 0; i < 4; ++i) n += numCells(c->c[i]);
+		}
+		return n;
+	}
+
+	static int numShared(const Cell * c, bool shared)
+	{
+		shared = shared || c->refs.load(std::memory_order_relaxed) > 1;
+		int n = shared ? 1 : 0;
+		if (!c->leaf())
+		{
+			for (int i = 0; i < 4; ++i) n += numShared(c->c[i], shared);
+		}
+		return n;
+	}
+
+	int MAX_ITEMS_PER_CELL;
+	int MAX_DEPTH;
+	Box bounds;
+	Cell * root;
+};
@@ -0,0 +1,171 @@
+#include "profiler.h"
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <stdio.h>
+#include <sstream>
+
+void Profiler::setEnabled(bool enabled)
+{
+	State & s = state();
+	if (enabled && !s.enabled)
+	{
+		s.start = std::chrono::steady_clock::now();
+		s.depth = 0;
+		s.scopes.clear();
+		s.totals.clear();
+		s.frames.clear();
+		s.lastTotals.clear();
+		s.frameBegin = 0;
+		s.lastFrameTime = 0;
+		for (int i = 0; i < COUNTER_COUNT; ++i) s.counters[i] = s.lastCounters[i] = 0;
+	}
+	s.enabled = enabled;
+}
+
+void Profiler::beginFrame()
+{
+	State & s = state();
+	if (!s.enabled) return;
+	s.frameBegin = now();
+}
+
+void Profiler::endFrame()
+{
+	State & s = state();
+	if (!s.enabled) return;
+
+	FrameCounters f;
+	f.time = now();
+	for (int i = 0; i < COUNTER_COUNT; ++i)
+	{
+		f.counters[i] = s.counters[i];
+		s.lastCounters[i] = s.counters[i];
+		s.counters[i] = 0;
+	}
+	s.frames.push_back(f);
+
+	s.lastFrameTime = f.time - s.frameBegin;
+	s.lastTotals.swap(s.totals);
+	s.totals.clear();
+}
+
+void Profiler::setFont(const sf::Font * font)
+{
+	state().font = font;
+}
+
+const char * Profiler::counterName(Counter c)
+{
+	switch (c)
+	{
+	case QT_MOVES: return "qt moves";
+	case QT_REINSERTS: return "qt reinserts";
+	case QT_SUBDIVIDES: return "qt subdivides";
+	case QT_UNIFIES: return "qt unifies";
+	case QT_CELL_COPIES: return "qt cell copies";
+	case EDGES_UPDATED: return "edges updated";
+	case DRAW_CALLS: return "draw calls";
+	default: return "?";
+	}
+}
+
+void Profiler::draw(sf::RenderWindow & rw)
+{
+	State & s = state();
+	if (!s.enabled) return;
+
+	const float budget = 16667; // microseconds
+	const float width = 200;
+	const float row = 14;
+	size_t rows = 1 + s.lastTotals.size() + (s.font ? COUNTER_COUNT : 0);
+
+	sf::RectangleShape panel(sf::Vector2f(width + (s.font ? 160 : 10), rows * row + 10));
+	panel.setPosition(5, 5);
+	panel.setFillColor(sf::Color(0, 0, 0, 160));
+	rw.draw(panel);
+
+	// Budget line
+	sf::RectangleShape line(sf::Vector2f(1, rows * row));
+	line.setPosition(10 + width, 10);
+	line.setFillColor(sf::Color::Red);
+	rw.draw(line);
+
+	sf::Text text;
+	if (s.font)
+	{
+		text.setFont(*s.font);
+		text.setCharacterSize(11);
+		// setColor is deprecated since SFML 2.4 in favour of setFillColor
+#if SFML_VERSION_MAJOR > 2 || (SFML_VERSION_MAJOR == 2 && SFML_VERSION_MINOR >= 4)
+		text.setFillColor(sf::Color::White);
+#else
+		text.setColor(sf::Color::White);
+#endif
+	}
+
+	for (size_t i = 0; i < rows; ++i)
+	{
+		float y = 10 + i * row;
+		std::ostringstream label;
+		int64_t time = -1;
+		if (i == 0)
+		{
+			time = s.lastFrameTime;
+			label << "frame " << time / 1000.0 << " ms";
+		}
+		else if (i <= s.lastTotals.size())
+		{
+			const Total & t = s.lastTotals[i-1];
+			time = t.time;
+			label << t.name << " " << time / 1000.0 << " ms x" << t.calls;
+		}
+		else
+		{
+			int c = (int)(i - 1 - s.lastTotals.size());
+			label << counterName((Counter)c) << " " << s.lastCounters[c];
+		}
+
+		if (time >= 0)
+		{
+			sf::RectangleShape bar(sf::Vector2f(std::min(width * 1.5f, width * time / budget), row - 4));
+			bar.setPosition(10, y + 2);
+			bar.setFillColor(time > budget ? sf::Color(255, 96, 96) : sf::Color(96, 192, 255));
+			rw.draw(bar);
+		}
+		if (s.font)
+		{
+			text.setString(label.str());
+			text.setPosition(width + 15, y);
+			rw.draw(text);
+		}
+	}
+}
+
+bool Profiler::writeChromeTrace(const std::string & path)
+{
+	State & s = state();
+	FILE * f = fopen(path.c_str(), "w");
+	if (!f) return false;
+
+	fprintf(f, "{\"traceEvents\":[\n");
+	bool first = true;
+	for (size_t i = 0; i < s.scopes.size(); ++i)
+	{
+		const Scope & sc = s.scopes[i];
+		fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%lld,\"dur\":%lld}",
+			first ? "" : ",\n", sc.name, (long long)sc.begin, (long long)(sc.end - sc.begin));
+		first = false;
+	}
+	for (size_t i = 0; i < s.frames.size(); ++i)
+	{
+		const FrameCounters & fc = s.frames[i];
+		fprintf(f, "%s{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":%lld,\"args\":{", first ? "" : ",\n", (long long)fc.time);
+		for (int c = 0; c < COUNTER_COUNT; ++c)
+			fprintf(f, "%s\"%s\":%u", c ? "," : "", counterName((Counter)c), fc.counters[c]);
+		fprintf(f, "}}");
+		first = false;
+	}
+	fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	return fclose(f) == 0;
+}
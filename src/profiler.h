@@ -0,0 +1,239 @@
+#pragma once
+
+/*///=====================================================================
+
+	profiler.h
+
+	Frame profiler: scoped timers and event counters, shown as an overlay
+	(Profiler::draw) and dumped as a Chrome trace JSON file (load it in
+	chrome://tracing or Perfetto).
+
+	Recording is off until Profiler::setEnabled(true); while off, a scope or
+	a count costs one branch. Define NO_PROFILER to compile the PROFILE_
+	macros out entirely. Recording is not thread-safe; record from the main
+	thread only.
+
+	The recording side is header-only so header-only code (QuadTree) can
+	count without linking profiler.cpp; the overlay and the trace writer
+	live in profiler.cpp.
+
+*///======================================================================
+
+#include <chrono>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifndef NO_PROFILER
+#define PROFILER_CONCAT2(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILER_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_COUNT(counter, n) Profiler::count(Profiler::counter, n)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_COUNT(counter, n)
+#endif
+
+namespace sf
+{
+	class Font;
+	class RenderWindow;
+}
+
+class Profiler
+{
+public:
+
+	enum Counter
+	{
+		QT_MOVES,		// QuadTree::move calls
+		QT_REINSERTS,	// moves that left their cell (erase + insert)
+		QT_SUBDIVIDES,
+		QT_UNIFIES,
+		QT_CELL_COPIES,	// cells path-copied by PersistentQuadTree updates
+		EDGES_UPDATED,	// Edge::update calls that recomputed geometry
+		DRAW_CALLS,
+		COUNTER_COUNT
+	};
+
+	//
+	// Scope
+	//
+	// One timed scope, in microseconds since recording was enabled.
+	//
+	struct Scope
+	{
+		const char * name;
+		int64_t begin;
+		int64_t end;
+		uint32_t depth;
+	};
+
+	//
+	// Total
+	//
+	// A scope name's time and call count within one frame.
+	//
+	struct Total
+	{
+		const char * name;
+		int64_t time;
+		uint32_t calls;
+	};
+
+	static const size_t MAX_SCOPES = 1 << 21;
+
+	static bool isEnabled()
+	{
+		return state().enabled;
+	}
+
+	//
+	// setEnabled
+	//
+	// Enabling clears everything recorded so far and restarts the clock.
+	//
+	static void setEnabled(bool enabled);
+
+	static void count(Counter c, uint32_t n = 1)
+	{
+		State & s = state();
+		if (s.enabled) s.counters[c] += n;
+	}
+
+	//
+	// beginFrame / endFrame
+	//
+	// Bracket one frame. endFrame sums the frame's scopes by name and its
+	// counters into the summary the overlay shows, and resets the counters.
+	//
+	static void beginFrame();
+	static void endFrame();
+
+	//
+	// draw
+	//
+	// Draws the last frame's summary in the top-left corner: one bar per
+	// scope name against a 16.7 ms budget line, with labels and counters if
+	// a font has been set.
+	//
+	static void draw(sf::RenderWindow & rw);
+
+	static void setFont(const sf::Font * font);
+
+	//
+	// writeChromeTrace
+	//
+	// Writes every recorded scope as a complete ("X") event and the
+	// counters of every frame as counter ("C") events. Scopes beyond
+	// MAX_SCOPES are not kept for the trace (frame totals still are).
+	//
+	static bool writeChromeTrace(const std::string & path);
+
+	static const char * counterName(Counter c);
+
+	static int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - state().start).count();
+	}
+
+	static void beginScope()
+	{
+		++state().depth;
+	}
+
+	static void endScope(const char * name, int64_t begin)
+	{
+		State & s = state();
+		--s.depth;
+		int64_t end = now();
+		if (s.scopes.size() < MAX_SCOPES)
+		{
+			Scope scope = { name, begin, end, s.depth };
+			s.scopes.push_back(scope);
+		}
+		// Frame totals are per name
+		for (size_t i = 0; i < s.totals.size(); ++i)
+		{
+			if (s.totals[i].name == name || strcmp(s.totals[i].name, name) == 0)
+			{
+				s.totals[i].time += end - begin;
+				++s.totals[i].calls;
+				return;
+			}
+		}
+		Total t = { name, end - begin, 1 };
+		s.totals.push_back(t);
+	}
+
+private:
+
+	struct FrameCounters
+	{
+		int64_t time;
+		uint32_t counters[COUNTER_COUNT];
+	};
+
+	struct State
+	{
+		State() : enabled(false), depth(0), frameBegin(0), lastFrameTime(0), font(0)
+		{
+			for (int i = 0; i < COUNTER_COUNT; ++i) counters[i] = lastCounters[i] = 0;
+		}
+
+		bool enabled;
+		std::chrono::steady_clock::time_point start;
+		uint32_t depth;
+		uint32_t counters[COUNTER_COUNT];
+		std::vector<Scope> scopes;
+		std::vector<Total> totals;
+		std::vector<FrameCounters> frames;
+
+		int64_t frameBegin;
+		int64_t lastFrameTime;
+		uint32_t lastCounters[COUNTER_COUNT];
+		std::vector<Total> lastTotals;
+		const sf::Font * font;
+	};
+
+	static State & state()
+	{
+		static State s;
+		return s;
+	}
+};
+
+//
+// ProfileScope
+//
+// Times the enclosing scope while recording is enabled. name must outlive
+// the recording (use string literals).
+//
+class ProfileScope
+{
+public:
+
+	explicit ProfileScope(const char * name)
+		: name(name), begin(-1)
+	{
+		if (Profiler::isEnabled())
+		{
+			begin = Profiler::now();
+			Profiler::beginScope();
+		}
+	}
+
+	~ProfileScope()
+	{
+		if (begin >= 0 && Profiler::isEnabled()) Profiler::endScope(name, begin);
+	}
+
+private:
+
+	ProfileScope(const ProfileScope &);
+	ProfileScope & operator=(const ProfileScope &);
+
+	const char * name;
+	int64_t begin;
+};
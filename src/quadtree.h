@@ -16,14 +16,22 @@
 #include <set>
 #include <algorithm>
 #include <math.h>
+#include <utility>
 
+#include "profiler.h"
+#include "simd.h"
+#include "spatialindex.h"
+
+// Define QUADTREE_NO_SFML to build without SFML (and without draw)
+#ifndef QUADTREE_NO_SFML
 #define SFMLDEBUG
+#endif
 #ifdef SFMLDEBUG
 #include <SFML/Graphics.hpp>
 #endif
 
 template<typename T>
-class QuadTree
+class QuadTree : public SpatialIndex<T>
 {
 private:
 
@@ -35,6 +43,91 @@ private:
 		float y;
 	};
 
+	//
+	// Items
+	//
+	// A leaf's items as parallel arrays: the payloads, and x and y in
+	// aligned arrays that filterRegion scans with vector compares.
+	//
+	class Items
+	{
+	public:
+		size_t size() const { return data.size(); }
+		bool empty() const { return data.empty(); }
+		Item operator[](size_t i) const { return Item(data[i], x[i], y[i]); }
+
+		size_t bytes() const
+		{
+			return data.capacity() * sizeof(T) + (x.capacity() + y.capacity()) * sizeof(float);
+		}
+
+		void reserve(size_t n)
+		{
+			data.reserve(n);
+			x.reserve(n);
+			y.reserve(n);
+		}
+
+		void push_back(const Item & item)
+		{
+			data.push_back(item.data);
+			x.push_back(item.x);
+			y.push_back(item.y);
+		}
+
+		void append(const std::vector<Item> & v)
+		{
+			reserve(size() + v.size());
+			for (size_t i = 0; i < v.size(); ++i) push_back(v[i]);
+		}
+
+		void append(const Items & other)
+		{
+			data.insert(data.end(), other.data.begin(), other.data.end());
+			x.insert(x.end(), other.x.begin(), other.x.end());
+			y.insert(y.end(), other.y.begin(), other.y.end());
+		}
+
+		void erase(size_t i)
+		{
+			data.erase(data.begin() + i);
+			x.erase(x.begin() + i);
+			y.erase(y.begin() + i);
+		}
+
+		void copy(size_t from, size_t to)
+		{
+			data[to] = data[from];
+			x[to] = x[from];
+			y[to] = y[from];
+		}
+
+		void truncate(size_t n)
+		{
+			data.erase(data.begin() + n, data.end());
+			x.erase(x.begin() + n, x.end());
+			y.erase(y.begin() + n, y.end());
+		}
+
+		void clear()
+		{
+			data.clear();
+			x.clear();
+			y.clear();
+		}
+
+		void swap(Items & other)
+		{
+			data.swap(other.data);
+			x.swap(other.x);
+			y.swap(other.y);
+		}
+
+		std::vector<T> data;
+		std::vector<float, AlignedAllocator<float> > x;
+		std::vector<float, AlignedAllocator<float> > y;
+	};
+
 	struct AABB
 	{
 		AABB() : cx(0), cy(0), hw(0), hh(0) {}
@@ -71,13 +164,52 @@ private:
 
 public:
 
+	//
+	// LayoutCell
+	//
+	// Flat, pointer-free record of one cell, as written by exportLayout.
+	// The four children of a cell are stored consecutively (c1..c4) starting
+	// at firstChild, or firstChild is -1 for a leaf. A leaf's items are
+	// itemCount entries of the item array starting at itemBegin.
+	//
+	struct LayoutCell
+	{
+		float cx;
+		float cy;
+		float hw;
+		float hh;
+		int firstChild;
+		unsigned int itemBegin;
+		unsigned int itemCount;
+		unsigned int reserved;
+	};
+
+	//
+	// Leaf
+	//
+	// Read-only view of one non-empty leaf, as returned by getLeaves: its
+	// bounds and its items as parallel arrays. Valid until the tree is next
+	// modified.
+	//
+	struct Leaf
+	{
+		float x1;
+		float y1;
+		float x2;
+		float y2;
+		const T * data;
+		const float * x;
+		const float * y;
+		size_t size;
+	};
+
 	//
 	// QuadTree
 	//
 	// Constructs a QuadTree cell based on the given lower and upper bounds.
 	//
 	QuadTree(float x1, float y1, float x2, float y2, int MAX_ITEMS_PER_CELL=6, int MAX_DEPTH=10, int depth = 0)
-		: MAX_ITEMS_PER_CELL(MAX_ITEMS_PER_CELL), MAX_DEPTH(MAX_DEPTH), depth(depth), hasChildren(0), c1(0), c2(0), c3(0), c4(0)
+		: MAX_ITEMS_PER_CELL(MAX_ITEMS_PER_CELL), MAX_DEPTH(MAX_DEPTH), depth(depth), hasChildren(0), growable(false), c1(0), c2(0), c3(0), c4(0), tuning(0)
 	{
 		aabb.hw = std::fabs(x1-x2) / 2;
 		aabb.hh = std::fabs(y1-y2) / 2;
@@ -91,6 +223,51 @@ public:
 		if (c2) delete c2;
 		if (c3) delete c3;
 		if (c4) delete c4;
+		if (tuning) delete tuning;
+	}
+
+	//
+	// QuadTree
+	//
+	// Takes over other's cells in O(1), leaving it an empty leaf over the
+	// same bounds. Anything holding the moved tree's address (such as a
+	// Graph it is bound to) must be pointed at the new one.
+	//
+	QuadTree(QuadTree && other)
+		: aabb(other.aabb), MAX_ITEMS_PER_CELL(other.MAX_ITEMS_PER_CELL), MAX_DEPTH(other.MAX_DEPTH), depth(other.depth), hasChildren(0), growable(false), c1(0), c2(0), c3(0), c4(0), tuning(0)
+	{
+		swap(other);
+	}
+
+	QuadTree & operator=(QuadTree && other)
+	{
+		if (this != &other)
+		{
+			QuadTree tmp(std::move(other));
+			swap(tmp);
+		}
+		return *this;
+	}
+
+	//
+	// swap
+	//
+	// Exchanges the contents of two trees in O(1).
+	//
+	void swap(QuadTree & other)
+	{
+		std::swap(aabb, other.aabb);
+		std::swap(MAX_ITEMS_PER_CELL, other.MAX_ITEMS_PER_CELL);
+		std::swap(MAX_DEPTH, other.MAX_DEPTH);
+		std::swap(depth, other.depth);
+		std::swap(hasChildren, other.hasChildren);
+		std::swap(growable, other.growable);
+		std::swap(c1, other.c1);
+		std::swap(c2, other.c2);
+		std::swap(c3, other.c3);
+		std::swap(c4, other.c4);
+		items.swap(other.items);
+		std::swap(tuning, other.tuning);
 	}
 
 	//
@@ -104,30 +281,32 @@ public:
 	}
 	void insert(T data, float x, float y)
 	{
-		if (!aabb.contains(x,y))
-			assert(!"QuadTree::insert: bounds");
-
-		if (!hasChildren)
-		{
-			if (depth >= MAX_DEPTH || items.size() < (size_t)MAX_ITEMS_PER_CELL)
-				items.push_back(Item(data, x, y));
-			else
-				subdivide();
-		}
+		if (tuning) tune(0, 1);
+		if (growable) growToContain(x, y);
+		insertWork(data, x, y);
+	}
 
-		if (hasChildren)
+	//
+	// insert
+	//
+	// Bulk insert. Items are partitioned among child cells level by level
+	// instead of descending from this cell once per item. data, x and y are
+	// parallel arrays.
+	//
+	void insert(const std::vector<T> & data, const std::vector<float> & x, const std::vector<float> & y)
+	{
+		PROFILE_SCOPE("QuadTree::insert(bulk)");
+		if (tuning) tune(0, (unsigned int)data.size());
+		std::vector<Item> v;
+		v.reserve(data.size());
+		for (size_t i = 0; i < data.size(); ++i)
 		{
-			if (c1->aabb.contains(x, y))
-				c1->insert(data, x, y);
-			else if (c2->aabb.contains(x, y))
-				c2->insert(data, x, y);
-			else if (c3->aabb.contains(x, y))
-				c3->insert(data, x, y);
-			else if (c4->aabb.contains(x, y))
-				c4->insert(data, x, y);
-			else
-				assert(!"QuadTree::insert: child bounds");
+			if (growable) growToContain(x[i], y[i]);
+			if (!aabb.contains(x[i],y[i]))
+				assert(!"QuadTree::insert: bounds");
+			v.push_back(Item(data[i], x[i], y[i]));
 		}
+		insertItems(v);
 	}
 
 	//
@@ -138,7 +317,8 @@ public:
 	//
 	int getAllItems(std::vector<T> & ret)
 	{
-		ret.reserve(ret.size() + numItems());
+		if (tuning) tune(1, 0);
+		ret.reserve(ret.size() + numItemsWork());
 		getAllItemsWork(ret);
 		return ret.size();
 	}
@@ -166,6 +346,8 @@ public:
 	}
 	int queryRegion(float x1, float y1, float x2, float y2, std::vector<T> & ret)
 	{
+		PROFILE_SCOPE("QuadTree::queryRegion");
+		if (tuning) tune(1, 0);
 		AABB region;
 		region.hw = std::fabs(x1-x2) / 2;
 		region.hh = std::fabs(y1-y2) / 2;
@@ -175,6 +357,29 @@ public:
 		return ret.size();
 	}
 
+	//
+	// getLeaves
+	//
+	// Pushes a view of every non-empty leaf bound by this cell (that
+	// intersects the given region) into the vector and returns the number
+	// of leaves. Does not count as a query in adaptive mode, so threads may
+	// call it at once as long as none modifies the tree.
+	//
+	int getLeaves(std::vector<Leaf> & ret)
+	{
+		return getLeaves(aabb.cx-aabb.hw, aabb.cy-aabb.hh, aabb.cx+aabb.hw, aabb.cy+aabb.hh, ret);
+	}
+	int getLeaves(float x1, float y1, float x2, float y2, std::vector<Leaf> & ret)
+	{
+		AABB region;
+		region.hw = std::fabs(x1-x2) / 2;
+		region.hh = std::fabs(y1-y2) / 2;
+		region.cx = std::min(x1,x2) + region.hw;
+		region.cy = std::min(y1,y2) + region.hh;
+		getLeaves(region, ret);
+		return ret.size();
+	}
+
 	//
 	// erase
 	//
@@ -183,6 +388,7 @@ public:
 	//
 	bool erase(T data)
 	{
+		if (tuning) tune(0, 1);
 		bool canUnify = false;
 		return erase(data, canUnify);
 	}
@@ -199,6 +405,7 @@ public:
 	}
 	bool erase(T data, float x, float y)
 	{
+		if (tuning) tune(0, 1);
 		bool canUnify = false;
 		return erase(data, x, y, canUnify);
 	}
@@ -215,6 +422,7 @@ public:
 	}
 	int erase(T data, float x1, float y1, float x2, float y2)
 	{
+		if (tuning) tune(0, 1);
 		AABB region;
 		region.hw = std::fabs(x1-x2) / 2;
 		region.hh = std::fabs(y1-y2) / 2;
@@ -224,6 +432,36 @@ public:
 		return erase(data, region, canUnify);
 	}
 
+	//
+	// eraseIf
+	//
+	// Erases, in a single pass, every item bounded by the intersection of
+	// this cell and the given region for which pred(data) is true. Cells are
+	// unified on the way back up, at most once each. Returns the number of
+	// items erased.
+	//
+	template<typename Pred>
+	int eraseIf(Pred pred)
+	{
+		PROFILE_SCOPE("QuadTree::eraseIf");
+		if (tuning) tune(0, 1);
+		int remaining;
+		return eraseIf(pred, aabb, remaining);
+	}
+	template<typename Pred>
+	int eraseIf(Pred pred, float x1, float y1, float x2, float y2)
+	{
+		PROFILE_SCOPE("QuadTree::eraseIf");
+		if (tuning) tune(0, 1);
+		AABB region;
+		region.hw = std::fabs(x1-x2) / 2;
+		region.hh = std::fabs(y1-y2) / 2;
+		region.cx = std::min(x1,x2) + region.hw;
+		region.cy = std::min(y1,y2) + region.hh;
+		int remaining;
+		return eraseIf(pred, region, remaining);
+	}
+
 	//
 	// move
 	//
@@ -235,15 +473,18 @@ public:
 	}
 	bool move(T data, float x1, float y1, float x2, float y2)
 	{
+		PROFILE_SCOPE("QuadTree::move");
+		PROFILE_COUNT(QT_MOVES, 1);
+		if (tuning) tune(0, 1);
 		QuadTree * qt = getCellContaining(x1, y1);
 		if (qt && qt->contains(x2, y2))
 		{
-			for (std::vector<Item>::iterator it = qt->items.begin(); it != qt->items.end(); ++it)
+			for (size_t i = 0; i < qt->items.size(); ++i)
 			{
-				if (it->data == data)
+				if (qt->items.data[i] == data)
 				{
-					it->x = x2;
-					it->y = y2;
+					qt->items.x[i] = x2;
+					qt->items.y[i] = y2;
 					return true;
 				}
 			}
@@ -251,8 +492,13 @@ public:
 		}
 		else
 		{
+			PROFILE_COUNT(QT_REINSERTS, 1);
+			// Counted once, as the move
+			Tuning * t = tuning;
+			tuning = 0;
 			erase(data, x1, y1);
 			insert(data, x2, y2);
+			tuning = t;
 		}
 		return false;
 	}
@@ -271,6 +517,31 @@ public:
 		return aabb.contains(x, y);
 	}
 
+	//
+	// accepts
+	//
+	// Whether an item may be inserted at (x, y): inside this cell, or
+	// anywhere if it is growable.
+	//
+	bool accepts(float x, float y)
+	{
+		return growable || aabb.contains(x, y);
+	}
+
+	//
+	// eraseMatching
+	//
+	// eraseIf for SpatialIndex callers.
+	//
+	int eraseMatching(typename SpatialIndex<T>::Predicate & pred)
+	{
+		return eraseIf(typename SpatialIndex<T>::PredicateRef(pred));
+	}
+	int eraseMatching(typename SpatialIndex<T>::Predicate & pred, float x1, float y1, float x2, float y2)
+	{
+		return eraseIf(typename SpatialIndex<T>::PredicateRef(pred), x1, y1, x2, y2);
+	}
+
 	//
 	// numItems
 	//
@@ -279,15 +550,7 @@ public:
 	//
 	int numItems()
 	{
-		int ret = items.size();
-		if (hasChildren)
-		{
-			ret += c1->numItems();
-			ret += c2->numItems();
-			ret += c3->numItems();
-			ret += c4->numItems();
-		}
-		return ret;
+		return numItemsWork();
 	}
 
 	//
@@ -309,6 +572,198 @@ public:
 		return ret;
 	}
 
+	//
+	// Stats
+	//
+	// Shape of the tree below a cell, as reported by stats(). Depths are
+	// relative to that cell.
+	//
+	struct Stats
+	{
+		int cells;
+		int leaves;
+		int emptyLeaves;
+		int items;
+		int deepest;					// depth of the deepest leaf
+		int itemsStuck;					// items in over-full leaves at MAX_DEPTH
+		size_t bytes;					// cells plus item storage (capacity)
+		std::vector<int> cellsAtDepth;
+		std::vector<int> itemsAtDepth;
+		std::vector<int> occupancy;		// leaves by item count; the last entry
+										// counts leaves over MAX_ITEMS_PER_CELL
+
+		float emptyRatio() const
+		{
+			return leaves ? (float)emptyLeaves / leaves : 0;
+		}
+	};
+
+	//
+	// stats
+	//
+	// Walks this cell and all cells below it.
+	//
+	Stats stats()
+	{
+		Stats s;
+		s.cells = s.leaves = s.emptyLeaves = s.items = s.deepest = s.itemsStuck = 0;
+		s.bytes = 0;
+		s.occupancy.assign(MAX_ITEMS_PER_CELL + 2, 0);
+		statsWork(s, depth);
+		return s;
+	}
+
+	//
+	// setLimits
+	//
+	// Changes MAX_ITEMS_PER_CELL and MAX_DEPTH of this cell and all cells
+	// below it, and rebalances in place: leaves over the new capacity
+	// subdivide, and cells at or under half of it, or at the new depth
+	// limit, unify.
+	//
+	void setLimits(int maxItemsPerCell, int maxDepth)
+	{
+		PROFILE_SCOPE("QuadTree::setLimits");
+		setLimitsWork(maxItemsPerCell, maxDepth);
+		rebalance();
+	}
+
+	int getMaxItemsPerCell()
+	{
+		return MAX_ITEMS_PER_CELL;
+	}
+
+	int getMaxDepth()
+	{
+		return MAX_DEPTH;
+	}
+
+	//
+	// setAdaptive
+	//
+	// In adaptive mode this cell counts queries (queryRegion, getAllItems)
+	// and updates (insert, erase, eraseIf, move), and every so often picks a
+	// bucket size from their ratio: small buckets when queries dominate,
+	// large ones when updates do. It also deepens the tree by two levels
+	// when over a tenth of the items are stuck at MAX_DEPTH. A change is
+	// applied with setLimits. Use on the root; not for concurrent use.
+	//
+	void setAdaptive(bool adaptive)
+	{
+		if (adaptive && !tuning) tuning = new Tuning();
+		else if (!adaptive && tuning)
+		{
+			delete tuning;
+			tuning = 0;
+		}
+	}
+
+	//
+	// setGrowable
+	//
+	// A growable cell grows instead of asserting when an item is inserted
+	// (or moved) outside its bounds; see growToContain. Use on the root.
+	//
+	void setGrowable(bool growable)
+	{
+		this->growable = growable;
+	}
+
+	bool isGrowable()
+	{
+		return growable;
+	}
+
+	//
+	// growToContain
+	//
+	// Doubles this cell toward (x, y) until it bounds the point, and
+	// returns the number of steps. Each step is O(1): the cell's contents
+	// move down one level into the quadrant it used to cover, and the other
+	// three quadrants start empty; a leaf just widens. Depth goes down by
+	// one per step (below zero from the original root), so MAX_DEPTH keeps
+	// bounding the size of the smallest cells.
+	//
+	int growToContain(float x, float y)
+	{
+		int steps = 0;
+		while (!aabb.contains(x, y))
+		{
+			if (!(aabb.hw > 0 && aabb.hh > 0))
+				assert(!"QuadTree::growToContain: empty bounds");
+			growStep(x < aabb.cx - aabb.hw ? -1 : (x >= aabb.cx + aabb.hw ? 1 : (x < aabb.cx ? -1 : 1)),
+					 y < aabb.cy - aabb.hh ? -1 : (y >= aabb.cy + aabb.hh ? 1 : (y < aabb.cy ? -1 : 1)));
+			++steps;
+		}
+		return steps;
+	}
+
+	//
+	// shrink
+	//
+	// The reverse of growing: while all items lie in one quadrant of this
+	// cell and that quadrant still bounds the given region (e.g. the
+	// window), the cell becomes that quadrant. A cell with children takes
+	// over the one non-empty child in O(1); a leaf just narrows. Returns
+	// the number of steps.
+	//
+	int shrink(float x1, float y1, float x2, float y2)
+	{
+		PROFILE_SCOPE("QuadTree::shrink");
+		AABB keep;
+		keep.hw = std::fabs(x1-x2) / 2;
+		keep.hh = std::fabs(y1-y2) / 2;
+		keep.cx = std::min(x1,x2) + keep.hw;
+		keep.cy = std::min(y1,y2) + keep.hh;
+
+		int steps = 0;
+		while (depth < MAX_DEPTH && shrinkStep(keep)) ++steps;
+		return steps;
+	}
+
+	//
+	// exportLayout
+	//
+	// Appends this cell and all cells below it, breadth first, to cells, and
+	// each leaf's items, mapped through indexOf(data), to items.
+	//
+	template<typename IndexOf>
+	void exportLayout(std::vector<LayoutCell> & cells, std::vector<unsigned int> & items, IndexOf indexOf)
+	{
+		size_t base = cells.size();
+		std::vector<QuadTree*> queue(1, this);
+		cells.resize(base + 1);
+		for (size_t i = 0; i < queue.size(); ++i)
+		{
+			QuadTree * qt = queue[i];
+			LayoutCell c;
+			c.cx = qt->aabb.cx;
+			c.cy = qt->aabb.cy;
+			c.hw = qt->aabb.hw;
+			c.hh = qt->aabb.hh;
+			c.firstChild = -1;
+			c.itemBegin = (unsigned int)items.size();
+			c.itemCount = 0;
+			c.reserved = 0;
+			if (qt->hasChildren)
+			{
+				c.firstChild = (int)(base + queue.size());
+				queue.push_back(qt->c1);
+				queue.push_back(qt->c2);
+				queue.push_back(qt->c3);
+				queue.push_back(qt->c4);
+				cells.resize(base + queue.size());
+			}
+			else
+			{
+				for (size_t j = 0; j < qt->items.size(); ++j)
+					items.push_back(indexOf(qt->items.data[j]));
+				c.itemCount = (unsigned int)qt->items.size();
+			}
+			cells[base + i] = c;
+		}
+	}
+
 #ifdef SFMLDEBUG
 	//
 	// draw
@@ -335,6 +790,175 @@ public:
 
 private:
 
+	// Cells own their children; copying would share them. See
+	// PersistentQuadTree for a tree with cheap copies.
+	QuadTree(const QuadTree &);
+	QuadTree & operator=(const QuadTree &);
+
+	//
+	// Tuning
+	//
+	// Operation counts for adaptive mode; see setAdaptive.
+	//
+	struct Tuning
+	{
+		Tuning() : queries(0), updates(0), interval(4096) {}
+		unsigned int queries;
+		unsigned int updates;
+		unsigned int interval;
+	};
+
+	void insertWork(T data, float x, float y)
+	{
+		if (!aabb.contains(x,y))
+			assert(!"QuadTree::insert: bounds");
+
+		if (!hasChildren)
+		{
+			if (depth >= MAX_DEPTH || items.size() < (size_t)MAX_ITEMS_PER_CELL)
+				items.push_back(Item(data, x, y));
+			else
+				subdivide();
+		}
+
+		if (hasChildren)
+		{
+			if (c1->aabb.contains(x, y))
+				c1->insertWork(data, x, y);
+			else if (c2->aabb.contains(x, y))
+				c2->insertWork(data, x, y);
+			else if (c3->aabb.contains(x, y))
+				c3->insertWork(data, x, y);
+			else if (c4->aabb.contains(x, y))
+				c4->insertWork(data, x, y);
+			else
+				assert(!"QuadTree::insert: child bounds");
+		}
+	}
+
+	int numItemsWork()
+	{
+		int ret = items.size();
+		if (hasChildren)
+		{
+			ret += c1->numItemsWork();
+			ret += c2->numItemsWork();
+			ret += c3->numItemsWork();
+			ret += c4->numItemsWork();
+		}
+		return ret;
+	}
+
+	//
+	// Counts items under this cell, stopping once the count passes limit;
+	// enough to decide whether to unify without walking large subtrees
+	//
+	int numItemsUpTo(int limit)
+	{
+		int ret = items.size();
+		if (hasChildren)
+		{
+			QuadTree * c[4] = { c1, c2, c3, c4 };
+			for (int i = 0; i < 4 && ret <= limit; ++i)
+				ret += c[i]->numItemsUpTo(limit - ret);
+		}
+		return ret;
+	}
+
+	//
+	// Doubles the bounds toward (dx, dy), each -1 or 1
+	//
+	void growStep(int dx, int dy)
+	{
+		PROFILE_SCOPE("QuadTree::grow");
+		aabb.cx += dx * aabb.hw;
+		aabb.cy += dy * aabb.hh;
+		aabb.hw *= 2;
+		aabb.hh *= 2;
+		--depth;
+		if (!hasChildren) return;
+
+		QuadTree * old[4] = { c1, c2, c3, c4 };
+		c1 = new QuadTree(aabb.cx, aabb.cy, aabb.cx+aabb.hw, aabb.cy+aabb.hh, MAX_ITEMS_PER_CELL, MAX_DEPTH, depth+1); // x+ y+
+		c2 = new QuadTree(aabb.cx, aabb.cy, aabb.cx+aabb.hw, aabb.cy-aabb.hh, MAX_ITEMS_PER_CELL, MAX_DEPTH, depth+1); // x+ y-
+		c3 = new QuadTree(aabb.cx, aabb.cy, aabb.cx-aabb.hw, aabb.cy+aabb.hh, MAX_ITEMS_PER_CELL, MAX_DEPTH, depth+1); // x- y+
+		c4 = new QuadTree(aabb.cx, aabb.cy, aabb.cx-aabb.hw, aabb.cy-aabb.hh, MAX_ITEMS_PER_CELL, MAX_DEPTH, depth+1); // x- y-
+
+		// The old contents lie on the side opposite to the growth
+		QuadTree * c = dx < 0 ? (dy < 0 ? c1 : c2) : (dy < 0 ? c3 : c4);
+		c->hasChildren = true;
+		c->c1 = old[0];
+		c->c2 = old[1];
+		c->c3 = old[2];
+		c->c4 = old[3];
+	}
+
+	//
+	// Narrows to the quadrant holding every item, if it bounds keep
+	//
+	bool shrinkStep(AABB keep)
+	{
+		if (hasChildren)
+		{
+			QuadTree * c[4] = { c1, c2, c3, c4 };
+			int full = -1;
+			for (int i = 0; i < 4; ++i)
+			{
+				if (!c[i]->hasChildren && c[i]->items.empty()) continue;
+				if (full >= 0) return false;
+				full = i;
+			}
+			if (full < 0)
+			{
+				unify();
+				return shrinkStep(keep);
+			}
+
+			QuadTree * k = c[full];
+			if (!k->aabb.contains(keep)) return false;
+			for (int i = 0; i < 4; ++i)
+			{
+				if (i != full) delete c[i];
+			}
+			aabb = k->aabb;
+			depth = k->depth;
+			hasChildren = k->hasChildren;
+			c1 = k->c1;
+			c2 = k->c2;
+			c3 = k->c3;
+			c4 = k->c4;
+			items.swap(k->items);
+			k->c1 = k->c2 = k->c3 = k->c4 = 0;
+			delete k;
+			return true;
+		}
+
+		// Leaf: every item must fall on the same side of both center lines
+		int qx = 0, qy = 0;
+		for (size_t i = 0; i < items.size(); ++i)
+		{
+			qx |= items.x[i] < aabb.cx ? 1 : 2;
+			qy |= items.y[i] < aabb.cy ? 1 : 2;
+		}
+		if (qx == 3 || qy == 3) return false;
+		if (qx == 0) qx = keep.cx < aabb.cx ? 1 : 2;
+		if (qy == 0) qy = keep.cy < aabb.cy ? 1 : 2;
+
+		// Same arithmetic as subdivide, so the cell matches the child it
+		// would have had
+		float x2 = qx == 1 ? aabb.cx-aabb.hw : aabb.cx+aabb.hw;
+		float y2 = qy == 1 ? aabb.cy-aabb.hh : aabb.cy+aabb.hh;
+		AABB q;
+		q.hw = std::fabs(aabb.cx-x2) / 2;
+		q.hh = std::fabs(aabb.cy-y2) / 2;
+		q.cx = std::min(aabb.cx,x2) + q.hw;
+		q.cy = std::min(aabb.cy,y2) + q.hh;
+		if (!q.contains(keep)) return false;
+		aabb = q;
+		++depth;
+		return true;
+	}
+
 	QuadTree * getCellContaining(float x, float y)
 	{
 		if (hasChildren)
@@ -363,19 +987,11 @@ private:
 		}
 		else
 		{
-			for (size_t i = 0; i < items.size(); ++i)
-				ret.push_back(items[i].data);
+			ret.insert(ret.end(), items.data.begin(), items.data.end());
 		}
 	}
 
-	int getAllItems(std::vector<Item> & ret)
-	{
-		ret.reserve(ret.size() + numItems());
-		getAllItemsWork(ret);
-		return ret.size();
-	}
-
-	void getAllItemsWork(std::vector<Item> & ret)
+	void getAllItemsWork(Items & ret)
 	{
 		if (hasChildren)
 		{
@@ -386,7 +1002,32 @@ private:
 		}
 		else
 		{
-			ret.insert(ret.end(), items.begin(), items.end());
+			ret.append(items);
+		}
+	}
+
+	void getLeaves(AABB region, std::vector<Leaf> & ret)
+	{
+		if (!region.intersects(aabb)) return;
+		if (hasChildren)
+		{
+			c1->getLeaves(region, ret);
+			c2->getLeaves(region, ret);
+			c3->getLeaves(region, ret);
+			c4->getLeaves(region, ret);
+		}
+		else if (!items.empty())
+		{
+			Leaf l;
+			l.x1 = aabb.cx-aabb.hw;
+			l.y1 = aabb.cy-aabb.hh;
+			l.x2 = aabb.cx+aabb.hw;
+			l.y2 = aabb.cy+aabb.hh;
+			l.data = &items.data[0];
+			l.x = &items.x[0];
+			l.y = &items.y[0];
+			l.size = items.size();
+			ret.push_back(l);
 		}
 	}
 
@@ -394,7 +1035,7 @@ private:
 	{
 		if (region.contains(aabb))
 		{
-			getAllItems(ret);
+			getAllItemsWork(ret);
 		}
 		else if (region.intersects(aabb))
 		{
@@ -407,10 +1048,8 @@ private:
 			}
 			else
 			{
-				for (size_t i = 0; i < items.size(); ++i)
-				{
-					if (region.contains(items[i].x, items[i].y)) ret.push_back(items[i].data);
-				}
+				appendInRegion(items.data, items.x, items.y,
+					region.cx-region.hw, region.cy-region.hh, region.cx+region.hw, region.cy+region.hh, ret);
 			}
 		}
 	}
@@ -432,7 +1071,7 @@ private:
 
 			if (canUnify)
 			{
-				if (numItems() <= MAX_ITEMS_PER_CELL/2)
+				if (numItemsUpTo(MAX_ITEMS_PER_CELL/2) <= MAX_ITEMS_PER_CELL/2)
 				{
 					unify();
 					return true;
@@ -447,11 +1086,11 @@ private:
 		}
 		else
 		{
-			for (std::vector<Item>::iterator it = items.begin(); it != items.end(); ++it)
+			for (size_t i = 0; i < items.size(); ++i)
 			{
-				if (it->data == data)
+				if (items.data[i] == data)
 				{
-					items.erase(it); // invalidates iterators
+					items.erase(i);
 					canUnify = true;
 					return true;
 				}
@@ -480,7 +1119,7 @@ private:
 
 			if (canUnify)
 			{
-				if (numItems() <= MAX_ITEMS_PER_CELL/2)
+				if (numItemsUpTo(MAX_ITEMS_PER_CELL/2) <= MAX_ITEMS_PER_CELL/2)
 				{
 					unify();
 					return true;
@@ -495,11 +1134,11 @@ private:
 		}
 		else
 		{
-			for (std::vector<Item>::iterator it = items.begin(); it != items.end(); ++it)
+			for (size_t i = 0; i < items.size(); ++i)
 			{
-				if (it->data == data)
+				if (items.data[i] == data)
 				{
-					items.erase(it); // invalidates iterators
+					items.erase(i);
 					canUnify = true;
 					return true;
 				}
@@ -514,6 +1153,7 @@ private:
 	int erase(T data, AABB region, bool & canUnify)
 	{
 		int deleted = 0;
+		if (!region.intersects(aabb)) return 0;
 		if (hasChildren)
 		{
 			deleted += c1->erase(data, region, canUnify);
@@ -523,7 +1163,7 @@ private:
 
 			if (canUnify)
 			{
-				if (numItems() <= MAX_ITEMS_PER_CELL/2)
+				if (numItemsUpTo(MAX_ITEMS_PER_CELL/2) <= MAX_ITEMS_PER_CELL/2)
 					unify();
 				else
 					canUnify = false;
@@ -532,27 +1172,193 @@ private:
 		}
 		else
 		{
-			std::vector<Item>::iterator it = items.begin();
-			while (it != items.end())
+			size_t n = 0;
+			for (size_t i = 0; i < items.size(); ++i)
 			{
-				if (it->data == data)
-				{
-					canUnify = true;
+				if (items.data[i] == data && region.contains(items.x[i], items.y[i]))
 					++deleted;
-					it = items.erase(it);
-				}
 				else
-				{
-					++it;
-				}
+					items.copy(i, n++);
+			}
+			items.truncate(n);
+			if (deleted) canUnify = true;
+			return deleted;
+		}
+	}
+
+	//
+	// Erase all items matching pred in region; remaining is set to the number
+	// of items left under this cell (counted only until it passes
+	// MAX_ITEMS_PER_CELL/2), or -1 if it was not counted
+	//
+	template<typename Pred>
+	int eraseIf(Pred & pred, AABB region, int & remaining)
+	{
+		int deleted = 0;
+		if (hasChildren)
+		{
+			QuadTree * c[4] = { c1, c2, c3, c4 };
+			int counts[4] = { -1, -1, -1, -1 };
+			for (int i = 0; i < 4; ++i)
+			{
+				if (region.intersects(c[i]->aabb))
+					deleted += c[i]->eraseIf(pred, region, counts[i]);
+			}
 
+			remaining = -1;
+			if (deleted)
+			{
+				// Only count untouched children when something was erased
+				remaining = 0;
+				for (int i = 0; i < 4 && remaining <= MAX_ITEMS_PER_CELL/2; ++i)
+					remaining += counts[i] >= 0 ? counts[i] : c[i]->numItemsUpTo(MAX_ITEMS_PER_CELL/2 - remaining);
+				if (remaining <= MAX_ITEMS_PER_CELL/2)
+					unify();
 			}
 			return deleted;
 		}
+		else
+		{
+			size_t n = 0;
+			for (size_t i = 0; i < items.size(); ++i)
+			{
+				if (region.contains(items.x[i], items.y[i]) && pred(items.data[i]))
+					++deleted;
+				else
+					items.copy(i, n++);
+			}
+			items.truncate(n);
+			remaining = (int)items.size();
+			return deleted;
+		}
+	}
+
+	void insertItems(std::vector<Item> & v)
+	{
+		if (v.empty()) return;
+
+		if (!hasChildren)
+		{
+			if (depth >= MAX_DEPTH || items.size() + v.size() <= (size_t)MAX_ITEMS_PER_CELL)
+			{
+				items.append(v);
+				return;
+			}
+			subdivide();
+		}
+
+		std::vector<Item> v1, v2, v3, v4;
+		for (size_t i = 0; i < v.size(); ++i)
+		{
+			if (c1->aabb.contains(v[i].x, v[i].y))
+				v1.push_back(v[i]);
+			else if (c2->aabb.contains(v[i].x, v[i].y))
+				v2.push_back(v[i]);
+			else if (c3->aabb.contains(v[i].x, v[i].y))
+				v3.push_back(v[i]);
+			else if (c4->aabb.contains(v[i].x, v[i].y))
+				v4.push_back(v[i]);
+			else
+				assert(!"QuadTree::insertItems: child bounds");
+		}
+		std::vector<Item>().swap(v); // release before recursing
+		c1->insertItems(v1);
+		c2->insertItems(v2);
+		c3->insertItems(v3);
+		c4->insertItems(v4);
+	}
+
+	void statsWork(Stats & s, int base)
+	{
+		size_t d = (size_t)(depth - base);
+		if (s.cellsAtDepth.size() <= d)
+		{
+			s.cellsAtDepth.resize(d+1, 0);
+			s.itemsAtDepth.resize(d+1, 0);
+		}
+		++s.cells;
+		++s.cellsAtDepth[d];
+		s.bytes += sizeof(QuadTree) + items.bytes();
+		if (hasChildren)
+		{
+			c1->statsWork(s, base);
+			c2->statsWork(s, base);
+			c3->statsWork(s, base);
+			c4->statsWork(s, base);
+			return;
+		}
+		int n = (int)items.size();
+		++s.leaves;
+		if (n == 0) ++s.emptyLeaves;
+		s.items += n;
+		s.itemsAtDepth[d] += n;
+		if ((int)d > s.deepest) s.deepest = (int)d;
+		if (n > MAX_ITEMS_PER_CELL && depth >= MAX_DEPTH) s.itemsStuck += n;
+		++s.occupancy[std::min(n, MAX_ITEMS_PER_CELL + 1)];
+	}
+
+	void setLimitsWork(int maxItemsPerCell, int maxDepth)
+	{
+		MAX_ITEMS_PER_CELL = maxItemsPerCell;
+		MAX_DEPTH = maxDepth;
+		if (hasChildren)
+		{
+			c1->setLimitsWork(maxItemsPerCell, maxDepth);
+			c2->setLimitsWork(maxItemsPerCell, maxDepth);
+			c3->setLimitsWork(maxItemsPerCell, maxDepth);
+			c4->setLimitsWork(maxItemsPerCell, maxDepth);
+		}
+	}
+
+	//
+	// Bottom-up: children first, so a cell unifies on its children's final
+	// counts; returns the number of items under this cell
+	//
+	int rebalance()
+	{
+		if (hasChildren)
+		{
+			if (depth >= MAX_DEPTH)
+			{
+				unify();
+				return (int)items.size();
+			}
+			int n = c1->rebalance() + c2->rebalance() + c3->rebalance() + c4->rebalance();
+			if (n <= MAX_ITEMS_PER_CELL/2) unify();
+			return n;
+		}
+		int n = (int)items.size();
+		if (n > MAX_ITEMS_PER_CELL && depth < MAX_DEPTH) subdivide();
+		return n;
+	}
+
+	//
+	// Counts operations in adaptive mode and retunes every interval
+	// operations; the interval grows with the tree so the stats() walk stays
+	// amortized
+	//
+	void tune(unsigned int queries, unsigned int updates)
+	{
+		tuning->queries += queries;
+		tuning->updates += updates;
+		if (tuning->queries + tuning->updates < tuning->interval) return;
+
+		float q = (float)tuning->queries / (tuning->queries + tuning->updates);
+		tuning->queries = tuning->updates = 0;
+
+		int maxItemsPerCell = q >= 0.9f ? 4 : q >= 0.6f ? 8 : q >= 0.3f ? 16 : 32;
+		int maxDepth = MAX_DEPTH;
+		Stats s = stats();
+		if (s.itemsStuck * 10 > s.items && maxDepth < 20) maxDepth += 2;
+		tuning->interval = std::max(4096, s.items);
+
+		if (maxItemsPerCell != MAX_ITEMS_PER_CELL || maxDepth != MAX_DEPTH)
+			setLimits(maxItemsPerCell, maxDepth);
 	}
 
 	void subdivide()
 	{
+		PROFILE_COUNT(QT_SUBDIVIDES, 1);
 		c1 = new QuadTree(aabb.cx, aabb.cy, aabb.cx+aabb.hw, aabb.cy+aabb.hh, MAX_ITEMS_PER_CELL, MAX_DEPTH, depth+1); // x+ y+
 		c2 = new QuadTree(aabb.cx, aabb.cy, aabb.cx+aabb.hw, aabb.cy-aabb.hh, MAX_ITEMS_PER_CELL, MAX_DEPTH, depth+1); // x+ y-
 		c3 = new QuadTree(aabb.cx, aabb.cy, aabb.cx-aabb.hw, aabb.cy+aabb.hh, MAX_ITEMS_PER_CELL, MAX_DEPTH, depth+1); // x- y+
@@ -560,18 +1366,18 @@ private:
 
 		for (size_t i = 0; i < items.size(); ++i)
 		{
-			T data = items[i].data;
-			float x = items[i].x;
-			float y = items[i].y;
+			T data = items.data[i];
+			float x = items.x[i];
+			float y = items.y[i];
 
 			if (c1->aabb.contains(x, y))
-				c1->insert(data, x, y);
+				c1->insertWork(data, x, y);
 			else if (c2->aabb.contains(x, y))
-				c2->insert(data, x, y);
+				c2->insertWork(data, x, y);
 			else if (c3->aabb.contains(x, y))
-				c3->insert(data, x, y);
+				c3->insertWork(data, x, y);
 			else if (c4->aabb.contains(x, y))
-				c4->insert(data, x, y);
+				c4->insertWork(data, x, y);
 			else
 				assert(!"QuadTree::subdivide");
 		}
@@ -582,7 +1388,8 @@ private:
 
 	void unify()
 	{
-		getAllItems(items);
+		PROFILE_COUNT(QT_UNIFIES, 1);
+		getAllItemsWork(items);
 		delete c1;
 		delete c2;
 		delete c3;
@@ -595,13 +1402,15 @@ private:
 	}
 
 	AABB aabb;
-	const int MAX_ITEMS_PER_CELL;
-	const int MAX_DEPTH;
+	int MAX_ITEMS_PER_CELL;
+	int MAX_DEPTH;
 	int depth;
 	bool hasChildren;
+	bool growable; // root only
 	QuadTree * c1; // x+ y+
 	QuadTree * c2; // x+ y-
 	QuadTree * c3; // x- y+
 	QuadTree * c4; // x- y-
-	std::vector<Item> items;
+	Items items;
+	Tuning * tuning; // adaptive mode, root only
 };
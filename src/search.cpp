@@ -0,0 +1,205 @@
+#include "search.h"
+#include "generators.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+//
+// SearchGraph
+//
+
+SearchGraph::SearchGraph()
+	: offsets(1, 0)
+{
+}
+
+void SearchGraph::build(const GeneratedGraph & g)
+{
+	build(g.x, g.y, g.edges);
+}
+
+void SearchGraph::build(const std::vector<float> & x, const std::vector<float> & y, const std::vector<std::pair<uint32_t, uint32_t> > & edges)
+{
+	uint32_t n = (uint32_t)x.size();
+	this->x = x;
+	this->y = y;
+
+	// Count degrees, prefix-sum them into offsets, then scatter
+	offsets.assign(n+1, 0);
+	for (size_t i = 0; i < edges.size(); ++i)
+	{
+		++offsets[edges[i].first+1];
+		++offsets[edges[i].second+1];
+	}
+	for (uint32_t v = 0; v < n; ++v)
+		offsets[v+1] += offsets[v];
+
+	targets.resize(offsets[n]);
+	weights.resize(offsets[n]);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end()-1);
+	for (size_t i = 0; i < edges.size(); ++i)
+	{
+		uint32_t a = edges[i].first;
+		uint32_t b = edges[i].second;
+		float dx = x[b] - x[a];
+		float dy = y[b] - y[a];
+		float w = std::sqrt(dx*dx + dy*dy);
+		targets[fill[a]] = b;
+		weights[fill[a]++] = w;
+		targets[fill[b]] = a;
+		weights[fill[b]++] = w;
+	}
+}
+
+size_t SearchGraph::memoryBytes() const
+{
+	return x.capacity() * sizeof(float) + y.capacity() * sizeof(float)
+		+ offsets.capacity() * sizeof(uint32_t)
+		+ targets.capacity() * sizeof(uint32_t)
+		+ weights.capacity() * sizeof(float);
+}
+
+//
+// PathSearch
+//
+
+const float PathSearch::UNREACHABLE = -1;
+const uint32_t PathSearch::NONE;
+
+PathSearch::PathSearch(const SearchGraph & graph)
+	: graph(graph), round(0), settled(0)
+{
+}
+
+void PathSearch::reset()
+{
+	uint32_t n = graph.numNodes();
+	if (stamp.size() != n)
+	{
+		dist.assign(n, 0);
+		parent.assign(n, NONE);
+		stamp.assign(n, 0);
+		round = 0;
+	}
+	if (++round == 0)
+	{
+		// Stamps wrapped; clear them once
+		std::fill(stamp.begin(), stamp.end(), 0);
+		round = 1;
+	}
+	heap.clear();
+	queue.clear();
+	settled = 0;
+}
+
+void PathSearch::reach(uint32_t v, float d, uint32_t p)
+{
+	stamp[v] = round;
+	dist[v] = d;
+	parent[v] = p;
+}
+
+float PathSearch::bfs(uint32_t s, uint32_t t)
+{
+	reset();
+	reach(s, 0, NONE);
+	queue.push_back(s);
+	for (size_t head = 0; head < queue.size(); ++head)
+	{
+		uint32_t v = queue[head];
+		++settled;
+		if (v == t) return dist[v];
+		for (uint32_t a = graph.arcBegin(v); a < graph.arcEnd(v); ++a)
+		{
+			uint32_t w = graph.target(a);
+			if (reached(w)) continue;
+			reach(w, dist[v] + 1, v);
+			queue.push_back(w);
+		}
+	}
+	return UNREACHABLE;
+}
+
+float PathSearch::dijkstra(uint32_t s, uint32_t t)
+{
+	return shortest(s, t, false);
+}
+
+float PathSearch::astar(uint32_t s, uint32_t t)
+{
+	return shortest(s, t, true);
+}
+
+//
+// Dijkstra with a lazy binary heap (stale entries are skipped when
+// popped), optionally keyed by dist + straight-line distance to t
+//
+float PathSearch::shortest(uint32_t s, uint32_t t, bool heuristic)
+{
+	reset();
+	float tx = graph.getX(t);
+	float ty = graph.getY(t);
+	std::greater<Entry> cmp;
+
+	reach(s, 0, NONE);
+	heap.push_back(Entry(0, s));
+	while (!heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), cmp);
+		Entry e = heap.back();
+		heap.pop_back();
+		uint32_t v = e.second;
+		float h = 0;
+		if (heuristic)
+		{
+			float dx = tx - graph.getX(v);
+			float dy = ty - graph.getY(v);
+			h = std::sqrt(dx*dx + dy*dy);
+		}
+		if (e.first > dist[v] + h) continue;
+
+		++settled;
+		if (v == t) return dist[v];
+
+		for (uint32_t a = graph.arcBegin(v); a < graph.arcEnd(v); ++a)
+		{
+			uint32_t w = graph.target(a);
+			float d = dist[v] + graph.weight(a);
+			if (reached(w) && d >= dist[w]) continue;
+			reach(w, d, v);
+			float key = d;
+			if (heuristic)
+			{
+				float dx = tx - graph.getX(w);
+				float dy = ty - graph.getY(w);
+				key += std::sqrt(dx*dx + dy*dy);
+			}
+			heap.push_back(Entry(key, w));
+			std::push_heap(heap.begin(), heap.end(), cmp);
+		}
+	}
+	return UNREACHABLE;
+}
+
+uint32_t PathSearch::getSettled() const
+{
+	return settled;
+}
+
+bool PathSearch::getPath(uint32_t t, std::vector<uint32_t> & path) const
+{
+	path.clear();
+	if (t >= stamp.size() || !reached(t)) return false;
+	for (uint32_t v = t; v != NONE; v = parent[v])
+		path.push_back(v);
+	std::reverse(path.begin(), path.end());
+	return true;
+}
+
+size_t PathSearch::memoryBytes() const
+{
+	return dist.capacity() * sizeof(float) + parent.capacity() * sizeof(uint32_t)
+		+ stamp.capacity() * sizeof(uint32_t)
+		+ heap.capacity() * sizeof(Entry) + queue.capacity() * sizeof(uint32_t);
+}
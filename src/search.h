@@ -0,0 +1,129 @@
+#pragma once
+
+/*///=====================================================================
+
+	search.h
+
+	Shortest-path search over a compact, read-only view of a graph.
+
+	SearchGraph stores the graph in CSR form (one offsets array, one flat
+	array of arc targets and weights), built either from a GeneratedGraph
+	or from the live Node/Edge objects via Graph::buildSearchGraph. Arc
+	weights are Euclidean edge lengths, so the straight-line distance is an
+	admissible A* heuristic.
+
+	PathSearch runs BFS, Dijkstra and A* on a SearchGraph. Its per-node
+	arrays are allocated once and invalidated per query by bumping a round
+	counter, so a query costs only the nodes it touches.
+
+*///======================================================================
+
+#include <stdint.h>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+struct GeneratedGraph;
+
+class SearchGraph
+{
+public:
+
+	SearchGraph();
+
+	//
+	// build
+	//
+	// Builds the CSR arrays from coordinates and an undirected edge list
+	// (each edge once; both directions are stored).
+	//
+	void build(const GeneratedGraph & g);
+	void build(const std::vector<float> & x, const std::vector<float> & y, const std::vector<std::pair<uint32_t, uint32_t> > & edges);
+
+	uint32_t numNodes() const { return (uint32_t)x.size(); }
+
+	size_t numArcs() const { return targets.size(); }
+
+	uint32_t arcBegin(uint32_t v) const { return offsets[v]; }
+
+	uint32_t arcEnd(uint32_t v) const { return offsets[v+1]; }
+
+	uint32_t target(uint32_t arc) const { return targets[arc]; }
+
+	float weight(uint32_t arc) const { return weights[arc]; }
+
+	float getX(uint32_t v) const { return x[v]; }
+
+	float getY(uint32_t v) const { return y[v]; }
+
+	size_t memoryBytes() const;
+
+private:
+
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> targets;
+	std::vector<float> weights;
+};
+
+class PathSearch
+{
+public:
+
+	static const float UNREACHABLE;
+	static const uint32_t NONE = 0xFFFFFFFF;
+
+	explicit PathSearch(const SearchGraph & graph);
+
+	//
+	// bfs
+	//
+	// Fewest-hops path; returns the number of hops, or UNREACHABLE.
+	//
+	float bfs(uint32_t s, uint32_t t);
+
+	//
+	// dijkstra / astar
+	//
+	// Shortest weighted path; returns its length, or UNREACHABLE. Both stop
+	// as soon as t is settled.
+	//
+	float dijkstra(uint32_t s, uint32_t t);
+	float astar(uint32_t s, uint32_t t);
+
+	//
+	// getSettled
+	//
+	// Nodes settled (removed from the queue for good) by the last query.
+	//
+	uint32_t getSettled() const;
+
+	//
+	// getPath
+	//
+	// Path of the last query, from s to t. Returns false if t was not
+	// reached.
+	//
+	bool getPath(uint32_t t, std::vector<uint32_t> & path) const;
+
+	size_t memoryBytes() const;
+
+private:
+
+	typedef std::pair<float, uint32_t> Entry;
+
+	float shortest(uint32_t s, uint32_t t, bool heuristic);
+	void reset();
+	bool reached(uint32_t v) const { return stamp[v] == round; }
+	void reach(uint32_t v, float d, uint32_t p);
+
+	const SearchGraph & graph;
+	std::vector<float> dist;
+	std::vector<uint32_t> parent;
+	std::vector<uint32_t> stamp;
+	std::vector<Entry> heap;
+	std::vector<uint32_t> queue;
+	uint32_t round;
+	uint32_t settled;
+};
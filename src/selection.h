@@ -2,60 +2,150 @@
 
 #include "node.h"
 #include "edge.h"
+#include "profiler.h"
 #include <vector>
 
-class Selection : public std::set<Node*>
+//
+// Selection
+//
+// Membership is a bitset indexed by Node::id, members are kept in a compact
+// vector (with each member's position indexed by id) so insert, erase and
+// contains are O(1). Bounds are recomputed lazily, only when a node on the
+// boundary has been erased.
+//
+class Selection
 {
 public:
 
+	typedef std::vector<Node*>::const_iterator iterator;
+
 	Selection(int selectionRange, int globalXMin, int globalYMin, int globalXMax, int globalYMax)
-		: range(selectionRange), gxmin((float)globalXMin), gymin((float)globalYMin), gxmax((float)globalXMax), gymax((float)globalYMax), xmin(0), ymin(0), xmax(0), ymax(0) {}
+		: range(selectionRange), bounded(true), gxmin((float)globalXMin), gymin((float)globalYMin), gxmax((float)globalXMax), gymax((float)globalYMax), xmin(0), ymin(0), xmax(0), ymax(0), boundsDirty(false) {}
 
 	Selection(int selectionRange, float globalXMin, float globalYMin, float globalXMax, float globalYMax)
-		: range(selectionRange), gxmin(globalXMin), gymin(globalYMin), gxmax(globalXMax), gymax(globalYMax), xmin(0), ymin(0), xmax(0), ymax(0) {}
+		: range(selectionRange), bounded(true), gxmin(globalXMin), gymin(globalYMin), gxmax(globalXMax), gymax(globalYMax), xmin(0), ymin(0), xmax(0), ymax(0), boundsDirty(false) {}
+
+	//
+	// Unbounded: moveSelection never refuses a drag; use with growable
+	// quad trees (QuadTree::setGrowable)
+	//
+	explicit Selection(int selectionRange)
+		: range(selectionRange), bounded(false), gxmin(0), gymin(0), gxmax(0), gymax(0), xmin(0), ymin(0), xmax(0), ymax(0), boundsDirty(false) {}
 
 	int getRange()
 	{
 		return range;
 	}
 
+	iterator begin() const
+	{
+		return members.begin();
+	}
+
+	iterator end() const
+	{
+		return members.end();
+	}
+
+	size_t size() const
+	{
+		return members.size();
+	}
+
+	bool empty() const
+	{
+		return members.empty();
+	}
+
+	const std::vector<Node*> & getNodes() const
+	{
+		return members;
+	}
+
+	bool contains(const Node * n) const
+	{
+		return n->id / 32 < bits.size() && (bits[n->id / 32] & (1u << (n->id % 32))) != 0;
+	}
+
 	void insertSelection(Node * n)
 	{
-		insert(n);
+		if (contains(n)) return;
+		setBit(n->id);
+		pos[n->id] = (unsigned int)members.size();
+		members.push_back(n);
 		updateSelectionBounds(n);
 		n->select();
 	}
 
-	void insertSelection(std::vector<Node*> v)
+	//
+	// Union with the given nodes
+	//
+	void insertSelection(const std::vector<Node*> & v)
 	{
-		for (std::vector<Node*>::iterator it = v.begin(); it != v.end(); ++it)
-		{
+		members.reserve(members.size() + v.size());
+		for (std::vector<Node*>::const_iterator it = v.begin(); it != v.end(); ++it)
 			insertSelection(*it);
-		}
 	}
 
 	void eraseSelection(Node * n)
 	{
-		erase(n);
-		resetSelectionBounds();
+		if (!contains(n)) return;
+		clearBit(n->id);
+
+		// Swap last member into the erased slot
+		unsigned int i = pos[n->id];
+		Node * last = members.back();
+		members[i] = last;
+		pos[last->id] = i;
+		members.pop_back();
+
+		// Only a node on the boundary can shrink the bounds
+		if (n->x <= xmin || n->y <= ymin || n->x >= xmax || n->y >= ymax)
+			boundsDirty = true;
 		n->deselect();
 	}
 
-	void eraseSelection(std::vector<Node*> v)
+	//
+	// Subtract the given nodes
+	//
+	void eraseSelection(const std::vector<Node*> & v)
+	{
+		for (std::vector<Node*>::const_iterator it = v.begin(); it != v.end(); ++it)
+			eraseSelection(*it);
+	}
+
+	//
+	// Intersect with the given nodes (e.g. the result of a region query)
+	//
+	void intersectSelection(const std::vector<Node*> & v)
 	{
-		for (std::vector<Node*>::iterator it = v.begin(); it != v.end(); ++it)
+		// Mark members that are in v
+		std::vector<unsigned int> keep(bits.size(), 0);
+		for (std::vector<Node*>::const_iterator it = v.begin(); it != v.end(); ++it)
 		{
-			erase(*it);
-			(*it)->deselect();
+			if (contains(*it))
+				keep[(*it)->id / 32] |= 1u << ((*it)->id % 32);
+		}
+
+		// Erase unmarked members, walking backwards so swaps only bring in
+		// members that were already visited
+		for (size_t i = members.size(); i-- > 0;)
+		{
+			Node * n = members[i];
+			if (!(keep[n->id / 32] & (1u << (n->id % 32))))
+				eraseSelection(n);
 		}
-		resetSelectionBounds();
 	}
 
 	void clearSelection()
 	{
 		for (Selection::iterator it = begin(); it != end(); ++it)
+		{
+			clearBit((*it)->id);
 			(*it)->deselect();
-		clear();
+		}
+		members.clear();
+		boundsDirty = false;
 	}
 
 	void moveSelection(int x, int y)
@@ -64,16 +154,54 @@ public:
 	}
 	void moveSelection(float x, float y)
 	{
-		if (empty() || xmin+x <= gxmin || ymin+y <= gymin || xmax+x >= gxmax || ymax+y >= gymax) return;
+		if (empty()) return;
+		if (boundsDirty) resetSelectionBounds();
+		if (bounded && (xmin+x <= gxmin || ymin+y <= gymin || xmax+x >= gxmax || ymax+y >= gymax)) return;
+		PROFILE_SCOPE("Selection::moveSelection");
+
+		// Translate nodes without touching their edges
 		for (Selection::iterator it = begin(); it != end(); ++it)
-			(*it)->move(x, y);
+			(*it)->translate(x, y);
+
+		// Edges with both nodes selected are translated rigidly, once (from
+		// their n1 side). Edges leaving the selection are recomputed once.
+		for (Selection::iterator it = begin(); it != end(); ++it)
+		{
+			Node * n = *it;
+			for (Node::EdgeList::iterator eit = n->edges.begin(); eit != n->edges.end(); ++eit)
+			{
+				Edge * e = *eit;
+				if (!contains(e->other(n)))
+					e->update();
+				else if (e->n1 == n)
+					e->translate(x, y);
+			}
+		}
+
 		moveSelectionBounds(x, y);
 	}
 
 private:
 
+	void setBit(unsigned int id)
+	{
+		if (id / 32 >= bits.size())
+		{
+			bits.resize(id / 32 + 1, 0);
+			pos.resize(bits.size() * 32, 0);
+		}
+		bits[id / 32] |= 1u << (id % 32);
+	}
+
+	void clearBit(unsigned int id)
+	{
+		bits[id / 32] &= ~(1u << (id % 32));
+	}
+
 	void updateSelectionBounds(Node* n)
 	{
+		if (boundsDirty) return;
+
 		if (size() == 1)
 		{
 			xmin = xmax = n->x;
@@ -90,6 +218,8 @@ private:
 
 	void resetSelectionBounds()
 	{
+		boundsDirty = false;
+
 		if (empty()) return;
 
 		xmin = xmax = (*begin())->x;
@@ -115,6 +245,7 @@ private:
 private:
 
 	int range;
+	bool bounded;
 	float gxmin;
 	float gymin;
 	float gxmax;
@@ -123,4 +254,8 @@ private:
 	float ymin;
 	float xmax;
 	float ymax;
-};
\ No newline at end of file
+	bool boundsDirty;
+	std::vector<unsigned int> bits; // membership, indexed by Node::id
+	std::vector<unsigned int> pos; // index into members, indexed by Node::id
+	std::vector<Node*> members;
+};
@@ -0,0 +1,258 @@
+#pragma once
+
+/*///=====================================================================
+
+	simd.h
+
+	Point-in-rectangle filtering over struct-of-arrays coordinates, used by
+	the spatial index leaves and buckets and by GraphFile scans. Four
+	(SSE2) or eight (AVX) points are compared at a time into a bit mask,
+	and the matching indices are written out branch-free through a lookup
+	table.
+
+	The vector path is picked at compile time: AVX when __AVX__ is defined,
+	else SSE2 on x86/x64, else the scalar loop. Define SIMD_SCALAR_ONLY to
+	force the scalar loop, e.g. to benchmark against it.
+
+	AlignedAllocator gives std::vector storage aligned for vector loads.
+	It bypasses operator new, so code counting allocations (the benches)
+	sets simd::allocationHook() to see its allocations too.
+
+*///======================================================================
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#if !defined(SIMD_SCALAR_ONLY)
+#if defined(__AVX__)
+#define SIMD_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+namespace simd
+{
+	//
+	// allocationHook
+	//
+	// Called with the byte count of every AlignedAllocator allocation, if
+	// set.
+	//
+	typedef void (*AllocationHook)(size_t bytes);
+
+	inline AllocationHook & allocationHook()
+	{
+		static AllocationHook hook = 0;
+		return hook;
+	}
+}
+
+//
+// AlignedAllocator
+//
+// Minimal allocator returning ALIGN-byte aligned storage.
+//
+template<typename T, size_t ALIGN = 32>
+class AlignedAllocator
+{
+public:
+
+	typedef T value_type;
+	typedef T * pointer;
+	typedef const T * const_pointer;
+	typedef T & reference;
+	typedef const T & const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template<typename U>
+	struct rebind
+	{
+		typedef AlignedAllocator<U, ALIGN> other;
+	};
+
+	AlignedAllocator() {}
+
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, ALIGN> &) {}
+
+	T * allocate(size_t n)
+	{
+		if (n == 0) return 0;
+		if (simd::allocationHook()) simd::allocationHook()(n * sizeof(T));
+#ifdef _MSC_VER
+		void * p = _aligned_malloc(n * sizeof(T), ALIGN);
+#else
+		void * p = 0;
+		if (posix_memalign(&p, ALIGN, n * sizeof(T)) != 0) p = 0;
+#endif
+		if (!p) throw std::bad_alloc();
+		return (T*)p;
+	}
+
+	void deallocate(T * p, size_t)
+	{
+#ifdef _MSC_VER
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+
+	size_t max_size() const
+	{
+		return ((size_t)-1) / sizeof(T);
+	}
+
+	void construct(T * p, const T & value)
+	{
+		new ((void*)p) T(value);
+	}
+
+	void destroy(T * p)
+	{
+		p->~T();
+	}
+
+	bool operator==(const AlignedAllocator &) const { return true; }
+	bool operator!=(const AlignedAllocator &) const { return false; }
+};
+
+namespace simd
+{
+	//
+	// Lut
+	//
+	// For every 8-bit mask, the positions of its set bits in order and
+	// their count.
+	//
+	struct Lut
+	{
+		Lut()
+		{
+			for (int m = 0; m < 256; ++m)
+			{
+				int k = 0;
+				for (int b = 0; b < 8; ++b)
+					if (m & (1 << b)) index[m][k++] = (uint8_t)b;
+				for (int b = k; b < 8; ++b) index[m][b] = 0;
+				count[m] = (uint8_t)k;
+			}
+		}
+
+		uint8_t index[256][8];
+		uint8_t count[256];
+	};
+
+	inline const Lut & lut()
+	{
+		static const Lut table;
+		return table;
+	}
+}
+
+//
+// filterRegionScalar
+//
+// Writes the indices i in [0, n) with xmin <= x[i] < xmax and
+// ymin <= y[i] < ymax to out, in order, and returns their count.
+//
+inline size_t filterRegionScalar(const float * x, const float * y, size_t n, float xmin, float ymin, float xmax, float ymax, uint32_t * out)
+{
+	size_t k = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		out[k] = (uint32_t)i;
+		k += (x[i] >= xmin) & (x[i] < xmax) & (y[i] >= ymin) & (y[i] < ymax);
+	}
+	return k;
+}
+
+//
+// filterRegion
+//
+// Same as filterRegionScalar, vectorized where available. out must have
+// room for n + 7 indices: whole groups are written, and only the count
+// returned is valid.
+//
+inline size_t filterRegion(const float * x, const float * y, size_t n, float xmin, float ymin, float xmax, float ymax, uint32_t * out)
+{
+	size_t i = 0;
+	size_t k = 0;
+#if defined(SIMD_AVX) || defined(SIMD_SSE2)
+	const simd::Lut & lut = simd::lut();
+#endif
+
+#if defined(SIMD_AVX)
+	__m256 x0 = _mm256_set1_ps(xmin), x1 = _mm256_set1_ps(xmax);
+	__m256 y0 = _mm256_set1_ps(ymin), y1 = _mm256_set1_ps(ymax);
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 vx = _mm256_loadu_ps(x + i);
+		__m256 vy = _mm256_loadu_ps(y + i);
+		__m256 in = _mm256_and_ps(
+			_mm256_and_ps(_mm256_cmp_ps(vx, x0, _CMP_GE_OQ), _mm256_cmp_ps(vx, x1, _CMP_LT_OQ)),
+			_mm256_and_ps(_mm256_cmp_ps(vy, y0, _CMP_GE_OQ), _mm256_cmp_ps(vy, y1, _CMP_LT_OQ)));
+		int mask = _mm256_movemask_ps(in);
+		for (int j = 0; j < 8; ++j)
+			out[k + j] = (uint32_t)i + lut.index[mask][j];
+		k += lut.count[mask];
+	}
+#elif defined(SIMD_SSE2)
+	__m128 x0 = _mm_set1_ps(xmin), x1 = _mm_set1_ps(xmax);
+	__m128 y0 = _mm_set1_ps(ymin), y1 = _mm_set1_ps(ymax);
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+		__m128 in = _mm_and_ps(
+			_mm_and_ps(_mm_cmpge_ps(vx, x0), _mm_cmplt_ps(vx, x1)),
+			_mm_and_ps(_mm_cmpge_ps(vy, y0), _mm_cmplt_ps(vy, y1)));
+		int mask = _mm_movemask_ps(in);
+		for (int j = 0; j < 4; ++j)
+			out[k + j] = (uint32_t)i + lut.index[mask][j];
+		k += lut.count[mask];
+	}
+#endif
+
+	// Tail
+	for (; i < n; ++i)
+	{
+		out[k] = (uint32_t)i;
+		k += (x[i] >= xmin) & (x[i] < xmax) & (y[i] >= ymin) & (y[i] < ymax);
+	}
+	return k;
+}
+
+//
+// appendInRegion
+//
+// Pushes data[i] for every point (x[i], y[i]) of a leaf or bucket inside
+// [xmin, xmax) x [ymin, ymax) into ret, in order. The points are filtered
+// FILTER_BLOCK at a time, so the index buffer stays on the stack.
+//
+enum { FILTER_BLOCK = 64 };
+
+template<typename Data, typename Coords, typename T>
+inline void appendInRegion(const Data & data, const Coords & x, const Coords & y, float xmin, float ymin, float xmax, float ymax, std::vector<T> & ret)
+{
+	uint32_t idx[FILTER_BLOCK + 7];
+	for (size_t b = 0; b < data.size(); b += FILTER_BLOCK)
+	{
+		size_t n = std::min((size_t)FILTER_BLOCK, data.size() - b);
+		size_t k = filterRegion(&x[b], &y[b], n, xmin, ymin, xmax, ymax, idx);
+		for (size_t j = 0; j < k; ++j)
+			ret.push_back(data[b + idx[j]]);
+	}
+}
@@ -0,0 +1,248 @@
+#pragma once
+
+/*///=====================================================================
+
+	slab.h
+
+	A typed slab allocator. Objects live in fixed-size chunks of contiguous
+	slots, so their addresses never change, and each slot is addressed by a
+	dense index that side arrays (distances, parents, visited flags, ...)
+	can be indexed by.
+
+	A handle packs the slot index (low 32 bits) with the slot's generation
+	(high 32 bits). Releasing a slot bumps its generation, and so does
+	relocate (Graph::compact), so a handle to a destroyed or relocated
+	object no longer resolves. Generations wrap after 2^32 bumps of one
+	slot, after which a very old handle could resolve again.
+
+*///======================================================================
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <iterator>
+#include <new>
+#include <vector>
+
+template<typename T, unsigned int CHUNK_BITS = 12>
+class Slab
+{
+public:
+
+	typedef uint64_t Handle;
+
+	static const unsigned int INDEX_BITS = 32;
+	static const unsigned int CHUNK_SIZE = 1u << CHUNK_BITS;
+
+	//
+	// iterator
+	//
+	// Walks live objects in slot order, skipping free slots.
+	//
+	class iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T * value_type;
+		typedef ptrdiff_t difference_type;
+		typedef T * const * pointer;
+		typedef T * reference;
+
+		iterator(const Slab * slab, unsigned int i) : slab(slab), i(i) { skip(); }
+		T * operator*() const { return slab->at(i); }
+		iterator & operator++() { ++i; skip(); return *this; }
+		bool operator==(const iterator & rhs) const { return i == rhs.i; }
+		bool operator!=(const iterator & rhs) const { return i != rhs.i; }
+	private:
+		void skip() { while (i < slab->capacity() && !slab->isLive(i)) ++i; }
+		const Slab * slab;
+		unsigned int i;
+	};
+
+	Slab() : live(0) {}
+
+	//
+	// ~Slab
+	//
+	// Frees the chunks. Live objects are not destroyed; their owners are
+	// responsible for that.
+	//
+	~Slab()
+	{
+		for (size_t i = 0; i < chunks.size(); ++i)
+			::operator delete(chunks[i]);
+	}
+
+	//
+	// allocate
+	//
+	// Returns uninitialized storage for one object and its slot index. The
+	// caller constructs the object in place. Throws std::bad_alloc once
+	// every 32-bit index is in use, as for any other exhausted storage.
+	//
+	void * allocate(unsigned int & index)
+	{
+		if (!freeSlots.empty())
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			if (alive.size() >= 0xFFFFFFFFu)
+				throw std::bad_alloc();
+			index = (unsigned int)alive.size();
+			if ((index >> CHUNK_BITS) >= chunks.size())
+				chunks.push_back((char*)::operator new(CHUNK_SIZE * sizeof(T)));
+			alive.push_back(0);
+			gens.push_back(0);
+		}
+		alive[index] = 1;
+		++live;
+		return slot(index);
+	}
+
+	//
+	// reserve
+	//
+	// Makes room for n objects in all, so the next allocations neither
+	// grow the slot arrays nor allocate chunks one at a time.
+	//
+	void reserve(unsigned int n)
+	{
+		// Free slots are reused first, and capacity counts them
+		if (n <= capacity()) return;
+		alive.reserve(n);
+		gens.reserve(n);
+		chunks.reserve((n + CHUNK_SIZE-1) >> CHUNK_BITS);
+		while (chunks.size() << CHUNK_BITS < n)
+			chunks.push_back((char*)::operator new(CHUNK_SIZE * sizeof(T)));
+	}
+
+	//
+	// release
+	//
+	// Returns the slot of an already destroyed object to the free list.
+	//
+	void release(unsigned int index)
+	{
+		assert(isLive(index));
+		alive[index] = 0;
+		++gens[index];
+		freeSlots.push_back(index);
+		--live;
+	}
+
+	//
+	// relocate
+	//
+	// Rebuilds the slab with its live objects in the given order: order[k]
+	// is the slot index of the object that moves to slot k, and every live
+	// slot appears once. move(dst, src) constructs the object at dst from
+	// *src and destroys *src. Afterwards live slots are dense (0 to size-1),
+	// the free slots above them are handed out lowest first, and every
+	// generation is bumped so handles taken before no longer resolve.
+	// moved[i] is the new address of the object that was in slot i.
+	//
+	template<typename Move>
+	void relocate(const std::vector<unsigned int> & order, Move move, std::vector<T*> & moved)
+	{
+		if (order.size() != live)
+			assert(!"Slab::relocate: order");
+		unsigned int cap = capacity();
+		std::vector<char*> fresh;
+		for (unsigned int i = 0; i < cap; i += CHUNK_SIZE)
+			fresh.push_back((char*)::operator new(CHUNK_SIZE * sizeof(T)));
+
+		moved.assign(cap, (T*)0);
+		for (unsigned int k = 0; k < live; ++k)
+		{
+			unsigned int i = order[k];
+			assert(isLive(i) && !moved[i]);
+			T * dst = (T*)(fresh[k >> CHUNK_BITS] + (k & (CHUNK_SIZE-1)) * sizeof(T));
+			move((void*)dst, at(i));
+			moved[i] = dst;
+		}
+
+		for (size_t i = 0; i < chunks.size(); ++i)
+			::operator delete(chunks[i]);
+		chunks.swap(fresh);
+		freeSlots.clear();
+		for (unsigned int i = 0; i < cap; ++i)
+		{
+			alive[i] = i < live;
+			++gens[i];
+		}
+		for (unsigned int i = cap; i-- > live;)
+			freeSlots.push_back(i);
+	}
+
+	T * at(unsigned int index) const
+	{
+		return (T*)slot(index);
+	}
+
+	//
+	// get
+	//
+	// Resolves a handle, or returns null if the object it named is gone.
+	//
+	T * get(Handle handle) const
+	{
+		unsigned int index = (unsigned int)handle;
+		if (index >= capacity() || !alive[index] || gens[index] != (uint32_t)(handle >> INDEX_BITS)) return 0;
+		return at(index);
+	}
+
+	Handle handle(unsigned int index) const
+	{
+		return ((Handle)gens[index] << INDEX_BITS) | index;
+	}
+
+	bool isLive(unsigned int index) const
+	{
+		return index < capacity() && alive[index];
+	}
+
+	//
+	// capacity
+	//
+	// One past the highest slot index ever handed out; the size for side
+	// arrays indexed by slot.
+	//
+	unsigned int capacity() const
+	{
+		return (unsigned int)alive.size();
+	}
+
+	unsigned int size() const
+	{
+		return live;
+	}
+
+	iterator begin() const
+	{
+		return iterator(this, 0);
+	}
+
+	iterator end() const
+	{
+		return iterator(this, capacity());
+	}
+
+private:
+
+	Slab(const Slab &);
+	Slab & operator=(const Slab &);
+
+	void * slot(unsigned int index) const
+	{
+		return chunks[index >> CHUNK_BITS] + (index & (CHUNK_SIZE-1)) * sizeof(T);
+	}
+
+	std::vector<char*> chunks;
+	std::vector<unsigned char> alive;
+	std::vector<uint32_t> gens;
+	std::vector<unsigned int> freeSlots;
+	unsigned int live;
+};
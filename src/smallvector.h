@@ -0,0 +1,115 @@
+#pragma once
+
+/*///=====================================================================
+
+	smallvector.h
+
+	A vector that stores its first N elements inline and only falls back to
+	the heap once it outgrows them. Meant for small, trivially copyable
+	elements such as pointers (elements are copied with memcpy and never
+	constructed or destroyed).
+
+*///======================================================================
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+template<typename T, unsigned int N>
+class SmallVector
+{
+public:
+
+	typedef T * iterator;
+	typedef const T * const_iterator;
+
+	SmallVector() : data(local), count(0), capacity(N) {}
+
+	SmallVector(const SmallVector & other) : data(local), count(0), capacity(N)
+	{
+		*this = other;
+	}
+
+	~SmallVector()
+	{
+		if (data != local) free(data);
+	}
+
+	SmallVector & operator=(const SmallVector & rhs)
+	{
+		if (this == &rhs) return *this;
+		count = 0;
+		reserve(rhs.count);
+		memcpy(data, rhs.data, rhs.count * sizeof(T));
+		count = rhs.count;
+		return *this;
+	}
+
+	void push_back(const T & v)
+	{
+		if (count == capacity) reserve(capacity * 2);
+		data[count++] = v;
+	}
+
+	void pop_back()
+	{
+		assert(count > 0);
+		--count;
+	}
+
+	void clear()
+	{
+		count = 0;
+	}
+
+	void reserve(unsigned int n)
+	{
+		if (n <= capacity) return;
+		T * p = (T*)malloc(n * sizeof(T));
+		memcpy(p, data, count * sizeof(T));
+		if (data != local) free(data);
+		data = p;
+		capacity = n;
+	}
+
+	//
+	// Releases heap storage that is no longer needed.
+	//
+	void shrink_to_fit()
+	{
+		if (data == local || count == capacity) return;
+		if (count <= N)
+		{
+			memcpy(local, data, count * sizeof(T));
+			free(data);
+			data = local;
+			capacity = N;
+		}
+		else
+		{
+			T * p = (T*)realloc(data, count * sizeof(T));
+			if (p) { data = p; capacity = count; }
+		}
+	}
+
+	unsigned int size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	T & operator[](unsigned int i) { return data[i]; }
+	const T & operator[](unsigned int i) const { return data[i]; }
+
+	T & back() { return data[count-1]; }
+	const T & back() const { return data[count-1]; }
+
+	iterator begin() { return data; }
+	iterator end() { return data + count; }
+	const_iterator begin() const { return data; }
+	const_iterator end() const { return data + count; }
+
+private:
+
+	T * data;
+	unsigned int count;
+	unsigned int capacity;
+	T local[N];
+};
@@ -0,0 +1,278 @@
+#include "spanningtree.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "quadtree.h"
+#include "spatialjoin.h"
+
+#include <algorithm>
+#include <atomic>
+#include <float.h>
+
+namespace
+{
+	// No outgoing arc picked yet
+	const uint64_t NOTHING = ~(uint64_t)0;
+
+	//
+	// A picked arc: its source vertex and its index
+	//
+	uint64_t pack(uint32_t v, uint32_t arc)
+	{
+		return ((uint64_t)v << 32) | arc;
+	}
+
+	//
+	// Whether arc a (from u) is lighter than arc b (from v): by weight, then
+	// by the edge's endpoints, so both arcs of an edge rank alike and no two
+	// edges tie
+	//
+	bool lighter(const SearchGraph & g, uint64_t a, uint64_t b)
+	{
+		uint32_t u = (uint32_t)(a >> 32), ua = (uint32_t)a;
+		uint32_t v = (uint32_t)(b >> 32), vb = (uint32_t)b;
+		float wa = g.weight(ua), wb = g.weight(vb);
+		if (wa != wb) return wa < wb;
+		uint32_t a1 = std::min(u, g.target(ua)), a2 = std::max(u, g.target(ua));
+		uint32_t b1 = std::min(v, g.target(vb)), b2 = std::max(v, g.target(vb));
+		if (a1 != b1) return a1 < b1;
+		return a2 < b2;
+	}
+
+	//
+	// Root of v's set. Only reads, so several threads may run it at once.
+	//
+	uint32_t root(const std::vector<uint32_t> & parent, uint32_t v)
+	{
+		while (parent[v] != v) v = parent[v];
+		return v;
+	}
+
+	//
+	// Root of v's set, halving the path on the way
+	//
+	uint32_t find(std::vector<uint32_t> & parent, uint32_t v)
+	{
+		while (parent[v] != v)
+		{
+			parent[v] = parent[parent[v]];
+			v = parent[v];
+		}
+		return v;
+	}
+
+	//
+	// ByWeight
+	//
+	// Orders the arcs of one vertex lightest first, as lighter does: with
+	// the source fixed, the endpoints order like the targets.
+	//
+	struct ByWeight
+	{
+		ByWeight(const SearchGraph & g) : g(g) {}
+		bool operator()(uint32_t a, uint32_t b) const
+		{
+			float wa = g.weight(a), wb = g.weight(b);
+			if (wa != wb) return wa < wb;
+			return g.target(a) < g.target(b);
+		}
+		const SearchGraph & g;
+	};
+
+	//
+	// SortArcs
+	//
+	// Each vertex's arcs, lightest first, over a range of vertices
+	//
+	struct SortArcs
+	{
+		SortArcs(const SearchGraph & g, std::vector<uint32_t> & order) : g(g), order(order) {}
+
+		void operator()(size_t first, size_t last) const
+		{
+			for (size_t i = first; i < last; ++i)
+			{
+				uint32_t v = (uint32_t)i;
+				for (uint32_t arc = g.arcBegin(v); arc != g.arcEnd(v); ++arc)
+					order[arc] = arc;
+				std::sort(order.begin() + g.arcBegin(v), order.begin() + g.arcEnd(v), ByWeight(g));
+			}
+		}
+
+		const SearchGraph & g;
+		std::vector<uint32_t> & order;
+	};
+
+	//
+	// Lightest
+	//
+	// Picks each component's lightest outgoing arc over a range of
+	// vertices. A vertex's arcs are sorted and an arc once inside its
+	// component stays inside, so each vertex keeps a cursor at its first
+	// arc that may leave and the scans over all rounds cost O(E). The
+	// range's own pick is kept while consecutive vertices share a
+	// component (neighbors mostly do, after Graph::compact) and offered to
+	// the shared slot when the component changes.
+	//
+	struct Lightest
+	{
+		Lightest(const SearchGraph & g, const std::vector<uint32_t> & order, std::vector<uint32_t> & cursor, const std::vector<uint32_t> & comp, std::vector<std::atomic<uint64_t> > & best)
+			: g(g), order(order), cursor(cursor), comp(comp), best(best) {}
+
+		void offer(uint32_t c, uint64_t arc) const
+		{
+			std::atomic<uint64_t> & slot = best[c];
+			uint64_t cur = slot.load(std::memory_order_relaxed);
+			while (cur == NOTHING || lighter(g, arc, cur))
+			{
+				if (slot.compare_exchange_weak(cur, arc, std::memory_order_relaxed)) break;
+			}
+		}
+
+		void operator()(size_t first, size_t last) const
+		{
+			uint32_t current = 0;
+			uint64_t pick = NOTHING;
+			for (size_t i = first; i < last; ++i)
+			{
+				uint32_t v = (uint32_t)i;
+				uint32_t c = comp[v];
+				if (c != current)
+				{
+					if (pick != NOTHING) offer(current, pick);
+					current = c;
+					pick = NOTHING;
+				}
+				uint32_t & k = cursor[v];
+				while (k != g.arcEnd(v) && comp[g.target(order[k])] == c) ++k;
+				if (k == g.arcEnd(v)) continue;
+				uint64_t a = pack(v, order[k]);
+				if (pick == NOTHING || lighter(g, a, pick)) pick = a;
+			}
+			if (pick != NOTHING) offer(current, pick);
+		}
+
+		const SearchGraph & g;
+		const std::vector<uint32_t> & order;
+		std::vector<uint32_t> & cursor;
+		const std::vector<uint32_t> & comp;
+		std::vector<std::atomic<uint64_t> > & best;
+	};
+
+	//
+	// Relabel
+	//
+	// Points every vertex at its merged component's root and clears the
+	// picks for the next round.
+	//
+	struct Relabel
+	{
+		Relabel(const std::vector<uint32_t> & parent, std::vector<uint32_t> & comp, std::vector<std::atomic<uint64_t> > & best)
+			: parent(parent), comp(comp), best(best) {}
+
+		void operator()(size_t first, size_t last) const
+		{
+			for (size_t v = first; v < last; ++v)
+			{
+				comp[v] = root(parent, comp[v]);
+				best[v].store(NOTHING, std::memory_order_relaxed);
+			}
+		}
+
+		const std::vector<uint32_t> & parent;
+		std::vector<uint32_t> & comp;
+		std::vector<std::atomic<uint64_t> > & best;
+	};
+
+	//
+	// Each point's k nearest, by index, from a quadtree over the indices
+	//
+	struct NearestIndices
+	{
+		NearestIndices(QuadTree<uint32_t> & qt, unsigned int threads) : qt(qt), threads(threads) {}
+		void operator()(unsigned int k, IndexPairs & pairs) { nearestJoin(qt, k, pairs, threads); }
+		QuadTree<uint32_t> & qt;
+		unsigned int threads;
+	};
+}
+
+double minimumSpanningForest(const SearchGraph & g, IndexPairs & ret, unsigned int threads)
+{
+	PROFILE_SCOPE("minimumSpanningForest");
+	uint32_t n = g.numNodes();
+	if (threads == 0) threads = hardwareThreads();
+
+	std::vector<uint32_t> order(g.numArcs());
+	parallelFor(n, SortArcs(g, order), threads);
+
+	std::vector<uint32_t> cursor(n);
+	std::vector<uint32_t> comp(n);
+	std::vector<uint32_t> parent(n);
+	std::vector<uint32_t> size(n, 1);
+	std::vector<std::atomic<uint64_t> > best(n);
+	std::vector<uint32_t> roots(n);
+	for (uint32_t v = 0; v < n; ++v)
+	{
+		comp[v] = parent[v] = roots[v] = v;
+		cursor[v] = g.arcBegin(v);
+		best[v].store(NOTHING, std::memory_order_relaxed);
+	}
+
+	double weight = 0;
+	std::vector<uint32_t> next;
+	while (!roots.empty())
+	{
+		parallelFor(n, Lightest(g, order, cursor, comp, best), threads);
+
+		// Merge along the picks; a component with no pick is finished
+		bool merged = false;
+		for (size_t i = 0; i < roots.size(); ++i)
+		{
+			uint64_t pick = best[roots[i]].load(std::memory_order_relaxed);
+			if (pick == NOTHING) continue;
+			uint32_t u = (uint32_t)(pick >> 32), arc = (uint32_t)pick;
+			uint32_t v = g.target(arc);
+			uint32_t ru = find(parent, u), rv = find(parent, v);
+			if (ru == rv) continue; // picked from both sides
+			if (size[ru] < size[rv]) std::swap(ru, rv);
+			parent[rv] = ru;
+			size[ru] += size[rv];
+			ret.push_back(std::make_pair(u, v));
+			weight += g.weight(arc);
+			merged = true;
+		}
+		if (!merged) break;
+
+		next.clear();
+		for (size_t i = 0; i < roots.size(); ++i)
+		{
+			if (parent[roots[i]] == roots[i] && best[roots[i]].load(std::memory_order_relaxed) != NOTHING)
+				next.push_back(roots[i]);
+		}
+		roots.swap(next);
+		parallelFor(n, Relabel(parent, comp, best), threads);
+	}
+	return weight;
+}
+
+double euclideanSpanningTree(const std::vector<float> & x, const std::vector<float> & y, IndexPairs & ret, unsigned int k, unsigned int threads)
+{
+	PROFILE_SCOPE("euclideanSpanningTree");
+	uint32_t n = (uint32_t)x.size();
+	if (n < 2) return 0;
+
+	float xmin = FLT_MAX, ymin = FLT_MAX, xmax = -FLT_MAX, ymax = -FLT_MAX;
+	std::vector<uint32_t> ids(n);
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		ids[i] = i;
+		xmin = std::min(xmin, x[i]);
+		ymin = std::min(ymin, y[i]);
+		xmax = std::max(xmax, x[i]);
+		ymax = std::max(ymax, y[i]);
+	}
+	QuadTree<uint32_t> qt(xmin - 1, ymin - 1, xmax + 1, ymax + 1, 8, 16);
+	qt.insert(ids, x, y);
+
+	NearestIndices candidates(qt, threads);
+	return nearestSpanningTree(x, y, candidates, ret, k, threads);
+}
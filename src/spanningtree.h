@@ -0,0 +1,84 @@
+#pragma once
+
+/*///=====================================================================
+
+	spanningtree.h
+
+	Minimum spanning forests of SearchGraphs, and Euclidean minimum
+	spanning trees of point sets.
+
+	minimumSpanningForest runs Boruvka's algorithm over the CSR arrays:
+	each round every component picks its lightest outgoing arc, in
+	parallel over ranges of vertices, and the picked edges are merged with
+	a union-find. Components at least halve per round, so there are
+	O(log V) rounds of O(E) parallel work each. Ties are broken by the
+	edge's endpoints, so every edge has its own rank and the picks never
+	form a cycle.
+
+	The Euclidean tree is the spanning forest of the k-nearest-neighbor
+	graph (see nearestJoin), with k doubled until that graph connects the
+	points. It is exact whenever every tree edge joins one of its ends to
+	one of the other's k nearest, which for k around 8 all but
+	adversarial inputs satisfy; otherwise it is the lightest tree among
+	the candidates.
+
+*///======================================================================
+
+#include <algorithm>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "search.h"
+
+typedef std::vector<std::pair<uint32_t, uint32_t> > IndexPairs;
+
+//
+// minimumSpanningForest
+//
+// Appends the edges (as vertex pairs) of a minimum spanning forest of g,
+// by arc weight, to ret. threads = 0 uses every hardware thread. Returns
+// the forest's total weight.
+//
+double minimumSpanningForest(const SearchGraph & g, IndexPairs & ret, unsigned int threads = 0);
+
+//
+// euclideanSpanningTree
+//
+// Appends the edges (as index pairs) of a minimum spanning tree of the
+// points to ret, starting from each point's k nearest. threads = 0 uses
+// every hardware thread. Returns the tree's total length.
+//
+double euclideanSpanningTree(const std::vector<float> & x, const std::vector<float> & y, IndexPairs & ret, unsigned int k = 8, unsigned int threads = 0);
+
+//
+// nearestSpanningTree
+//
+// The loop behind euclideanSpanningTree, for points whose k nearest are
+// found elsewhere: candidates(k, pairs) appends the index pairs of each
+// point's k nearest, and is called with k doubling until the candidates
+// connect every point (or k reaches the number of points).
+//
+template<typename Candidates>
+double nearestSpanningTree(const std::vector<float> & x, const std::vector<float> & y, Candidates & candidates, IndexPairs & ret, unsigned int k, unsigned int threads)
+{
+	size_t n = x.size();
+	if (n < 2 || k == 0) return 0;
+
+	SearchGraph sg;
+	IndexPairs pairs;
+	IndexPairs tree;
+	double weight;
+	for (;;)
+	{
+		pairs.clear();
+		candidates(k, pairs);
+		sg.build(x, y, pairs);
+		tree.clear();
+		weight = minimumSpanningForest(sg, tree, threads);
+		if (tree.size() + 1 >= n || k + 1 >= n) break;
+		k = (unsigned int)std::min<size_t>((size_t)k * 2, n - 1);
+	}
+	ret.insert(ret.end(), tree.begin(), tree.end());
+	return weight;
+}
@@ -0,0 +1,486 @@
+#pragma once
+
+/*///=====================================================================
+
+	spatialhash.h
+
+	A uniform grid over the unbounded plane: items are bucketed by the
+	square cell of side cellSize holding them, and the occupied cells are
+	found through an open-addressing hash table keyed by cell coordinates.
+	Empty cells take no memory.
+
+	For evenly spread points with a cell size near the typical query size,
+	insert and erase are one hash probe, a move within its cell is an
+	in-place update, and a query visits only the cells it overlaps. Dense
+	clusters degrade it to scanning long buckets, where QuadTree adapts.
+
+	Buckets are struct-of-arrays and scanned with filterRegion (simd.h).
+
+*///======================================================================
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "profiler.h"
+#include "simd.h"
+#include "spatialindex.h"
+
+template<typename T>
+class SpatialHash : public SpatialIndex<T>
+{
+public:
+
+	//
+	// SpatialHash
+	//
+	// An empty hash over cells of the given side.
+	//
+	explicit SpatialHash(float cellSize)
+		: cellSize(cellSize), invCellSize(1 / cellSize), count(0), used(0), mask(0)
+	{
+		if (!(cellSize > 0))
+			assert(!"SpatialHash: cell size");
+		rehash(16);
+	}
+
+	float getCellSize()
+	{
+		return cellSize;
+	}
+
+	//
+	// insert
+	//
+	// Inserts data at (x, y). Does not check for uniqueness.
+	//
+	void insert(T data, float x, float y)
+	{
+		Bucket & b = buckets[findOrAdd(cellOf(x), cellOf(y))];
+		b.push_back(data, x, y);
+		++count;
+	}
+	void insert(const std::vector<T> & data, const std::vector<float> & x, const std::vector<float> & y)
+	{
+		PROFILE_SCOPE("SpatialHash::insert(bulk)");
+		if ((used + data.size()) * 2 > slots.size()) rehash(std::max(slots.size(), (used + data.size()) * 2));
+		for (size_t i = 0; i < data.size(); ++i)
+			insert(data[i], x[i], y[i]);
+	}
+
+	//
+	// erase
+	//
+	// Erases the first item equal to data in the cell holding (x, y).
+	//
+	bool erase(T data, float x, float y)
+	{
+		int32_t s = find(cellOf(x), cellOf(y));
+		if (s < 0) return false;
+		Bucket & b = buckets[slots[s].bucket];
+		for (size_t i = 0; i < b.data.size(); ++i)
+		{
+			if (b.data[i] == data)
+			{
+				b.erase(i);
+				--count;
+				if (b.data.empty()) removeSlot(s);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//
+	// move
+	//
+	// Moves data from (x1, y1) to (x2, y2): in place within a cell, else
+	// erase and insert. Returns true if the item was updated in place.
+	//
+	bool move(T data, float x1, float y1, float x2, float y2)
+	{
+		PROFILE_SCOPE("SpatialHash::move");
+		PROFILE_COUNT(QT_MOVES, 1);
+		int32_t cx1 = cellOf(x1), cy1 = cellOf(y1);
+		if (cx1 == cellOf(x2) && cy1 == cellOf(y2))
+		{
+			int32_t s = find(cx1, cy1);
+			if (s < 0) return false;
+			Bucket & b = buckets[slots[s].bucket];
+			for (size_t i = 0; i < b.data.size(); ++i)
+			{
+				if (b.data[i] == data)
+				{
+					b.x[i] = x2;
+					b.y[i] = y2;
+					return true;
+				}
+			}
+			return false;
+		}
+		PROFILE_COUNT(QT_REINSERTS, 1);
+		if (erase(data, x1, y1)) insert(data, x2, y2);
+		return false;
+	}
+
+	//
+	// queryRegion
+	//
+	// Pushes all items inside [x1, x2) x [y1, y2) into the vector and
+	// returns its size. Visits the cells the region overlaps, or every
+	// occupied cell when that is fewer.
+	//
+	int queryRegion(float x1, float y1, float x2, float y2, std::vector<T> & ret)
+	{
+		PROFILE_SCOPE("SpatialHash::queryRegion");
+		float xmin = std::min(x1,x2), xmax = std::max(x1,x2);
+		float ymin = std::min(y1,y2), ymax = std::max(y1,y2);
+		int32_t cx1 = cellOf(xmin), cx2 = cellOf(xmax);
+		int32_t cy1 = cellOf(ymin), cy2 = cellOf(ymax);
+
+		if (((double)cx2 - cx1 + 1) * ((double)cy2 - cy1 + 1) >= (double)used)
+		{
+			for (size_t s = 0; s < slots.size(); ++s)
+			{
+				if (slots[s].bucket >= 0)
+					filter(buckets[slots[s].bucket], xmin, ymin, xmax, ymax, ret);
+			}
+			return (int)ret.size();
+		}
+
+		for (int32_t cy = cy1; cy <= cy2; ++cy)
+		{
+			for (int32_t cx = cx1; cx <= cx2; ++cx)
+			{
+				int32_t s = find(cx, cy);
+				if (s >= 0) filter(buckets[slots[s].bucket], xmin, ymin, xmax, ymax, ret);
+			}
+		}
+		return (int)ret.size();
+	}
+
+	int getAllItems(std::vector<T> & ret)
+	{
+		ret.reserve(ret.size() + count);
+		for (size_t s = 0; s < slots.size(); ++s)
+		{
+			if (slots[s].bucket >= 0)
+			{
+				const Bucket & b = buckets[slots[s].bucket];
+				ret.insert(ret.end(), b.data.begin(), b.data.end());
+			}
+		}
+		return (int)ret.size();
+	}
+
+	int numItems()
+	{
+		return (int)count;
+	}
+
+	//
+	// numCells
+	//
+	// Occupied cells.
+	//
+	int numCells()
+	{
+		return (int)used;
+	}
+
+	bool accepts(float, float)
+	{
+		return true;
+	}
+
+	//
+	// eraseIf
+	//
+	// Erases every item (in the given region) for which pred(data) is true,
+	// and returns the number erased.
+	//
+	template<typename Pred>
+	int eraseIf(Pred pred)
+	{
+		PROFILE_SCOPE("SpatialHash::eraseIf");
+		return eraseEverywhere(pred, -HUGE_VALF, -HUGE_VALF, HUGE_VALF, HUGE_VALF);
+	}
+	template<typename Pred>
+	int eraseIf(Pred pred, float x1, float y1, float x2, float y2)
+	{
+		PROFILE_SCOPE("SpatialHash::eraseIf");
+		float xmin = std::min(x1,x2), xmax = std::max(x1,x2);
+		float ymin = std::min(y1,y2), ymax = std::max(y1,y2);
+		int32_t cx1 = cellOf(xmin), cx2 = cellOf(xmax);
+		int32_t cy1 = cellOf(ymin), cy2 = cellOf(ymax);
+		if (((double)cx2 - cx1 + 1) * ((double)cy2 - cy1 + 1) >= (double)used)
+			return eraseEverywhere(pred, xmin, ymin, xmax, ymax);
+
+		int deleted = 0;
+		for (int32_t cy = cy1; cy <= cy2; ++cy)
+		{
+			for (int32_t cx = cx1; cx <= cx2; ++cx)
+			{
+				int32_t s = find(cx, cy);
+				if (s < 0) continue;
+				deleted += eraseIf(pred, buckets[slots[s].bucket], xmin, ymin, xmax, ymax);
+				if (buckets[slots[s].bucket].data.empty()) removeSlot(s);
+			}
+		}
+		return deleted;
+	}
+
+	int eraseMatching(typename SpatialIndex<T>::Predicate & pred)
+	{
+		return eraseIf(typename SpatialIndex<T>::PredicateRef(pred));
+	}
+	int eraseMatching(typename SpatialIndex<T>::Predicate & pred, float x1, float y1, float x2, float y2)
+	{
+		return eraseIf(typename SpatialIndex<T>::PredicateRef(pred), x1, y1, x2, y2);
+	}
+
+	//
+	// clear
+	//
+	// Erases every item.
+	//
+	void clear()
+	{
+		slots.clear();
+		buckets.clear();
+		freeBuckets.clear();
+		count = 0;
+		rehash(16);
+	}
+
+	//
+	// bytes
+	//
+	// Table and bucket storage held (capacity).
+	//
+	size_t bytes()
+	{
+		size_t n = sizeof(*this) + slots.capacity() * sizeof(Slot) + buckets.capacity() * sizeof(Bucket)
+			+ freeBuckets.capacity() * sizeof(int32_t);
+		for (size_t i = 0; i < buckets.size(); ++i)
+			n += buckets[i].data.capacity() * sizeof(T) + (buckets[i].x.capacity() + buckets[i].y.capacity()) * sizeof(float);
+		return n;
+	}
+
+private:
+
+	//
+	// Bucket
+	//
+	// One cell's items as parallel arrays.
+	//
+	struct Bucket
+	{
+		void push_back(T d, float px, float py)
+		{
+			data.push_back(d);
+			x.push_back(px);
+			y.push_back(py);
+		}
+
+		// Swap with the last item; order within a cell does not matter
+		void erase(size_t i)
+		{
+			data[i] = data.back();
+			x[i] = x.back();
+			y[i] = y.back();
+			data.pop_back();
+			x.pop_back();
+			y.pop_back();
+		}
+
+		std::vector<T> data;
+		std::vector<float, AlignedAllocator<float> > x;
+		std::vector<float, AlignedAllocator<float> > y;
+	};
+
+	//
+	// Slot
+	//
+	// Hash table entry: a cell and its bucket, or bucket -1 when free.
+	//
+	struct Slot
+	{
+		int32_t cx;
+		int32_t cy;
+		int32_t bucket;
+	};
+
+	// Clamped so far-off (or infinite) coordinates share the edge cells
+	int32_t cellOf(float v)
+	{
+		float c = floorf(v * invCellSize);
+		return (int32_t)std::max(-1073741824.f, std::min(1073741824.f, c));
+	}
+
+	size_t slotOf(int32_t cx, int32_t cy)
+	{
+		uint64_t key = ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy;
+		return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+	}
+
+	int32_t find(int32_t cx, int32_t cy)
+	{
+		for (size_t s = slotOf(cx, cy);; s = (s + 1) & mask)
+		{
+			const Slot & slot = slots[s];
+			if (slot.bucket < 0) return -1;
+			if (slot.cx == cx && slot.cy == cy) return (int32_t)s;
+		}
+	}
+
+	int32_t findOrAdd(int32_t cx, int32_t cy)
+	{
+		size_t s = slotOf(cx, cy);
+		for (;; s = (s + 1) & mask)
+		{
+			Slot & slot = slots[s];
+			if (slot.bucket < 0) break;
+			if (slot.cx == cx && slot.cy == cy) return slot.bucket;
+		}
+
+		if ((used + 1) * 2 > slots.size())
+		{
+			rehash(slots.size() * 2);
+			return findOrAdd(cx, cy);
+		}
+
+		int32_t b;
+		if (!freeBuckets.empty())
+		{
+			b = freeBuckets.back();
+			freeBuckets.pop_back();
+		}
+		else
+		{
+			b = (int32_t)buckets.size();
+			buckets.resize(buckets.size() + 1);
+		}
+		slots[s].cx = cx;
+		slots[s].cy = cy;
+		slots[s].bucket = b;
+		++used;
+		return b;
+	}
+
+	//
+	// Frees slot s and its (empty) bucket, shifting later entries of the
+	// probe run back so lookups need no tombstones
+	//
+	void removeSlot(int32_t s)
+	{
+		freeBuckets.push_back(slots[s].bucket);
+		--used;
+
+		size_t hole = (size_t)s;
+		for (size_t i = (hole + 1) & mask; slots[i].bucket >= 0; i = (i + 1) & mask)
+		{
+			// Move i into the hole unless its home lies cyclically in (hole, i]
+			size_t home = slotOf(slots[i].cx, slots[i].cy);
+			if (((i - home) & mask) >= ((i - hole) & mask))
+			{
+				slots[hole] = slots[i];
+				hole = i;
+			}
+		}
+		slots[hole].bucket = -1;
+	}
+
+	//
+	// Rebuilds the table with at least size slots, dropping cells whose
+	// buckets have emptied
+	//
+	void rehash(size_t size)
+	{
+		size_t n = 16;
+		while (n < size) n *= 2;
+
+		std::vector<Slot> old;
+		old.swap(slots);
+		Slot empty = { 0, 0, -1 };
+		slots.assign(n, empty);
+		mask = n - 1;
+		used = 0;
+		for (size_t i = 0; i < old.size(); ++i)
+		{
+			if (old[i].bucket < 0) continue;
+			if (buckets[old[i].bucket].data.empty())
+			{
+				freeBuckets.push_back(old[i].bucket);
+				continue;
+			}
+			++used;
+			size_t s = slotOf(old[i].cx, old[i].cy);
+			while (slots[s].bucket >= 0) s = (s + 1) & mask;
+			slots[s] = old[i];
+		}
+	}
+
+	void filter(const Bucket & b, float xmin, float ymin, float xmax, float ymax, std::vector<T> & ret)
+	{
+		appendInRegion(b.data, b.x, b.y, xmin, ymin, xmax, ymax, ret);
+	}
+
+	//
+	// Erases matches in region from every cell; the table is rebuilt
+	// afterwards if cells emptied, since removing slots mid-walk would
+	// shift entries past the walk
+	//
+	template<typename Pred>
+	int eraseEverywhere(Pred & pred, float xmin, float ymin, float xmax, float ymax)
+	{
+		int deleted = 0;
+		bool emptied = false;
+		for (size_t s = 0; s < slots.size(); ++s)
+		{
+			if (slots[s].bucket < 0) continue;
+			Bucket & b = buckets[slots[s].bucket];
+			deleted += eraseIf(pred, b, xmin, ymin, xmax, ymax);
+			if (b.data.empty()) emptied = true;
+		}
+		if (emptied) rehash(slots.size());
+		return deleted;
+	}
+
+	template<typename Pred>
+	int eraseIf(Pred & pred, Bucket & b, float xmin, float ymin, float xmax, float ymax)
+	{
+		int deleted = 0;
+		size_t n = 0;
+		for (size_t i = 0; i < b.data.size(); ++i)
+		{
+			if (b.x[i] >= xmin && b.x[i] < xmax && b.y[i] >= ymin && b.y[i] < ymax && pred(b.data[i]))
+			{
+				++deleted;
+			}
+			else
+			{
+				b.data[n] = b.data[i];
+				b.x[n] = b.x[i];
+				b.y[n] = b.y[i];
+				++n;
+			}
+		}
+		b.data.resize(n);
+		b.x.resize(n);
+		b.y.resize(n);
+		count -= deleted;
+		return deleted;
+	}
+
+	float cellSize;
+	float invCellSize;
+	size_t count;
+	size_t used;				// occupied slots
+	size_t mask;
+	std::vector<Slot> slots;
+	std::vector<Bucket> buckets;
+	std::vector<int32_t> freeBuckets;
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+/*///=====================================================================
+
+	spatialindex.h
+
+	The point index interface Node and Edge keep their positions in, so
+	either a QuadTree or a SpatialHash can back them (Graph::setNodeIndex,
+	Graph::setEdgeIndex).
+
+	eraseIf takes any predicate functor, as QuadTree's does; through this
+	interface it is called once per visited item via a virtual call.
+
+*///======================================================================
+
+#include <vector>
+
+template<typename T>
+class SpatialIndex
+{
+public:
+
+	//
+	// Predicate
+	//
+	// Type-erased eraseIf predicate.
+	//
+	class Predicate
+	{
+	public:
+		virtual ~Predicate() {}
+		virtual bool operator()(T data) = 0;
+	};
+
+	virtual ~SpatialIndex() {}
+
+	//
+	// insert
+	//
+	// Inserts data at (x, y); bulk insert takes parallel arrays. Does not
+	// check for uniqueness.
+	//
+	virtual void insert(T data, float x, float y) = 0;
+	virtual void insert(const std::vector<T> & data, const std::vector<float> & x, const std::vector<float> & y) = 0;
+
+	//
+	// erase
+	//
+	// Erases the first item equal to data stored at (x, y), if any.
+	//
+	virtual bool erase(T data, float x, float y) = 0;
+
+	//
+	// move
+	//
+	// Moves data from (x1, y1) to (x2, y2).
+	//
+	virtual bool move(T data, float x1, float y1, float x2, float y2) = 0;
+
+	//
+	// queryRegion
+	//
+	// Pushes all items inside [x1, x2) x [y1, y2) (corners in any order)
+	// into the vector and returns its size.
+	//
+	virtual int queryRegion(float x1, float y1, float x2, float y2, std::vector<T> & ret) = 0;
+
+	virtual int getAllItems(std::vector<T> & ret) = 0;
+
+	virtual int numItems() = 0;
+
+	//
+	// accepts
+	//
+	// Whether an item may be inserted at (x, y).
+	//
+	virtual bool accepts(float x, float y) = 0;
+
+	//
+	// eraseIf
+	//
+	// Erases every item (in the given region) for which pred(data) is true,
+	// and returns the number erased.
+	//
+	template<typename Pred>
+	int eraseIf(Pred pred)
+	{
+		PredicateOf<Pred> p(pred);
+		return eraseMatching(p);
+	}
+	template<typename Pred>
+	int eraseIf(Pred pred, float x1, float y1, float x2, float y2)
+	{
+		PredicateOf<Pred> p(pred);
+		return eraseMatching(p, x1, y1, x2, y2);
+	}
+
+	virtual int eraseMatching(Predicate & pred) = 0;
+	virtual int eraseMatching(Predicate & pred, float x1, float y1, float x2, float y2) = 0;
+
+protected:
+
+	//
+	// PredicateRef
+	//
+	// Copyable functor calling a Predicate, for implementations whose own
+	// eraseIf takes predicates by value.
+	//
+	struct PredicateRef
+	{
+		explicit PredicateRef(Predicate & pred) : pred(&pred) {}
+		bool operator()(T data) { return (*pred)(data); }
+		Predicate * pred;
+	};
+
+private:
+
+	template<typename Pred>
+	class PredicateOf : public Predicate
+	{
+	public:
+		explicit PredicateOf(Pred & pred) : pred(pred) {}
+		bool operator()(T data) { return pred(data); }
+	private:
+		Pred & pred;
+	};
+};
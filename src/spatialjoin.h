@@ -0,0 +1,287 @@
+#pragma once
+
+/*///=====================================================================
+
+	spatialjoin.h
+
+	Self joins over the leaves of a QuadTree: every pair of items at most
+	r apart (radiusJoin), and every item with its k nearest others
+	(nearestJoin). Each leaf is joined against the leaves around it, so
+	the work per item is bounded by its neighborhood rather than the size
+	of the tree, and leaves are handed out to worker threads in small
+	batches. The tree is only read and must not be modified meanwhile.
+
+*///======================================================================
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "parallel.h"
+#include "quadtree.h"
+
+namespace spatialjoin
+{
+	// Leaves a worker takes at a time
+	enum { BATCH = 16 };
+
+	inline float sq(float v)
+	{
+		return v * v;
+	}
+
+	//
+	// Squared distance from a point to a leaf's bounds (0 inside)
+	//
+	template<typename Leaf>
+	float boxDistance2(const Leaf & l, float x, float y)
+	{
+		float dx = std::max(std::max(l.x1 - x, x - l.x2), 0.f);
+		float dy = std::max(std::max(l.y1 - y, y - l.y2), 0.f);
+		return dx*dx + dy*dy;
+	}
+
+	//
+	// Radius
+	//
+	// Pairs within r for a batch of leaves. A pair is found from the leaf
+	// whose items come first in memory (or, within one leaf, from the
+	// earlier item), so each unordered pair is reported once.
+	//
+	template<typename T>
+	struct Radius
+	{
+		typedef typename QuadTree<T>::Leaf Leaf;
+
+		Radius(QuadTree<T> & qt, const std::vector<Leaf> & leaves, float r, std::atomic<size_t> & next, std::vector<std::vector<std::pair<T, T> > > & out)
+			: qt(qt), leaves(leaves), r(r), next(next), out(out) {}
+
+		void operator()(unsigned int t) const
+		{
+			std::vector<std::pair<T, T> > & ret = out[t];
+			std::vector<Leaf> near;
+			std::less<const T*> before;
+			float r2 = r * r;
+			for (;;)
+			{
+				size_t first = next.fetch_add(BATCH);
+				if (first >= leaves.size()) break;
+				size_t last = std::min(first + BATCH, leaves.size());
+				for (size_t a = first; a < last; ++a)
+				{
+					const Leaf & A = leaves[a];
+					near.clear();
+					qt.getLeaves(A.x1 - r, A.y1 - r, A.x2 + r, A.y2 + r, near);
+					for (size_t i = 0; i < A.size; ++i)
+					{
+						float px = A.x[i], py = A.y[i];
+						for (size_t b = 0; b < near.size(); ++b)
+						{
+							const Leaf & B = near[b];
+							if (before(B.data, A.data)) continue;
+							if (boxDistance2(B, px, py) > r2) continue;
+							size_t j = B.data == A.data ? i + 1 : 0;
+							for (; j < B.size; ++j)
+							{
+								if (sq(B.x[j] - px) + sq(B.y[j] - py) <= r2)
+									ret.push_back(std::make_pair(A.data[i], B.data[j]));
+							}
+						}
+					}
+				}
+			}
+		}
+
+		QuadTree<T> & qt;
+		const std::vector<Leaf> & leaves;
+		float r;
+		std::atomic<size_t> & next;
+		std::vector<std::vector<std::pair<T, T> > > & out;
+	};
+
+	//
+	// Nearest
+	//
+	// k nearest others for the items of a batch of leaves. The leaves
+	// within R of a leaf are searched, R starting at the leaf's size and
+	// doubling, until every item's k-th nearest is within R (so nothing
+	// outside can be nearer) or the whole tree has been searched. Pairs are
+	// reported with the lesser item first, and may repeat.
+	//
+	template<typename T>
+	struct Nearest
+	{
+		typedef typename QuadTree<T>::Leaf Leaf;
+		typedef std::pair<float, T> Candidate; // squared distance, item
+
+		Nearest(QuadTree<T> & qt, const std::vector<Leaf> & leaves, unsigned int k, std::atomic<size_t> & next, std::vector<std::vector<std::pair<T, T> > > & out)
+			: qt(qt), leaves(leaves), k(k), next(next), out(out) {}
+
+		void operator()(unsigned int t) const
+		{
+			std::vector<std::pair<T, T> > & ret = out[t];
+			std::vector<Leaf> near;
+			std::vector<size_t> pending;
+			std::vector<size_t> left;
+			std::vector<Candidate> best;
+			std::less<T> less;
+			for (;;)
+			{
+				size_t first = next.fetch_add(BATCH);
+				if (first >= leaves.size()) break;
+				size_t last = std::min(first + BATCH, leaves.size());
+				for (size_t a = first; a < last; ++a)
+				{
+					const Leaf & A = leaves[a];
+					pending.clear();
+					for (size_t i = 0; i < A.size; ++i) pending.push_back(i);
+					float R = std::max(A.x2 - A.x1, A.y2 - A.y1);
+					while (!pending.empty())
+					{
+						near.clear();
+						qt.getLeaves(A.x1 - R, A.y1 - R, A.x2 + R, A.y2 + R, near);
+						bool everything = near.size() == leaves.size();
+						left.clear();
+						for (size_t p = 0; p < pending.size(); ++p)
+						{
+							size_t i = pending[p];
+							float px = A.x[i], py = A.y[i];
+							best.clear();
+							for (size_t b = 0; b < near.size(); ++b)
+							{
+								const Leaf & B = near[b];
+								if (best.size() == k && boxDistance2(B, px, py) >= best.front().first) continue;
+								for (size_t j = 0; j < B.size; ++j)
+								{
+									if (B.data == A.data && j == i) continue;
+									float d2 = sq(B.x[j] - px) + sq(B.y[j] - py);
+									if (best.size() < k)
+									{
+										best.push_back(Candidate(d2, B.data[j]));
+										std::push_heap(best.begin(), best.end(), Farther());
+									}
+									else if (d2 < best.front().first)
+									{
+										std::pop_heap(best.begin(), best.end(), Farther());
+										best.back() = Candidate(d2, B.data[j]);
+										std::push_heap(best.begin(), best.end(), Farther());
+									}
+								}
+							}
+							if (!everything && (best.size() < k || best.front().first > R * R))
+							{
+								left.push_back(i);
+								continue;
+							}
+							T n = A.data[i];
+							for (size_t c = 0; c < best.size(); ++c)
+							{
+								T o = best[c].second;
+								ret.push_back(less(n, o) ? std::make_pair(n, o) : std::make_pair(o, n));
+							}
+						}
+						pending.swap(left);
+						R *= 2;
+					}
+				}
+			}
+		}
+
+		// Max-heap order on distance
+		struct Farther
+		{
+			bool operator()(const Candidate & a, const Candidate & b) const { return a.first < b.first; }
+		};
+
+		QuadTree<T> & qt;
+		const std::vector<Leaf> & leaves;
+		unsigned int k;
+		std::atomic<size_t> & next;
+		std::vector<std::vector<std::pair<T, T> > > & out;
+	};
+
+	template<typename T>
+	void concat(std::vector<std::vector<std::pair<T, T> > > & parts, std::vector<std::pair<T, T> > & ret)
+	{
+		size_t n = ret.size();
+		for (size_t i = 0; i < parts.size(); ++i) n += parts[i].size();
+		ret.reserve(n);
+		for (size_t i = 0; i < parts.size(); ++i)
+		{
+			ret.insert(ret.end(), parts[i].begin(), parts[i].end());
+			std::vector<std::pair<T, T> >().swap(parts[i]);
+		}
+	}
+
+	template<typename T>
+	struct PairLess
+	{
+		bool operator()(const std::pair<T, T> & a, const std::pair<T, T> & b) const
+		{
+			std::less<T> less;
+			if (less(a.first, b.first)) return true;
+			if (less(b.first, a.first)) return false;
+			return less(a.second, b.second);
+		}
+	};
+}
+
+//
+// radiusJoin
+//
+// Appends every unordered pair of items in the tree at most r apart to
+// ret, once each. threads = 0 uses every hardware thread. Returns the
+// number of pairs appended.
+//
+template<typename T>
+size_t radiusJoin(QuadTree<T> & qt, float r, std::vector<std::pair<T, T> > & ret, unsigned int threads = 0)
+{
+	PROFILE_SCOPE("radiusJoin");
+	typedef typename QuadTree<T>::Leaf Leaf;
+	std::vector<Leaf> leaves;
+	qt.getLeaves(leaves);
+	if (leaves.empty() || r < 0) return 0;
+
+	if (threads == 0) threads = hardwareThreads();
+	std::vector<std::vector<std::pair<T, T> > > parts(threads);
+	std::atomic<size_t> next(0);
+	parallelRun(threads, spatialjoin::Radius<T>(qt, leaves, r, next, parts));
+
+	size_t before = ret.size();
+	spatialjoin::concat(parts, ret);
+	return ret.size() - before;
+}
+
+//
+// nearestJoin
+//
+// Appends, for every item in the tree, a pair with each of its k nearest
+// other items (ties broken arbitrarily) to ret. Pairs are unordered and
+// reported once each, even when both items are among the other's
+// nearest, so items may end up in more than k pairs. threads = 0 uses
+// every hardware thread. Returns the number of pairs appended.
+//
+template<typename T>
+size_t nearestJoin(QuadTree<T> & qt, unsigned int k, std::vector<std::pair<T, T> > & ret, unsigned int threads = 0)
+{
+	PROFILE_SCOPE("nearestJoin");
+	typedef typename QuadTree<T>::Leaf Leaf;
+	std::vector<Leaf> leaves;
+	qt.getLeaves(leaves);
+	if (leaves.empty() || k == 0) return 0;
+
+	if (threads == 0) threads = hardwareThreads();
+	std::vector<std::vector<std::pair<T, T> > > parts(threads);
+	std::atomic<size_t> next(0);
+	parallelRun(threads, spatialjoin::Nearest<T>(qt, leaves, k, next, parts));
+
+	// Mutual nearest neighbors are found from both ends
+	std::vector<std::pair<T, T> > pairs;
+	spatialjoin::concat(parts, pairs);
+	std::sort(pairs.begin(), pairs.end(), spatialjoin::PairLess<T>());
+	pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+	ret.insert(ret.end(), pairs.begin(), pairs.end());
+	return pairs.size();
+}
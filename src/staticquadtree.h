@@ -0,0 +1,656 @@
+#pragma once
+
+/*///=====================================================================
+
+	staticquadtree.h
+
+	A quad tree specialized at compile time on its leaf capacity, its
+	coordinate type and how items are stored, for point sets where the
+	general QuadTree's per-leaf heap vectors and chained bounds tests cost
+	too much.
+
+		StaticQuadTree<T, CAPACITY, Coord, Payload>
+
+	CAPACITY	items per leaf. Leaves are fixed arrays held in one pool,
+				so inserting and erasing never allocate per leaf. A full
+				leaf at the depth limit chains to an overflow leaf.
+	Coord		float, int32_t or Fixed<FRAC> (16.16 etc.); see CoordTraits.
+	Payload		how an item is kept in a leaf: ValuePayload<T> stores T
+				itself, SlabPayload<T*> stores the 32-bit slab index of a
+				Node/Edge-like object instead of the pointer. The tree
+				holds a copy of the policy, passed to its constructor, so
+				a policy may carry state (SlabPayload points at its slab).
+
+	Cells carry no bounds; they are derived on the way down. The child of
+	a cell holding a point is picked from two comparisons with the cell's
+	center, with no branches, and insert, erase and queryRegion walk the
+	tree with a loop and a fixed-size stack rather than recursion.
+
+	Bounds are half-open, [x1, x2) x [y1, y2), as in QuadTree.
+
+*///======================================================================
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "simd.h"
+#include "slab.h"
+
+//
+// Fixed
+//
+// Signed fixed-point number with FRAC fraction bits in an int32_t.
+//
+template<int FRAC>
+struct Fixed
+{
+	Fixed() : raw(0) {}
+	explicit Fixed(float f) : raw((int32_t)floorf(f * (float)(1 << FRAC) + 0.5f)) {}
+
+	static Fixed fromRaw(int32_t raw)
+	{
+		Fixed f;
+		f.raw = raw;
+		return f;
+	}
+
+	float toFloat() const
+	{
+		return raw / (float)(1 << FRAC);
+	}
+
+	bool operator<(Fixed rhs) const { return raw < rhs.raw; }
+	bool operator<=(Fixed rhs) const { return raw <= rhs.raw; }
+	bool operator>(Fixed rhs) const { return raw > rhs.raw; }
+	bool operator>=(Fixed rhs) const { return raw >= rhs.raw; }
+	bool operator==(Fixed rhs) const { return raw == rhs.raw; }
+	bool operator!=(Fixed rhs) const { return raw != rhs.raw; }
+
+	int32_t raw;
+};
+
+//
+// CoordTraits
+//
+// Conversions, cell centers and the leaf filter for a coordinate type.
+// filter writes the indices of the points inside [xmin, xmax) x
+// [ymin, ymax) to out, which must have room for n + 7 entries.
+//
+template<typename Coord>
+struct CoordTraits;
+
+template<>
+struct CoordTraits<float>
+{
+	static float fromFloat(float f) { return f; }
+	static float toFloat(float c) { return c; }
+	static float mid(float a, float b) { return a + (b - a) * 0.5f; }
+
+	static size_t filter(const float * x, const float * y, size_t n, float xmin, float ymin, float xmax, float ymax, uint32_t * out)
+	{
+		return filterRegion(x, y, n, xmin, ymin, xmax, ymax, out);
+	}
+};
+
+template<>
+struct CoordTraits<int32_t>
+{
+	static int32_t fromFloat(float f) { return (int32_t)floorf(f); }
+	static float toFloat(int32_t c) { return (float)c; }
+	static int32_t mid(int32_t a, int32_t b) { return a + (int32_t)(((int64_t)b - a) >> 1); }
+
+	static size_t filter(const int32_t * x, const int32_t * y, size_t n, int32_t xmin, int32_t ymin, int32_t xmax, int32_t ymax, uint32_t * out)
+	{
+		size_t k = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			out[k] = (uint32_t)i;
+			k += (x[i] >= xmin) & (x[i] < xmax) & (y[i] >= ymin) & (y[i] < ymax);
+		}
+		return k;
+	}
+};
+
+template<int FRAC>
+struct CoordTraits<Fixed<FRAC> >
+{
+	typedef Fixed<FRAC> Coord;
+
+	static Coord fromFloat(float f) { return Coord(f); }
+	static float toFloat(Coord c) { return c.toFloat(); }
+	static Coord mid(Coord a, Coord b) { return Coord::fromRaw(CoordTraits<int32_t>::mid(a.raw, b.raw)); }
+
+	static size_t filter(const Coord * x, const Coord * y, size_t n, Coord xmin, Coord ymin, Coord xmax, Coord ymax, uint32_t * out)
+	{
+		return CoordTraits<int32_t>::filter(&x->raw, &y->raw, n, xmin.raw, ymin.raw, xmax.raw, ymax.raw, out);
+	}
+};
+
+//
+// ValuePayload
+//
+// Stores the item itself. A payload policy packs and unpacks one item
+// and appends a leaf's worth to a result vector.
+//
+template<typename T>
+struct ValuePayload
+{
+	typedef T Stored;
+	Stored pack(const T & data) const { return data; }
+	T unpack(const Stored & s) const { return s; }
+	void append(const Stored * s, size_t n, std::vector<T> & ret) const { ret.insert(ret.end(), s, s + n); }
+};
+
+//
+// SlabPayload
+//
+// For pointers to objects in a Slab with a public id (their slab index),
+// such as a Graph's nodes and edges: stores the 32-bit index instead of
+// the pointer and resolves it through the slab it was built with. The
+// slab must outlive the tree, and relocating it invalidates the tree.
+//
+template<typename T>
+struct SlabPayload;
+
+template<typename U>
+struct SlabPayload<U*>
+{
+	typedef uint32_t Stored;
+	explicit SlabPayload(const Slab<U> & slab) : slab(&slab) {}
+	Stored pack(U * data) const { return data->id; }
+	U * unpack(Stored s) const { return slab->at(s); }
+	void append(const Stored * s, size_t n, std::vector<U*> & ret) const { for (size_t i = 0; i < n; ++i) ret.push_back(unpack(s[i])); }
+	const Slab<U> * slab;
+};
+
+template<typename T, int CAPACITY = 8, typename Coord = float, typename Payload = ValuePayload<T> >
+class StaticQuadTree
+{
+public:
+
+	typedef CoordTraits<Coord> Traits;
+	typedef typename Payload::Stored Stored;
+
+	// Deepest supported tree; bounds the traversal stacks
+	enum { DEPTH_LIMIT = 30 };
+
+	//
+	// StaticQuadTree
+	//
+	// An empty tree over the given bounds. Leaves at maxDepth no longer
+	// split; they chain overflow leaves instead. Items are packed and
+	// unpacked through payload.
+	//
+	StaticQuadTree(Coord x1, Coord y1, Coord x2, Coord y2, int maxDepth = 16, const Payload & payload = Payload())
+		: payload(payload), x0(std::min(x1,x2)), y0(std::min(y1,y2)), x1(std::max(x1,x2)), y1(std::max(y1,y2)),
+		  maxDepth(std::min(maxDepth, (int)DEPTH_LIMIT)), count(0)
+	{
+		clear();
+	}
+
+	//
+	// clear
+	//
+	// Erases every item. Pool storage is kept for reuse.
+	//
+	void clear()
+	{
+		cells.clear();
+		leaves.clear();
+		freeCells.clear();
+		freeLeaves.clear();
+		cells.push_back(~allocLeaf());
+		count = 0;
+	}
+
+	//
+	// insert
+	//
+	// Inserts data at (x, y). Does not check for uniqueness.
+	//
+	void insert(T data, Coord x, Coord y)
+	{
+		if (!contains(x, y))
+			assert(!"StaticQuadTree::insert: bounds");
+
+		Box b = { x0, y0, x1, y1 };
+		int32_t cell = 0;
+		int depth = 0;
+		for (;;)
+		{
+			int32_t c = cells[cell];
+			if (c >= 0)
+			{
+				cell = c + b.child(x, y);
+				++depth;
+				continue;
+			}
+
+			int32_t l = ~c;
+			if (leaves[l].count < CAPACITY)
+			{
+				leaves[l].push(payload.pack(data), x, y);
+				break;
+			}
+			if (depth < maxDepth)
+			{
+				split(cell, b);
+				continue;
+			}
+
+			// At the depth limit: append to the chain
+			while (leaves[l].next >= 0 && leaves[l].count == CAPACITY) l = leaves[l].next;
+			if (leaves[l].count == CAPACITY)
+			{
+				int32_t n = allocLeaf();
+				leaves[l].next = n;
+				l = n;
+			}
+			leaves[l].push(payload.pack(data), x, y);
+			break;
+		}
+		++count;
+	}
+
+	//
+	// erase
+	//
+	// Erases the first item at the leaf holding (x, y) that equals data.
+	// Cells whose children together fall to half a leaf are unified.
+	//
+	bool erase(T data, Coord x, Coord y)
+	{
+		if (!contains(x, y)) return false;
+
+		int32_t path[DEPTH_LIMIT + 1];
+		int depth = 0;
+		Box b = { x0, y0, x1, y1 };
+		int32_t cell = 0;
+		while (cells[cell] >= 0)
+		{
+			path[depth++] = cell;
+			cell = cells[cell] + b.child(x, y);
+		}
+
+		if (!eraseFromChain(~cells[cell], payload.pack(data))) return false;
+		--count;
+
+		// Unify bottom up
+		while (depth > 0)
+		{
+			if (!tryUnify(path[--depth])) break;
+		}
+		return true;
+	}
+
+	//
+	// move
+	//
+	// Moves data from (x1, y1) to (x2, y2). Within one leaf the item is
+	// updated in place; otherwise it is erased and reinserted. Returns
+	// false if the item was not found at (x1, y1).
+	//
+	bool move(T data, Coord fromX, Coord fromY, Coord toX, Coord toY)
+	{
+		if (!contains(fromX, fromY)) return false;
+
+		Box b = { x0, y0, x1, y1 };
+		int32_t cell = 0;
+		while (cells[cell] >= 0)
+			cell = cells[cell] + b.child(fromX, fromY);
+
+		if (b.contains(toX, toY))
+		{
+			Stored s = payload.pack(data);
+			for (int32_t l = ~cells[cell]; l >= 0; l = leaves[l].next)
+			{
+				Leaf & leaf = leaves[l];
+				for (uint32_t i = 0; i < leaf.count; ++i)
+				{
+					if (leaf.data[i] == s && leaf.x[i] == fromX && leaf.y[i] == fromY)
+					{
+						leaf.x[i] = toX;
+						leaf.y[i] = toY;
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		if (!erase(data, fromX, fromY)) return false;
+		insert(data, toX, toY);
+		return true;
+	}
+
+	//
+	// queryRegion
+	//
+	// Pushes all items inside [x1, x2) x [y1, y2) into the vector and
+	// returns its size.
+	//
+	int queryRegion(Coord qx1, Coord qy1, Coord qx2, Coord qy2, std::vector<T> & ret) const
+	{
+		Box q = { std::min(qx1,qx2), std::min(qy1,qy2), std::max(qx1,qx2), std::max(qy1,qy2) };
+
+		Frame stack[3 * DEPTH_LIMIT + 4];
+		int top = 0;
+		Box root = { x0, y0, x1, y1 };
+		if (root.intersects(q))
+		{
+			Frame f = { 0, root, q.contains(root) };
+			stack[top++] = f;
+		}
+
+		uint32_t idx[CAPACITY + 7];
+		while (top > 0)
+		{
+			Frame f = stack[--top];
+			int32_t c = cells[f.cell];
+			if (c >= 0)
+			{
+				for (int i = 0; i < 4; ++i)
+				{
+					Frame g = { c + i, f.box.quadrant(i), f.inside };
+					if (g.inside || g.box.intersects(q))
+					{
+						g.inside = g.inside || q.contains(g.box);
+						stack[top++] = g;
+					}
+				}
+				continue;
+			}
+
+			for (int32_t l = ~c; l >= 0; l = leaves[l].next)
+			{
+				const Leaf & leaf = leaves[l];
+				if (f.inside)
+				{
+					payload.append(leaf.data, leaf.count, ret);
+				}
+				else
+				{
+					size_t k = Traits::filter(leaf.x, leaf.y, leaf.count, q.x0, q.y0, q.x1, q.y1, idx);
+					for (size_t i = 0; i < k; ++i)
+						ret.push_back(payload.unpack(leaf.data[idx[i]]));
+				}
+			}
+		}
+		return (int)ret.size();
+	}
+
+	//
+	// getAllItems
+	//
+	// Pushes every item into the vector and returns its size.
+	//
+	int getAllItems(std::vector<T> & ret) const
+	{
+		ret.reserve(ret.size() + count);
+		for (size_t l = 0; l < leaves.size(); ++l)
+			payload.append(leaves[l].data, leaves[l].count, ret);
+		return (int)ret.size();
+	}
+
+	bool contains(Coord x, Coord y) const
+	{
+		return !(x < x0) && x < x1 && !(y < y0) && y < y1;
+	}
+
+	int numItems() const
+	{
+		return (int)count;
+	}
+
+	//
+	// numCells
+	//
+	// Cells in use, internal and leaf; overflow leaves are not cells.
+	//
+	int numCells() const
+	{
+		return (int)(cells.size() - freeCells.size() * 4);
+	}
+
+	int numLeaves() const
+	{
+		return (int)(leaves.size() - freeLeaves.size());
+	}
+
+	int getMaxDepth() const
+	{
+		return maxDepth;
+	}
+
+	//
+	// bytes
+	//
+	// Pool storage held, in use or free.
+	//
+	size_t bytes() const
+	{
+		return sizeof(*this) + cells.capacity() * sizeof(int32_t) + leaves.capacity() * sizeof(Leaf)
+			+ (freeCells.capacity() + freeLeaves.capacity()) * sizeof(int32_t);
+	}
+
+	static Coord coord(float f)
+	{
+		return Traits::fromFloat(f);
+	}
+
+private:
+
+	//
+	// Leaf
+	//
+	// Up to CAPACITY items as parallel arrays, and the next leaf of an
+	// overflow chain or -1.
+	//
+	struct Leaf
+	{
+		Coord x[CAPACITY];
+		Coord y[CAPACITY];
+		Stored data[CAPACITY];
+		uint32_t count;
+		int32_t next;
+
+		void push(Stored s, Coord px, Coord py)
+		{
+			data[count] = s;
+			x[count] = px;
+			y[count] = py;
+			++count;
+		}
+	};
+
+	//
+	// Box
+	//
+	// Bounds of a cell as it is walked, [x0, x1) x [y0, y1).
+	//
+	struct Box
+	{
+		Coord x0, y0, x1, y1;
+
+		// Quadrant of (x, y): bit 0 is x >= center, bit 1 is y >= center.
+		// Narrows the box to it.
+		int child(Coord x, Coord y)
+		{
+			Coord cx = Traits::mid(x0, x1);
+			Coord cy = Traits::mid(y0, y1);
+			int qx = !(x < cx);
+			int qy = !(y < cy);
+			x0 = qx ? cx : x0;
+			x1 = qx ? x1 : cx;
+			y0 = qy ? cy : y0;
+			y1 = qy ? y1 : cy;
+			return qx | (qy << 1);
+		}
+
+		Box quadrant(int i) const
+		{
+			Coord cx = Traits::mid(x0, x1);
+			Coord cy = Traits::mid(y0, y1);
+			Box b = { (i & 1) ? cx : x0, (i & 2) ? cy : y0, (i & 1) ? x1 : cx, (i & 2) ? y1 : cy };
+			return b;
+		}
+
+		bool contains(Coord x, Coord y) const
+		{
+			return !(x < x0) && x < x1 && !(y < y0) && y < y1;
+		}
+
+		bool contains(const Box & b) const
+		{
+			return x0 <= b.x0 && y0 <= b.y0 && b.x1 <= x1 && b.y1 <= y1;
+		}
+
+		bool intersects(const Box & b) const
+		{
+			return x0 < b.x1 && b.x0 < x1 && y0 < b.y1 && b.y0 < y1;
+		}
+	};
+
+	struct Frame
+	{
+		int32_t cell;
+		Box box;
+		bool inside; // box lies within the query
+	};
+
+	int32_t allocLeaf()
+	{
+		int32_t l;
+		if (!freeLeaves.empty())
+		{
+			l = freeLeaves.back();
+			freeLeaves.pop_back();
+		}
+		else
+		{
+			l = (int32_t)leaves.size();
+			leaves.resize(leaves.size() + 1);
+		}
+		leaves[l].count = 0;
+		leaves[l].next = -1;
+		return l;
+	}
+
+	// Free leaves stay in the pool, empty, so getAllItems can scan it
+	void freeLeaf(int32_t l)
+	{
+		leaves[l].count = 0;
+		leaves[l].next = -1;
+		freeLeaves.push_back(l);
+	}
+
+	// Four consecutive cells; returns the first
+	int32_t allocCells()
+	{
+		if (!freeCells.empty())
+		{
+			int32_t c = freeCells.back();
+			freeCells.pop_back();
+			return c;
+		}
+		int32_t c = (int32_t)cells.size();
+		cells.resize(cells.size() + 4);
+		return c;
+	}
+
+	void split(int32_t cell, Box b)
+	{
+		int32_t l = ~cells[cell];
+		Leaf old = leaves[l];
+		freeLeaf(l);
+
+		int32_t first = allocCells();
+		for (int i = 0; i < 4; ++i) cells[first + i] = ~allocLeaf();
+		cells[cell] = first;
+
+		for (uint32_t i = 0; i < old.count; ++i)
+		{
+			Box cb = b;
+			int32_t child = first + cb.child(old.x[i], old.y[i]);
+			leaves[~cells[child]].push(old.data[i], old.x[i], old.y[i]);
+		}
+	}
+
+	// Removes s from the chain headed by head, refilling the hole from the
+	// chain's last leaf, which is dropped when it empties.
+	bool eraseFromChain(int32_t head, Stored s)
+	{
+		int32_t l = head;
+		uint32_t i = 0;
+		for (; l >= 0; l = leaves[l].next)
+		{
+			for (i = 0; i < leaves[l].count; ++i)
+				if (leaves[l].data[i] == s) break;
+			if (i < leaves[l].count) break;
+		}
+		if (l < 0) return false;
+
+		int32_t prev = -1;
+		int32_t last = head;
+		while (leaves[last].next >= 0)
+		{
+			prev = last;
+			last = leaves[last].next;
+		}
+
+		Leaf & from = leaves[last];
+		uint32_t j = --from.count;
+		leaves[l].data[i] = from.data[j];
+		leaves[l].x[i] = from.x[j];
+		leaves[l].y[i] = from.y[j];
+
+		if (from.count == 0 && prev >= 0)
+		{
+			leaves[prev].next = -1;
+			freeLeaf(last);
+		}
+		return true;
+	}
+
+	// Collapses cell's four children into one leaf if they are all
+	// unchained leaves holding at most half a leaf together
+	bool tryUnify(int32_t cell)
+	{
+		int32_t first = cells[cell];
+		uint32_t total = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			int32_t c = cells[first + i];
+			if (c >= 0 || leaves[~c].next >= 0) return false;
+			total += leaves[~c].count;
+		}
+		if (total > CAPACITY / 2) return false;
+
+		int32_t l = ~cells[first];
+		for (int i = 1; i < 4; ++i)
+		{
+			int32_t m = ~cells[first + i];
+			for (uint32_t j = 0; j < leaves[m].count; ++j)
+				leaves[l].push(leaves[m].data[j], leaves[m].x[j], leaves[m].y[j]);
+			freeLeaf(m);
+		}
+		freeCells.push_back(first);
+		cells[cell] = ~l;
+		return true;
+	}
+
+	Payload payload;
+	Coord x0, y0, x1, y1;
+	int maxDepth;
+	size_t count;
+
+	// cells[i] >= 0: first of the cell's four children in cells, ordered by
+	// quadrant bits; cells[i] < 0: the cell is a leaf, ~cells[i] in leaves.
+	std::vector<int32_t> cells;
+	std::vector<Leaf> leaves;
+	std::vector<int32_t> freeCells;
+	std::vector<int32_t> freeLeaves;
+};
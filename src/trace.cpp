@@ -0,0 +1,152 @@
+#include "trace.h"
+
+#include <fstream>
+#include <sstream>
+
+EventTrace::EventTrace()
+	: width(0), height(0)
+{
+}
+
+void EventTrace::setSize(unsigned int width, unsigned int height)
+{
+	this->width = width;
+	this->height = height;
+}
+
+unsigned int EventTrace::getWidth() const
+{
+	return width;
+}
+
+unsigned int EventTrace::getHeight() const
+{
+	return height;
+}
+
+void EventTrace::record(const sf::Event & event, uint32_t frame, int64_t time)
+{
+	Record r;
+	r.frame = frame;
+	r.time = time;
+	r.event = event;
+	records.push_back(r);
+}
+
+const std::vector<EventTrace::Record> & EventTrace::getRecords() const
+{
+	return records;
+}
+
+void EventTrace::clear()
+{
+	records.clear();
+}
+
+bool EventTrace::save(const std::string & path) const
+{
+	std::ofstream out(path.c_str());
+	if (!out) return false;
+
+	out << "GRAPHTRACE 1 " << width << " " << height << "\n";
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		const Record & r = records[i];
+		const sf::Event & e = r.event;
+		out << r.frame << " " << r.time << " " << (int)e.type;
+		switch (e.type)
+		{
+		case sf::Event::KeyPressed:
+		case sf::Event::KeyReleased:
+			out << " " << (int)e.key.code << " " << e.key.alt << " " << e.key.control << " " << e.key.shift << " " << e.key.system;
+			break;
+		case sf::Event::MouseButtonPressed:
+		case sf::Event::MouseButtonReleased:
+			out << " " << (int)e.mouseButton.button << " " << e.mouseButton.x << " " << e.mouseButton.y;
+			break;
+		case sf::Event::MouseMoved:
+			out << " " << e.mouseMove.x << " " << e.mouseMove.y;
+			break;
+		case sf::Event::MouseWheelMoved:
+			out << " " << e.mouseWheel.delta << " " << e.mouseWheel.x << " " << e.mouseWheel.y;
+			break;
+		case sf::Event::Resized:
+			out << " " << e.size.width << " " << e.size.height;
+			break;
+		case sf::Event::TextEntered:
+			out << " " << e.text.unicode;
+			break;
+		default:
+			break;
+		}
+		out << "\n";
+	}
+	return (bool)out;
+}
+
+bool EventTrace::load(const std::string & path)
+{
+	std::ifstream in(path.c_str());
+	if (!in) return false;
+
+	std::string magic;
+	int version = 0;
+	in >> magic >> version >> width >> height;
+	if (!in || magic != "GRAPHTRACE" || version != 1) return false;
+
+	records.clear();
+	std::string line;
+	std::getline(in, line);
+	while (std::getline(in, line))
+	{
+		std::istringstream ss(line);
+		Record r;
+		int type = -1;
+		if (!(ss >> r.frame >> r.time >> type) || type < 0 || type >= sf::Event::Count) continue;
+
+		sf::Event & e = r.event;
+		e.type = (sf::Event::EventType)type;
+		int a = 0, b = 0, c = 0;
+		bool alt = false, control = false, shift = false, system = false;
+		switch (e.type)
+		{
+		case sf::Event::KeyPressed:
+		case sf::Event::KeyReleased:
+			if (!(ss >> a >> alt >> control >> shift >> system)) continue;
+			e.key.code = (sf::Keyboard::Key)a;
+			e.key.alt = alt;
+			e.key.control = control;
+			e.key.shift = shift;
+			e.key.system = system;
+			break;
+		case sf::Event::MouseButtonPressed:
+		case sf::Event::MouseButtonReleased:
+			if (!(ss >> a >> b >> c)) continue;
+			e.mouseButton.button = (sf::Mouse::Button)a;
+			e.mouseButton.x = b;
+			e.mouseButton.y = c;
+			break;
+		case sf::Event::MouseMoved:
+			if (!(ss >> a >> b)) continue;
+			e.mouseMove.x = a;
+			e.mouseMove.y = b;
+			break;
+		case sf::Event::MouseWheelMoved:
+			if (!(ss >> a >> b >> c)) continue;
+			e.mouseWheel.delta = a;
+			e.mouseWheel.x = b;
+			e.mouseWheel.y = c;
+			break;
+		case sf::Event::Resized:
+			if (!(ss >> e.size.width >> e.size.height)) continue;
+			break;
+		case sf::Event::TextEntered:
+			if (!(ss >> e.text.unicode)) continue;
+			break;
+		default:
+			break;
+		}
+		records.push_back(r);
+	}
+	return true;
+}
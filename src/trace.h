@@ -0,0 +1,75 @@
+#pragma once
+
+/*///=====================================================================
+
+	trace.h
+
+	A recorded stream of sf::Events, each with the frame it was polled in
+	and its time in microseconds since recording started, for replaying an
+	editing session through Editor::handleEvent without a window.
+
+	Text file format:
+
+		GRAPHTRACE 1 <width> <height>
+		<frame> <time> <type> <fields...>
+
+	where type is the sf::Event::EventType value and the fields are those
+	of the event's member for that type (key: code alt control shift
+	system; mouseButton: button x y; mouseMove: x y; mouseWheel: delta x y;
+	size: width height; text: unicode).
+
+*///======================================================================
+
+#include <SFML/Graphics.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class EventTrace
+{
+public:
+
+	struct Record
+	{
+		uint32_t frame;
+		int64_t time;
+		sf::Event event;
+	};
+
+	EventTrace();
+
+	//
+	// setSize
+	//
+	// Size of the window the trace was recorded in; the replay creates its
+	// editor with the same size.
+	//
+	void setSize(unsigned int width, unsigned int height);
+
+	unsigned int getWidth() const;
+
+	unsigned int getHeight() const;
+
+	void record(const sf::Event & event, uint32_t frame, int64_t time);
+
+	const std::vector<Record> & getRecords() const;
+
+	void clear();
+
+	bool save(const std::string & path) const;
+
+	//
+	// load
+	//
+	// Replaces the trace with the one in the file. Returns false if the
+	// file cannot be read or is not a trace; lines that cannot be parsed
+	// are skipped.
+	//
+	bool load(const std::string & path);
+
+private:
+
+	unsigned int width;
+	unsigned int height;
+	std::vector<Record> records;
+};
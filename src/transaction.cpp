@@ -0,0 +1,243 @@
+#include "transaction.h"
+#include "node.h"
+#include "edge.h"
+#include "graph.h"
+#include "profiler.h"
+
+#include <float.h>
+
+namespace
+{
+	struct Bounds
+	{
+		Bounds() : xmin(FLT_MAX), ymin(FLT_MAX), xmax(-FLT_MAX), ymax(-FLT_MAX) {}
+		void add(float x, float y)
+		{
+			if (x < xmin) xmin = x;
+			if (y < ymin) ymin = y;
+			if (x > xmax) xmax = x;
+			if (y > ymax) ymax = y;
+		}
+		bool empty() const { return xmin > xmax; }
+		float xmin, ymin, xmax, ymax;
+	};
+}
+
+//
+// Matches indexed (not created) objects with any of the given state bits
+//
+struct Transaction::HasState
+{
+	HasState(const std::vector<unsigned char> & states, unsigned char mask) : states(states), mask(mask) {}
+	template<typename T>
+	bool operator()(T t) const
+	{
+		return t->id < states.size() && (states[t->id] & mask) && !(states[t->id] & CREATED);
+	}
+	const std::vector<unsigned char> & states;
+	unsigned char mask;
+};
+
+Transaction::Transaction(Graph & graph) : graph(graph), open(true)
+{
+	if (graph.transaction)
+		assert(!"Transaction::Transaction: already open");
+	graph.transaction = this;
+}
+
+Transaction::~Transaction()
+{
+	if (open) rollback();
+}
+
+void Transaction::commit()
+{
+	if (!open) return;
+	PROFILE_SCOPE("Transaction::commit");
+
+	// Close first so the calls below take their normal, immediate paths
+	graph.transaction = 0;
+
+	//
+	// Nodes
+	//
+
+	// Moved nodes leave the quadtree in one pass, pruned to the bounds of
+	// their indexed (pre-transaction) positions...
+	if (graph.nodeIndex && !movedNodes.empty())
+	{
+		Bounds b;
+		for (size_t i = 0; i < movedNodes.size(); ++i)
+			b.add(movedNodes[i].x, movedNodes[i].y);
+		graph.nodeIndex->eraseIf(HasState(nodeStates, MOVED), b.xmin-1, b.ymin-1, b.xmax+1, b.ymax+1);
+	}
+
+	// ...and come back with the created ones in one bulk insert
+	std::vector<Node*> nodes;
+	std::vector<float> xs;
+	std::vector<float> ys;
+	nodes.reserve(movedNodes.size() + createdNodes.size());
+	for (size_t i = 0; i < movedNodes.size(); ++i)
+		nodes.push_back(movedNodes[i].n);
+	nodes.insert(nodes.end(), createdNodes.begin(), createdNodes.end());
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		xs.push_back(nodes[i]->x);
+		ys.push_back(nodes[i]->y);
+	}
+	if (graph.nodeIndex) graph.nodeIndex->insert(nodes, xs, ys);
+	if (graph.nset) graph.nset->insert(createdNodes.begin(), createdNodes.end());
+
+	//
+	// Edges
+	//
+
+	// Dirty and destroyed edges that were indexed leave the quadtree in one
+	// pass, pruned the same way (their geometry is still the indexed one)
+	if (graph.edgeIndex && (!dirtyEdges.empty() || !destroyedEdges.empty()))
+	{
+		Bounds b;
+		for (size_t i = 0; i < dirtyEdges.size(); ++i)
+			b.add(dirtyEdges[i]->srect.getPosition().x, dirtyEdges[i]->srect.getPosition().y);
+		for (size_t i = 0; i < destroyedEdges.size(); ++i)
+		{
+			if (!(edgeState(destroyedEdges[i]->id) & CREATED))
+				b.add(destroyedEdges[i]->srect.getPosition().x, destroyedEdges[i]->srect.getPosition().y);
+		}
+		if (!b.empty())
+			graph.edgeIndex->eraseIf(HasState(edgeStates, DIRTY | DESTROYED), b.xmin-1, b.ymin-1, b.xmax+1, b.ymax+1);
+	}
+
+	// Destroyed edges are freed
+	for (size_t i = 0; i < destroyedEdges.size(); ++i)
+	{
+		Edge * e = destroyedEdges[i];
+		if (graph.eset && !(edgeState(e->id) & CREATED)) graph.eset->erase(e);
+		Edge::free(e);
+	}
+
+	// Dirty and created edges that survived are laid out once and inserted
+	std::vector<Edge*> edges;
+	xs.clear();
+	ys.clear();
+	for (size_t i = 0; i < dirtyEdges.size(); ++i)
+	{
+		if (!(edgeState(dirtyEdges[i]->id) & DESTROYED)) edges.push_back(dirtyEdges[i]);
+	}
+	size_t firstCreated = edges.size();
+	for (size_t i = 0; i < createdEdges.size(); ++i)
+	{
+		if (!(edgeState(createdEdges[i]->id) & DESTROYED)) edges.push_back(createdEdges[i]);
+	}
+	for (size_t i = 0; i < edges.size(); ++i)
+	{
+		edges[i]->layout();
+		xs.push_back(edges[i]->srect.getPosition().x);
+		ys.push_back(edges[i]->srect.getPosition().y);
+	}
+	if (graph.edgeIndex) graph.edgeIndex->insert(edges, xs, ys);
+	if (graph.eset) graph.eset->insert(edges.begin() + firstCreated, edges.end());
+
+	close();
+}
+
+void Transaction::rollback()
+{
+	if (!open) return;
+
+	graph.transaction = 0;
+
+	// Created edges go away (destroyed ones are already detached)
+	for (size_t i = 0; i < createdEdges.size(); ++i)
+	{
+		Edge * e = createdEdges[i];
+		if (!(edgeState(e->id) & DESTROYED)) e->detach();
+		Edge::free(e);
+	}
+
+	// Destroyed edges that existed before are reattached; they never left
+	// the edge set or quadtree
+	for (size_t i = destroyedEdges.size(); i-- > 0;)
+	{
+		Edge * e = destroyedEdges[i];
+		if (!(edgeState(e->id) & CREATED)) e->attach();
+	}
+
+	// Moved nodes go back; their edges' geometry was never touched
+	for (size_t i = 0; i < movedNodes.size(); ++i)
+	{
+		Node * n = movedNodes[i].n;
+		n->x = movedNodes[i].x;
+		n->y = movedNodes[i].y;
+		n->circ.setPosition(n->x-5, n->y-5);
+	}
+
+	// Created nodes have lost all their edges by now
+	for (size_t i = 0; i < createdNodes.size(); ++i)
+		Node::free(createdNodes[i]);
+
+	close();
+}
+
+bool Transaction::isOpen() const
+{
+	return open;
+}
+
+void Transaction::nodeCreated(Node * n)
+{
+	nodeState(n->id) |= CREATED;
+	createdNodes.push_back(n);
+}
+
+void Transaction::nodeMoved(Node * n)
+{
+	unsigned char & state = nodeState(n->id);
+	if (state & (CREATED | MOVED)) return;
+	state |= MOVED;
+	movedNodes.push_back(Move(n, n->x, n->y));
+}
+
+void Transaction::edgeCreated(Edge * e)
+{
+	edgeState(e->id) |= CREATED;
+	createdEdges.push_back(e);
+}
+
+void Transaction::edgeDirty(Edge * e)
+{
+	unsigned char & state = edgeState(e->id);
+	if (state & (CREATED | DIRTY)) return;
+	state |= DIRTY;
+	dirtyEdges.push_back(e);
+}
+
+void Transaction::edgeDestroyed(Edge * e)
+{
+	edgeState(e->id) |= DESTROYED;
+	destroyedEdges.push_back(e);
+}
+
+unsigned char & Transaction::nodeState(unsigned int id)
+{
+	if (id >= nodeStates.size()) nodeStates.resize(graph.nodes.capacity(), 0);
+	return nodeStates[id];
+}
+
+unsigned char & Transaction::edgeState(unsigned int id)
+{
+	if (id >= edgeStates.size()) edgeStates.resize(graph.edges.capacity(), 0);
+	return edgeStates[id];
+}
+
+void Transaction::close()
+{
+	open = false;
+	createdNodes.clear();
+	movedNodes.clear();
+	createdEdges.clear();
+	dirtyEdges.clear();
+	destroyedEdges.clear();
+	nodeStates.clear();
+	edgeStates.clear();
+}
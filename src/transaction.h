@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+
+class Node;
+class Edge;
+class Graph;
+
+//
+// Transaction
+//
+// Batches graph edits. While a transaction is open, node creation and
+// moves and edge creation and destruction take effect on the nodes and
+// their adjacency (and the edge map) immediately, but the node/edge sets
+// and quadtrees are left alone and edge geometry is not recomputed. On
+// commit the indexes are brought up to date at once through the bulk
+// quadtree paths. Rollback restores the graph as it was when the
+// transaction began.
+//
+// Queries against the quadtrees see the pre-transaction state until the
+// transaction commits. Destroying nodes is not supported inside a
+// transaction. Only one transaction may be open on a graph at a time; one
+// that is neither committed nor rolled back is rolled back when destroyed.
+// The graph must outlive it.
+//
+class Transaction
+{
+	friend class Node;
+	friend class Edge;
+
+public:
+
+	Transaction(Graph & graph);
+
+	~Transaction();
+
+	void commit();
+
+	void rollback();
+
+	bool isOpen() const;
+
+private:
+
+	Transaction(const Transaction &);
+	Transaction & operator=(const Transaction &);
+
+	enum
+	{
+		CREATED = 1,
+		MOVED = 2,
+		DIRTY = 4,
+		DESTROYED = 8
+	};
+
+	struct HasState;
+
+	struct Move
+	{
+		Move(Node * n, float x, float y) : n(n), x(x), y(y) {}
+		Node * n;
+		float x; // position when the transaction began
+		float y;
+	};
+
+	void nodeCreated(Node * n);
+	void nodeMoved(Node * n);
+	void edgeCreated(Edge * e);
+	void edgeDirty(Edge * e);
+	void edgeDestroyed(Edge * e);
+
+	unsigned char & nodeState(unsigned int id);
+	unsigned char & edgeState(unsigned int id);
+
+	void close();
+
+	Graph & graph;
+	bool open;
+	std::vector<Node*> createdNodes;
+	std::vector<Move> movedNodes;
+	std::vector<Edge*> createdEdges;
+	std::vector<Edge*> dirtyEdges;
+	std::vector<Edge*> destroyedEdges;
+	std::vector<unsigned char> nodeStates; // indexed by Node::id
+	std::vector<unsigned char> edgeStates; // indexed by Edge::id
+};